@@ -0,0 +1,323 @@
+// Accuracy versus cost: runs standard scenarios with every integrator, timestep (speed multiplier) and
+// force backend, and compares against a double-precision, fourth-order, small-step direct-sum
+// reference. Collisions are off so every run conserves energy and angular momentum in the limit.
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+#include "scenes.h"
+#include "thread_pool.h"
+
+struct AccuracyOptions {
+    std::vector<std::string> scenarios = {"earth-moon", "plummer", "disk"};
+    std::vector<Integrator> integrators = {Integrator::Euler, Integrator::Leapfrog};
+    std::vector<ForceBackend> backends = {ForceBackend::Direct, ForceBackend::BarnesHut};
+    std::vector<double> speeds = {0.25, 0.5, 1, 2, 4}; // dt = speed / 94 simulated seconds
+    size_t bodies = 0;       // 0 = the scenario's default
+    int substeps = 4;        // reference steps per step of the smallest speed
+    int checkpoints = 16;    // energy samples per run, for the maximum error
+    size_t threads = 1;
+    float theta = 0.5f;
+    std::string output = "accuracy.csv";
+};
+
+struct Scenario {
+    std::string name;
+    size_t defaultBodies;
+    uint64_t steps;      // at speed 1, the run length (divisible by the largest speed)
+    double lengthScale;  // trajectory divergence is reported in these units
+};
+
+// Earth-Moon: about one orbit. Plummer: about two crossing times. Disk: half an orbit at the scale length
+// (a light disk around a heavy center: unsoftened heavy disk bodies scatter off each other too hard to compare).
+static const Scenario scenarios[] = {
+    {"earth-moon", 2, 3904, 3844.0},
+    {"plummer", 256, 400, 5000.0},
+    {"disk", 128, 4200, 3000.0},
+};
+
+static const Scenario* FindScenario(const std::string& name) {
+    for (const Scenario& scenario : scenarios) {
+        if (scenario.name == name) return &scenario;
+    }
+    return nullptr;
+}
+
+static void BuildScenario(const Scenario& scenario, size_t count, Simulation& simulation) {
+    if (scenario.name == "earth-moon") {
+        AddEarthMoon(simulation);
+        if (count > 2) AddOrbitingRing(simulation, 1, count - 2, 500.0f, 3000.0f, 1e15f, 7);
+    } else if (scenario.name == "plummer") {
+        AddPlummer(simulation, count, 4.3e26f, 5000.0f, 7);
+    } else {
+        AddExponentialDisk(simulation, count > 1 ? count - 1 : 1, 2e27f, 1e21f, 3000.0f, 7);
+    }
+}
+
+// Positions and velocities in double, for the reference and for the conserved quantities
+struct State {
+    std::vector<double> x, y, z, vx, vy, vz, mass;
+    size_t Size() const { return x.size(); }
+};
+
+static State FromBodies(const BodyStore& bodies) {
+    State state;
+    for (size_t i = 0; i < bodies.Size(); ++i) {
+        state.x.push_back(bodies.x[i]);
+        state.y.push_back(bodies.y[i]);
+        state.z.push_back(bodies.z[i]);
+        state.vx.push_back(bodies.vx[i]);
+        state.vy.push_back(bodies.vy[i]);
+        state.vz.push_back(bodies.vz[i]);
+        state.mass.push_back(bodies.mass[i]);
+    }
+    return state;
+}
+
+struct Conserved {
+    double energy = 0.0;
+    double lx = 0.0, ly = 0.0, lz = 0.0;
+};
+
+static Conserved Measure(const State& s) {
+    Conserved c;
+    const size_t n = s.Size();
+    for (size_t i = 0; i < n; ++i) {
+        c.energy += 0.5 * s.mass[i] * (s.vx[i] * s.vx[i] + s.vy[i] * s.vy[i] + s.vz[i] * s.vz[i]);
+        c.lx += s.mass[i] * (s.y[i] * s.vz[i] - s.z[i] * s.vy[i]);
+        c.ly += s.mass[i] * (s.z[i] * s.vx[i] - s.x[i] * s.vz[i]);
+        c.lz += s.mass[i] * (s.x[i] * s.vy[i] - s.y[i] * s.vx[i]);
+        for (size_t j = i + 1; j < n; ++j) {
+            double dx = s.x[j] - s.x[i], dy = s.y[j] - s.y[i], dz = s.z[j] - s.z[i];
+            c.energy -= GScene * s.mass[i] * s.mass[j] / std::sqrt(dx * dx + dy * dy + dz * dz);
+        }
+    }
+    return c;
+}
+
+static double EnergyError(const Conserved& now, const Conserved& start) {
+    return std::fabs((now.energy - start.energy) / start.energy);
+}
+
+static double AngularMomentumError(const Conserved& now, const Conserved& start) {
+    double dx = now.lx - start.lx, dy = now.ly - start.ly, dz = now.lz - start.lz;
+    double l = std::sqrt(start.lx * start.lx + start.ly * start.ly + start.lz * start.lz);
+    return l > 0.0 ? std::sqrt(dx * dx + dy * dy + dz * dz) / l : 0.0;
+}
+
+// Reference: direct sum in double, Yoshida's fourth-order composition of drift-kick-drift leapfrogs
+static void ReferenceAccelerations(const State& s, std::vector<double>& ax, std::vector<double>& ay,
+                                   std::vector<double>& az, ThreadPool& pool) {
+    const size_t n = s.Size();
+    pool.ParallelFor(0, n, 16, [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            double sumX = 0.0, sumY = 0.0, sumZ = 0.0;
+            for (size_t j = 0; j < n; ++j) {
+                if (j == i) continue;
+                double dx = s.x[j] - s.x[i], dy = s.y[j] - s.y[i], dz = s.z[j] - s.z[i];
+                double d2 = dx * dx + dy * dy + dz * dz;
+                double f = GScene * s.mass[j] / (d2 * std::sqrt(d2));
+                sumX += dx * f;
+                sumY += dy * f;
+                sumZ += dz * f;
+            }
+            ax[i] = sumX;
+            ay[i] = sumY;
+            az[i] = sumZ;
+        }
+    });
+}
+
+static void ReferenceRun(State& s, double dt, uint64_t steps, ThreadPool& pool) {
+    const double w1 = 1.0 / (2.0 - std::cbrt(2.0));
+    const double w0 = 1.0 - 2.0 * w1;
+    const double weights[3] = {w1, w0, w1};
+    const size_t n = s.Size();
+    std::vector<double> ax(n), ay(n), az(n);
+    for (uint64_t step = 0; step < steps; ++step) {
+        for (double w : weights) {
+            double h = w * dt;
+            for (size_t i = 0; i < n; ++i) {
+                s.x[i] += s.vx[i] * h * 0.5;
+                s.y[i] += s.vy[i] * h * 0.5;
+                s.z[i] += s.vz[i] * h * 0.5;
+            }
+            ReferenceAccelerations(s, ax, ay, az, pool);
+            for (size_t i = 0; i < n; ++i) {
+                s.vx[i] += ax[i] * h;
+                s.vy[i] += ay[i] * h;
+                s.vz[i] += az[i] * h;
+                s.x[i] += s.vx[i] * h * 0.5;
+                s.y[i] += s.vy[i] * h * 0.5;
+                s.z[i] += s.vz[i] * h * 0.5;
+            }
+        }
+    }
+}
+
+// RMS position difference in units of the scenario's length scale
+static double Divergence(const BodyStore& bodies, const State& reference, double lengthScale) {
+    double sum = 0.0;
+    for (size_t i = 0; i < bodies.Size(); ++i) {
+        double dx = bodies.x[i] - reference.x[i], dy = bodies.y[i] - reference.y[i], dz = bodies.z[i] - reference.z[i];
+        sum += dx * dx + dy * dy + dz * dz;
+    }
+    return std::sqrt(sum / bodies.Size()) / lengthScale;
+}
+
+template <typename T>
+static bool ParseList(const char* text, std::vector<T>& values, bool (*parse)(const char*, T&)) {
+    values.clear();
+    std::string list = text;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        T value;
+        if (!parse(list.substr(start, comma - start).c_str(), value)) return false;
+        values.push_back(value);
+        start = comma + 1;
+    }
+    return !values.empty();
+}
+
+static bool ParseSpeed(const char* text, double& value) {
+    char* end = nullptr;
+    value = strtod(text, &end);
+    return end != text && *end == '\0' && value > 0.0;
+}
+
+static bool ParseScenario(const char* text, std::string& value) {
+    value = text;
+    return FindScenario(value) != nullptr;
+}
+
+static void PrintAccuracyUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --scenarios LIST    earth-moon,plummer,disk (default all)\n"
+            "  --integrators LIST  euler,leapfrog (default both)\n"
+            "  --backends LIST     direct,barnes-hut (default both)\n"
+            "  --speeds LIST       speed multipliers, dt = speed / 94 s (default 0.25,0.5,1,2,4)\n"
+            "  --bodies N          bodies per scenario (default 2 / 256 / 128)\n"
+            "  --substeps N        reference steps per step of the smallest speed (default 4)\n"
+            "  --threads N         threads for the force passes (default 1)\n"
+            "  --theta X           Barnes-Hut opening angle (default 0.5)\n"
+            "  --output PATH       CSV file (default accuracy.csv, - for stdout)\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    AccuracyOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            PrintAccuracyUsage(argv[0]);
+            return 0;
+        } else if (value && strcmp(arg, "--scenarios") == 0 && ParseList(value, options.scenarios, ParseScenario)) {
+            ++i;
+        } else if (value && strcmp(arg, "--integrators") == 0 && ParseList(value, options.integrators, ParseIntegrator)) {
+            ++i;
+        } else if (value && strcmp(arg, "--backends") == 0 && ParseList(value, options.backends, ParseForceBackend)) {
+            ++i;
+        } else if (value && strcmp(arg, "--speeds") == 0 && ParseList(value, options.speeds, ParseSpeed)) {
+            ++i;
+        } else if (value && strcmp(arg, "--bodies") == 0 && atoi(value) > 1) {
+            options.bodies = atoi(value);
+            ++i;
+        } else if (value && strcmp(arg, "--substeps") == 0 && atoi(value) > 0) {
+            options.substeps = atoi(value);
+            ++i;
+        } else if (value && strcmp(arg, "--threads") == 0 && atoi(value) >= 0) {
+            options.threads = atoi(value);
+            ++i;
+        } else if (value && strcmp(arg, "--theta") == 0 && atof(value) > 0.0) {
+            options.theta = (float)atof(value);
+            ++i;
+        } else if (value && strcmp(arg, "--output") == 0) {
+            options.output = value;
+            ++i;
+        } else {
+            fprintf(stderr, "Bad option: %s\n", arg);
+            PrintAccuracyUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    FILE* csv = options.output == "-" ? stdout : fopen(options.output.c_str(), "w");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s\n", options.output.c_str());
+        return 1;
+    }
+    fprintf(csv, "scenario,bodies,integrator,backend,speed,dt,steps,wall_s,steps_per_s,"
+                 "energy_error,max_energy_error,angular_momentum_error,divergence\n");
+
+    ThreadPool pool(options.threads);
+    double smallestSpeed = options.speeds[0];
+    for (double speed : options.speeds) smallestSpeed = std::min(smallestSpeed, speed);
+
+    for (const std::string& name : options.scenarios) {
+        const Scenario& scenario = *FindScenario(name);
+        size_t count = options.bodies > 0 ? options.bodies : scenario.defaultBodies;
+        Simulation initial;
+        BuildScenario(scenario, count, initial);
+        const State start = FromBodies(initial.bodies);
+        const Conserved conservedStart = Measure(start);
+        const double duration = scenario.steps / 94.0;
+
+        // One reference per scenario, fine enough for the smallest speed
+        auto referenceStart = std::chrono::steady_clock::now();
+        State reference = start;
+        uint64_t referenceSteps = (uint64_t)std::ceil(duration / (smallestSpeed / 94.0)) * options.substeps;
+        ReferenceRun(reference, duration / referenceSteps, referenceSteps, pool);
+        double referenceSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - referenceStart).count();
+        fprintf(stderr, "%s: %zu bodies, reference %llu steps in %.1f s, energy error %.2e\n", name.c_str(),
+                start.Size(), (unsigned long long)referenceSteps, referenceSeconds,
+                EnergyError(Measure(reference), conservedStart));
+
+        for (Integrator integrator : options.integrators) {
+            for (ForceBackend backend : options.backends) {
+                for (double speed : options.speeds) {
+                    Simulation simulation;
+                    BuildScenario(scenario, count, simulation);
+                    simulation.params.collisions = false;
+                    simulation.params.integrator = integrator;
+                    simulation.params.backend = backend;
+                    simulation.params.theta = options.theta;
+                    simulation.params.speed = (float)speed;
+                    simulation.pool = &pool;
+
+                    // The run ends at the same time as the reference (to within one step for odd speeds)
+                    uint64_t steps = (uint64_t)std::llround(duration / (speed / 94.0));
+                    uint64_t every = std::max<uint64_t>(1, steps / options.checkpoints);
+                    double wall = 0.0, maxEnergyError = 0.0;
+                    for (uint64_t done = 0; done < steps;) {
+                        uint64_t batch = std::min(every, steps - done);
+                        auto batchStart = std::chrono::steady_clock::now();
+                        for (uint64_t k = 0; k < batch; ++k) simulation.Step();
+                        wall += std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart).count();
+                        done += batch;
+                        maxEnergyError = std::max(maxEnergyError,
+                                                  EnergyError(Measure(FromBodies(simulation.bodies)), conservedStart));
+                    }
+
+                    Conserved end = Measure(FromBodies(simulation.bodies));
+                    fprintf(csv, "%s,%zu,%s,%s,%g,%.6g,%llu,%.6f,%.1f,%.3e,%.3e,%.3e,%.3e\n", name.c_str(), start.Size(),
+                            IntegratorName(integrator), ForceBackendName(backend), speed, speed / 94.0,
+                            (unsigned long long)steps, wall, steps / wall, EnergyError(end, conservedStart),
+                            maxEnergyError, AngularMomentumError(end, conservedStart),
+                            Divergence(simulation.bodies, reference, scenario.lengthScale));
+                    fflush(csv);
+                }
+            }
+        }
+    }
+    if (csv != stdout) fclose(csv);
+    return 0;
+}
@@ -0,0 +1,167 @@
+#include "barnes_hut.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "simulation.h"
+
+namespace {
+const uint32_t leafSize = 8;  // bodies per leaf before it is split
+const int maxDepth = 32;      // coincident bodies stay in one leaf
+const float diagonal = 3.4641016f; // 2 * sqrt(3): any two points of a cube are within halfSize * diagonal
+}
+
+void BarnesHutTree::Build(const BodyStore& bodies) {
+    nodes.clear();
+    order.clear();
+    const size_t count = bodies.Size();
+    float minX = INFINITY, minY = INFINITY, minZ = INFINITY;
+    float maxX = -INFINITY, maxY = -INFINITY, maxZ = -INFINITY;
+    for (size_t i = 0; i < count; ++i) {
+        if (bodies.flags[i] & BodyInitializing) continue;
+        order.push_back((uint32_t)i);
+        minX = std::min(minX, bodies.x[i]); maxX = std::max(maxX, bodies.x[i]);
+        minY = std::min(minY, bodies.y[i]); maxY = std::max(maxY, bodies.y[i]);
+        minZ = std::min(minZ, bodies.z[i]); maxZ = std::max(maxZ, bodies.z[i]);
+    }
+    if (order.empty()) return;
+
+    float halfSize = std::max({maxX - minX, maxY - minY, maxZ - minZ}) * 0.5f * 1.0001f + 1e-3f;
+    scratch.resize(order.size());
+    octants.resize(order.size());
+    nodes.reserve(order.size() / leafSize * 2 + 1);
+    nodes.emplace_back();
+    BuildNode(0, bodies, (minX + maxX) * 0.5f, (minY + maxY) * 0.5f, (minZ + maxZ) * 0.5f, halfSize,
+              0, (uint32_t)order.size(), 0);
+}
+
+void BarnesHutTree::BuildNode(uint32_t index, const BodyStore& bodies, float cx, float cy, float cz, float halfSize,
+                              uint32_t first, uint32_t count, int depth) {
+    // Mass moments in double: sums over millions of bodies
+    double mass = 0.0, mx = 0.0, my = 0.0, mz = 0.0;
+    float maxRadius = 0.0f;
+    for (uint32_t k = first; k < first + count; ++k) {
+        uint32_t b = order[k];
+        mass += bodies.mass[b];
+        mx += (double)bodies.mass[b] * bodies.x[b];
+        my += (double)bodies.mass[b] * bodies.y[b];
+        mz += (double)bodies.mass[b] * bodies.z[b];
+        maxRadius = std::max(maxRadius, bodies.radius[b]);
+    }
+
+    Node node = {};
+    node.centerX = cx;
+    node.centerY = cy;
+    node.centerZ = cz;
+    node.halfSize = halfSize;
+    node.mass = (float)mass;
+    node.comX = mass > 0.0 ? (float)(mx / mass) : cx;
+    node.comY = mass > 0.0 ? (float)(my / mass) : cy;
+    node.comZ = mass > 0.0 ? (float)(mz / mass) : cz;
+    node.maxRadius = maxRadius;
+    node.first = first;
+    node.count = count;
+
+    if (count > leafSize && depth < maxDepth) {
+        // Counting sort of the range by octant (bit 0 = +x, bit 1 = +y, bit 2 = +z)
+        uint32_t counts[8] = {};
+        for (uint32_t k = first; k < first + count; ++k) {
+            uint32_t b = order[k];
+            uint8_t octant = (bodies.x[b] >= cx ? 1 : 0) | (bodies.y[b] >= cy ? 2 : 0) | (bodies.z[b] >= cz ? 4 : 0);
+            octants[k] = octant;
+            counts[octant]++;
+        }
+        uint32_t offsets[8];
+        uint32_t offset = first;
+        for (int o = 0; o < 8; ++o) {
+            offsets[o] = offset;
+            offset += counts[o];
+        }
+        for (uint32_t k = first; k < first + count; ++k) {
+            scratch[offsets[octants[k]]++] = order[k];
+        }
+        std::copy(scratch.begin() + first, scratch.begin() + first + count, order.begin() + first);
+
+        // Children go next to each other, so their slots are reserved before recursing
+        uint32_t childCount = 0;
+        for (int o = 0; o < 8; ++o) childCount += counts[o] > 0;
+        node.firstChild = (uint32_t)nodes.size();
+        node.childCount = childCount;
+        nodes.resize(nodes.size() + childCount);
+        nodes[index] = node;
+
+        float quarter = halfSize * 0.5f;
+        uint32_t child = node.firstChild;
+        uint32_t start = first;
+        for (int o = 0; o < 8; ++o) {
+            if (counts[o] == 0) continue;
+            float ccx = cx + (o & 1 ? quarter : -quarter);
+            float ccy = cy + (o & 2 ? quarter : -quarter);
+            float ccz = cz + (o & 4 ? quarter : -quarter);
+            BuildNode(child++, bodies, ccx, ccy, ccz, quarter, start, counts[o], depth + 1);
+            start += counts[o];
+        }
+    } else {
+        nodes[index] = node;
+    }
+}
+
+uint64_t BarnesHutTree::Accelerate(size_t i, const BodyStore& bodies, float theta, bool collisions,
+                                   float& ax, float& ay, float& az, float& potential, float& bounce) const {
+    if (nodes.empty()) return 0;
+    const float px = bodies.x[i], py = bodies.y[i], pz = bodies.z[i];
+    const float radius = bodies.radius[i];
+    float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f, sumPotential = 0.0f;
+    uint64_t interactions = 0;
+
+    uint32_t stack[8 * maxDepth + 8];
+    size_t top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        float dx = node.comX - px;
+        float dy = node.comY - py;
+        float dz = node.comZ - pz;
+        float distance = sqrt(dx * dx + dy * dy + dz * dz);
+
+        // Far enough that it is small in the sky, cannot contain body i and nothing in it can touch body i
+        if (2.0f * node.halfSize < theta * distance && distance > node.halfSize * diagonal + node.maxRadius + radius) {
+            interactions++;
+            float distance_m = distance * 1000;
+            float acc = (float)(G * node.mass) / (distance_m * distance_m);
+            sumX += dx / distance * acc;
+            sumY += dy / distance * acc;
+            sumZ += dz / distance * acc;
+            sumPotential += acc * distance_m;
+        } else if (node.firstChild != 0) {
+            for (uint32_t c = 0; c < node.childCount; ++c) stack[top++] = node.firstChild + c;
+        } else {
+            // Leaf: the same per-pair terms as the direct sum
+            for (uint32_t k = node.first; k < node.first + node.count; ++k) {
+                uint32_t j = order[k];
+                if (j == i) continue;
+                float bx = bodies.x[j] - px;
+                float by = bodies.y[j] - py;
+                float bz = bodies.z[j] - pz;
+                float d = sqrt(bx * bx + by * by + bz * bz);
+                if (d > 0) {
+                    interactions++;
+                    float distance_m = d * 1000;
+                    float acc = (float)(G * bodies.mass[j]) / (distance_m * distance_m);
+                    sumX += bx / d * acc;
+                    sumY += by / d * acc;
+                    sumZ += bz / d * acc;
+                    sumPotential += acc * distance_m;
+                    if (collisions && CheckCollision(radius, bodies.radius[j], d)) {
+                        bounce *= -0.2f;
+                    }
+                }
+            }
+        }
+    }
+    ax = sumX;
+    ay = sumY;
+    az = sumZ;
+    potential = sumPotential;
+    return interactions;
+}
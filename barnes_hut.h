@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct BodyStore;
+
+// Octree over the bodies that exert gravity, rebuilt every step. Far cells act as a
+// single mass at their center of mass when size / distance < theta.
+class BarnesHutTree {
+    public:
+        struct Node {
+            float centerX, centerY, centerZ, halfSize; // cube covered by the node
+            float comX, comY, comZ;                    // center of mass
+            float mass;
+            float maxRadius;      // largest body radius inside, keeps overlapping bodies out of far cells
+            uint32_t firstChild;  // children are stored next to each other, 0 = leaf
+            uint32_t childCount;
+            uint32_t first, count; // leaf bodies: order[first, first + count)
+        };
+
+        // Skips bodies flagged BodyInitializing, like the direct sum
+        void Build(const BodyStore& bodies);
+
+        // Acceleration on body i (same units as the direct sum) and the sum of G m / d over the bodies
+        // and cells it saw (d in meters); multiplies bounce by -0.2 for every body it overlaps when
+        // collisions are on. Returns the interactions evaluated.
+        uint64_t Accelerate(size_t i, const BodyStore& bodies, float theta, bool collisions,
+                            float& ax, float& ay, float& az, float& potential, float& bounce) const;
+
+        size_t NodeCount() const { return nodes.size(); }
+
+    private:
+        // Fills nodes[index] and, recursively, its children
+        void BuildNode(uint32_t index, const BodyStore& bodies, float cx, float cy, float cz, float halfSize,
+                       uint32_t first, uint32_t count, int depth);
+
+        std::vector<Node> nodes;
+        std::vector<uint32_t> order;   // body indices grouped by leaf
+        std::vector<uint32_t> scratch; // partition buffer
+        std::vector<uint8_t> octants;
+};
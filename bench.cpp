@@ -0,0 +1,502 @@
+// Microbenchmarks for the hot loops of the 3D grid simulator: gravity step, collision test,
+// grid generation, sphere mesh generation and trail sampling. No window or GL context needed.
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#ifdef __APPLE__
+#include <sys/sysctl.h>
+#endif
+
+#include "simulation.h"
+#include "scenes.h"
+#include "grid.h"
+#include "frustum.h"
+#include "sphere_mesh.h"
+#include "trails.h"
+
+struct BenchOptions {
+    std::vector<size_t> bodies = {100, 1000, 4000};
+    std::vector<size_t> grid = {4096, 16384, 65536};
+    double minTime = 0.2;   // seconds per measurement
+    int repetitions = 3;    // measurements per kernel, the median is reported
+    std::string filter;     // only run kernels whose name contains this
+    std::string json;       // write the results here as JSON, empty = off
+    std::string baseline;   // compare against this JSON file, empty = off
+    double tolerance = 0.15; // allowed slowdown when the baseline does not set one
+    bool force = false;     // gate on the baseline even when it was recorded on another machine or build
+};
+
+// Where the numbers come from; a baseline only gates runs with the same CPU, compiler and flags
+struct BenchMachine {
+    std::string cpu;
+    std::string compiler;
+    std::string flags;
+};
+
+struct BenchResult {
+    double nsPerOp = 0.0;   // median over the repetitions
+    double spread = 0.0;    // (slowest - fastest) / median, a noise estimate
+    uint64_t iterations = 0;
+};
+
+// One reported line, kept for the JSON output and the baseline comparison
+struct BenchRecord {
+    std::string name;       // "kernel/params"
+    double nsPerOp = 0.0;
+    double spread = 0.0;
+    double interactionsPerSecond = 0.0;
+};
+std::vector<BenchRecord> benchRecords;
+
+// Keeps results alive so the optimizer can't drop the work being measured
+volatile double benchSink = 0.0;
+
+static double Now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static BenchMachine CurrentMachine() {
+    BenchMachine machine;
+#ifdef __APPLE__
+    char brand[256] = {};
+    size_t length = sizeof(brand) - 1;
+    if (sysctlbyname("machdep.cpu.brand_string", brand, &length, nullptr, 0) == 0) machine.cpu = brand;
+#else
+    if (FILE* file = fopen("/proc/cpuinfo", "r")) {
+        char line[512];
+        while (machine.cpu.empty() && fgets(line, sizeof(line), file)) {
+            const char* colon = strchr(line, ':');
+            if (strncmp(line, "model name", 10) != 0 || !colon) continue;
+            machine.cpu = colon + 1 + strspn(colon + 1, " \t");
+            while (!machine.cpu.empty() && (machine.cpu.back() == '\n' || machine.cpu.back() == ' '))
+                machine.cpu.pop_back();
+        }
+        fclose(file);
+    }
+#endif
+    if (machine.cpu.empty()) machine.cpu = "unknown";
+#if defined(__clang__)
+    machine.compiler = "clang " __clang_version__;
+#elif defined(__GNUC__)
+    machine.compiler = "gcc " __VERSION__;
+#else
+    machine.compiler = "unknown";
+#endif
+#ifdef BENCH_FLAGS
+    machine.flags = BENCH_FLAGS; // set by the Makefile
+#else
+    machine.flags = "unknown";
+#endif
+    return machine;
+}
+
+// Finds a batch size that takes at least minTime, then times `repetitions` such batches
+static BenchResult Measure(const BenchOptions& options, const std::function<void()>& op) {
+    op(); // warm-up
+    uint64_t iterations = 1;
+    double elapsed = 0.0;
+    while (true) {
+        double start = Now();
+        for (uint64_t i = 0; i < iterations; ++i)
+            op();
+        elapsed = Now() - start;
+        if (elapsed >= options.minTime || iterations >= (1ull << 40))
+            break;
+        iterations *= elapsed > 0.0 ? std::max<uint64_t>(2, (uint64_t)(options.minTime / elapsed * 1.2)) : 2;
+    }
+
+    std::vector<double> samples = {elapsed * 1e9 / iterations};
+    for (int repetition = 1; repetition < options.repetitions; ++repetition) {
+        double start = Now();
+        for (uint64_t i = 0; i < iterations; ++i)
+            op();
+        samples.push_back((Now() - start) * 1e9 / iterations);
+    }
+    std::sort(samples.begin(), samples.end());
+    BenchResult result;
+    result.nsPerOp = samples[samples.size() / 2];
+    result.spread = (samples.back() - samples.front()) / result.nsPerOp;
+    result.iterations = iterations;
+    return result;
+}
+
+static void Report(const char* kernel, const std::string& params, const BenchResult& result, double interactionsPerOp) {
+    BenchRecord record;
+    record.name = std::string(kernel) + "/" + params;
+    record.nsPerOp = result.nsPerOp;
+    record.spread = result.spread;
+    record.interactionsPerSecond = interactionsPerOp > 0.0 ? interactionsPerOp / (result.nsPerOp * 1e-9) : 0.0;
+    benchRecords.push_back(record);
+    if (interactionsPerOp > 0.0)
+        printf("%-12s %-22s %14.1f %16.3e\n", kernel, params.c_str(), result.nsPerOp,
+               interactionsPerOp / (result.nsPerOp * 1e-9));
+    else
+        printf("%-12s %-22s %14.1f %16s\n", kernel, params.c_str(), result.nsPerOp, "-");
+}
+
+static bool Selected(const BenchOptions& options, const char* kernel) {
+    return options.filter.empty() || strstr(kernel, options.filter.c_str()) != nullptr;
+}
+
+// Bodies spread over a cube about the size of the Earth-Moon system
+static void MakeBodies(Simulation& simulation, size_t count) {
+    AddUniformCube(simulation, count, 5000.0f, 7.34767309e22f, 42);
+}
+
+static void BenchForceStep(const BenchOptions& options) {
+    for (ForceBackend backend : {ForceBackend::Direct, ForceBackend::BarnesHut}) {
+        for (size_t n : options.bodies) {
+            Simulation simulation;
+            MakeBodies(simulation, n);
+            simulation.params.backend = backend;
+            uint64_t before = simulation.totalInteractions;
+            uint64_t steps = 0;
+            BenchResult result = Measure(options, [&] { simulation.Step(); steps++; });
+            benchSink = benchSink + simulation.bodies.x[0];
+            // interactions actually evaluated (Barnes-Hut evaluates far fewer than n * (n - 1))
+            double interactions = (double)(simulation.totalInteractions - before) / steps;
+            Report("force_step", std::string(ForceBackendName(backend)) + " n=" + std::to_string(n), result, interactions);
+        }
+    }
+}
+
+static void BenchCollision(const BenchOptions& options) {
+    for (size_t n : options.bodies) {
+        Simulation simulation;
+        MakeBodies(simulation, n);
+        const BodyStore& b = simulation.bodies;
+        BenchResult result = Measure(options, [&] {
+            size_t hits = 0;
+            for (size_t i = 0; i < n; ++i) {
+                for (size_t j = i + 1; j < n; ++j) {
+                    float dx = b.x[j] - b.x[i], dy = b.y[j] - b.y[i], dz = b.z[j] - b.z[i];
+                    hits += CheckCollision(b.radius[i], b.radius[j], std::sqrt(dx*dx + dy*dy + dz*dz));
+                }
+            }
+            benchSink = benchSink + hits;
+        });
+        Report("collision", "n=" + std::to_string(n), result, (double)n * (n - 1) / 2);
+    }
+}
+
+static void BenchGrid(const BenchOptions& options) {
+    Simulation simulation;
+    AddEarthMoon(simulation);
+    glm::vec3 cameraPos(0.0f, 1000.0f, 5000.0f);
+    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 750000.0f);
+    Frustum frustum = ExtractFrustum(projection * view);
+    std::vector<float> vertices;
+    for (size_t budget : options.grid) {
+        BenchResult result = Measure(options, [&] {
+            CreateGridVertices(20000.0f, budget, cameraPos, frustum, simulation.bodies, vertices);
+            benchSink = benchSink + vertices.size();
+        });
+        Report("grid", "budget=" + std::to_string(budget), result, 0.0);
+    }
+    // many bodies at the viewer's budget: the cost has to stay flat once n passes gridMaxWells
+    for (size_t n : options.bodies) {
+        Simulation many;
+        MakeBodies(many, n);
+        BenchResult result = Measure(options, [&] {
+            CreateGridVertices(20000.0f, gridVertexBudget, cameraPos, frustum, many.bodies, vertices);
+            benchSink = benchSink + vertices.size();
+        });
+        Report("grid", "budget=" + std::to_string(gridVertexBudget) + " n=" + std::to_string(n), result, 0.0);
+    }
+}
+
+static void BenchSphereMesh(const BenchOptions& options) {
+    for (int stacks : {8, 10, 50}) {
+        BenchResult result = Measure(options, [&] {
+            std::vector<float> vertices = CreateSphereVertices(100.0f, stacks, stacks);
+            benchSink = benchSink + vertices.size();
+        });
+        Report("sphere_mesh", "stacks=" + std::to_string(stacks), result, 0.0);
+    }
+}
+
+static void BenchTrails(const BenchOptions& options) {
+    for (size_t n : options.bodies) {
+        Simulation simulation;
+        MakeBodies(simulation, n);
+        for (size_t i = 0; i < n; ++i)
+            simulation.bodies.flags[i] |= BodyTrail;
+        Snapshot snapshot;
+        simulation.WriteSnapshot(snapshot);
+        Trails trails;
+        BenchResult result = Measure(options, [&] {
+            snapshot.step += trailInterval;
+            trails.Update(snapshot);
+        });
+        Report("trails", "n=" + std::to_string(n), result, 0.0);
+    }
+}
+
+// Quotes and backslashes escaped, control characters dropped
+static std::string JsonEscape(const std::string& text) {
+    std::string out;
+    for (char ch : text) {
+        if (ch == '"' || ch == '\\') out += '\\';
+        if ((unsigned char)ch >= 0x20) out += ch;
+    }
+    return out;
+}
+
+// {"cpu": "...", "compiler": "...", "flags": "...", "tolerance": 0.15,
+//  "results": [{"name": "...", "ns_per_op": 1.0, "spread": 0.01, "interactions_per_s": 0}, ...]}
+static bool WriteJson(const std::string& path, const BenchOptions& options, const BenchMachine& machine) {
+    FILE* file = path == "-" ? stdout : fopen(path.c_str(), "w");
+    if (!file) return false;
+    fprintf(file, "{\n  \"cpu\": \"%s\",\n  \"compiler\": \"%s\",\n  \"flags\": \"%s\",\n",
+            JsonEscape(machine.cpu).c_str(), JsonEscape(machine.compiler).c_str(), JsonEscape(machine.flags).c_str());
+    fprintf(file, "  \"min_time\": %g,\n  \"repetitions\": %d,\n  \"tolerance\": %g,\n  \"results\": [\n",
+            options.minTime, options.repetitions, options.tolerance);
+    for (size_t i = 0; i < benchRecords.size(); ++i) {
+        const BenchRecord& record = benchRecords[i];
+        fprintf(file, "    {\"name\": \"%s\", \"ns_per_op\": %.1f, \"spread\": %.4f, \"interactions_per_s\": %.6g}%s\n",
+                record.name.c_str(), record.nsPerOp, record.spread, record.interactionsPerSecond,
+                i + 1 < benchRecords.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    return file == stdout ? fflush(file) == 0 : fclose(file) == 0;
+}
+
+// Number following "key": in text, searched from `from` up to `to`
+static bool JsonNumber(const std::string& text, const char* key, size_t from, size_t to, double& value) {
+    size_t at = text.find("\"" + std::string(key) + "\"", from);
+    if (at == std::string::npos || at >= to) return false;
+    at = text.find(':', at);
+    if (at == std::string::npos || at >= to) return false;
+    value = strtod(text.c_str() + at + 1, nullptr);
+    return true;
+}
+
+// String following "key": in text before `to`, with \" and \\\\ unescaped
+static bool JsonString(const std::string& text, const char* key, size_t to, std::string& value) {
+    size_t at = text.find("\"" + std::string(key) + "\"");
+    if (at == std::string::npos || at >= to) return false;
+    at = text.find(':', at);
+    if (at == std::string::npos || at >= to) return false;
+    at = text.find('"', at);
+    if (at == std::string::npos || at >= to) return false;
+    value.clear();
+    for (++at; at < text.size() && text[at] != '"'; ++at) {
+        if (text[at] == '\\' && at + 1 < text.size()) ++at;
+        value += text[at];
+    }
+    return at < text.size();
+}
+
+struct BaselineEntry {
+    double nsPerOp = 0.0;
+    double tolerance = 0.0;
+};
+
+// Reads the format written by WriteJson; a result may carry its own "tolerance" for noisy kernels
+// Baselines from before the machine fields were recorded read back as "unknown", which never matches.
+static bool ReadBaseline(const std::string& path, double defaultTolerance, std::map<std::string, BaselineEntry>& entries,
+                         BenchMachine& machine) {
+    FILE* file = fopen(path.c_str(), "r");
+    if (!file) return false;
+    std::string text;
+    char buffer[4096];
+    size_t got;
+    while ((got = fread(buffer, 1, sizeof(buffer), file)) > 0) text.append(buffer, got);
+    fclose(file);
+
+    double tolerance = defaultTolerance;
+    size_t results = text.find("\"results\"");
+    if (results == std::string::npos) return false;
+    JsonNumber(text, "tolerance", 0, results, tolerance);
+    if (!JsonString(text, "cpu", results, machine.cpu)) machine.cpu = "unknown";
+    if (!JsonString(text, "compiler", results, machine.compiler)) machine.compiler = "unknown";
+    if (!JsonString(text, "flags", results, machine.flags)) machine.flags = "unknown";
+    for (size_t open = text.find('{', results); open != std::string::npos; open = text.find('{', open + 1)) {
+        size_t close = text.find('}', open);
+        if (close == std::string::npos) break;
+        size_t name = text.find("\"name\"", open);
+        if (name == std::string::npos || name > close) continue;
+        size_t quote = text.find('"', text.find(':', name));
+        size_t end = text.find('"', quote + 1);
+        BaselineEntry entry;
+        entry.tolerance = tolerance;
+        if (!JsonNumber(text, "ns_per_op", open, close, entry.nsPerOp)) continue;
+        JsonNumber(text, "tolerance", open, close, entry.tolerance);
+        entries[text.substr(quote + 1, end - quote - 1)] = entry;
+    }
+    return !entries.empty();
+}
+
+// Prints one line per kernel and returns how many got slower than their tolerance allows. The spread
+// of the current measurement is added to the tolerance, so a noisy run needs a bigger slowdown to fail.
+static int CompareBaseline(const std::map<std::string, BaselineEntry>& baseline) {
+    int regressions = 0;
+    printf("\n%-36s %14s %14s %9s\n", "baseline comparison", "baseline ns", "current ns", "change");
+    for (const BenchRecord& record : benchRecords) {
+        auto entry = baseline.find(record.name);
+        if (entry == baseline.end()) {
+            printf("%-36s %14s %14.1f %9s\n", record.name.c_str(), "-", record.nsPerOp, "new");
+            continue;
+        }
+        double change = record.nsPerOp / entry->second.nsPerOp - 1.0;
+        double allowed = entry->second.tolerance + record.spread;
+        const char* verdict = "";
+        if (change > allowed) {
+            verdict = "  REGRESSION";
+            regressions++;
+        } else if (change < -allowed) {
+            verdict = "  faster (update the baseline?)";
+        }
+        printf("%-36s %14.1f %14.1f %+8.1f%%%s\n", record.name.c_str(), entry->second.nsPerOp, record.nsPerOp,
+               change * 100.0, verdict);
+    }
+    // kernels the baseline has but this run did not measure (renamed, dropped or filtered out)
+    for (const auto& entry : baseline) {
+        bool measured = std::any_of(benchRecords.begin(), benchRecords.end(),
+                                    [&](const BenchRecord& record) { return record.name == entry.first; });
+        if (!measured)
+            printf("%-36s %14.1f %14s %9s\n", entry.first.c_str(), entry.second.nsPerOp, "-", "missing");
+    }
+    return regressions;
+}
+
+// Prints the fields that differ; numbers from another CPU, compiler or set of flags are not comparable
+static bool SameMachine(const BenchMachine& baseline, const BenchMachine& current) {
+    bool same = true;
+    auto check = [&](const char* field, const std::string& recorded, const std::string& measured) {
+        if (recorded == measured && recorded != "unknown") return;
+        fprintf(stderr, "baseline %s: %s\n    this run: %s\n", field, recorded.c_str(), measured.c_str());
+        same = false;
+    };
+    check("cpu", baseline.cpu, current.cpu);
+    check("compiler", baseline.compiler, current.compiler);
+    check("flags", baseline.flags, current.flags);
+    return same;
+}
+
+static bool ParseList(const char* text, std::vector<size_t>& values) {
+    values.clear();
+    while (*text) {
+        char* end = nullptr;
+        double value = strtod(text, &end);
+        if (end == text || value < 1.0)
+            return false;
+        values.push_back((size_t)value);
+        text = *end == ',' ? end + 1 : end;
+        if (*end && *end != ',')
+            return false;
+    }
+    return !values.empty();
+}
+
+static void PrintBenchUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --bodies N,N,...   body counts for force_step, collision and trails (default 100,1000,4000)\n"
+            "  --grid N,N,...     grid vertex budgets (default 4096,16384,65536)\n"
+            "  --min-time S       seconds per measurement (default 0.2)\n"
+            "  --filter NAME      only run kernels whose name contains NAME\n"
+            "  --repetitions N    measurements per kernel, the median is reported (default 3)\n"
+            "  --json PATH        write the results as JSON (- for stdout)\n"
+            "  --baseline PATH    compare against a JSON baseline, exit 2 when a kernel got slower\n"
+            "                     than its tolerance\n"
+            "  --tolerance X      allowed slowdown for baselines that set none (default 0.15 = 15%%)\n"
+            "  --force            gate on a baseline recorded with another CPU, compiler or flags\n"
+            "                     (by default the comparison is only printed)\n",
+            program);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (strcmp(arg, "-h") == 0 || strcmp(arg, "--help") == 0) {
+            PrintBenchUsage(argv[0]);
+            return 0;
+        } else if (value && strcmp(arg, "--bodies") == 0 && ParseList(value, options.bodies)) {
+            ++i;
+        } else if (value && strcmp(arg, "--grid") == 0 && ParseList(value, options.grid)) {
+            ++i;
+        } else if (value && strcmp(arg, "--min-time") == 0 && atof(value) > 0.0) {
+            options.minTime = atof(value);
+            ++i;
+        } else if (value && strcmp(arg, "--filter") == 0) {
+            options.filter = value;
+            ++i;
+        } else if (value && strcmp(arg, "--repetitions") == 0 && atoi(value) > 0) {
+            options.repetitions = atoi(value);
+            ++i;
+        } else if (value && strcmp(arg, "--json") == 0) {
+            options.json = value;
+            ++i;
+        } else if (value && strcmp(arg, "--baseline") == 0) {
+            options.baseline = value;
+            ++i;
+        } else if (value && strcmp(arg, "--tolerance") == 0 && atof(value) >= 0.0) {
+            options.tolerance = atof(value);
+            ++i;
+        } else if (strcmp(arg, "--force") == 0) {
+            options.force = true;
+        } else {
+            fprintf(stderr, "Bad option: %s\n", arg);
+            PrintBenchUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    // Read the baseline first so a bad path fails before minutes of measuring
+    BenchMachine machine = CurrentMachine();
+    BenchMachine baselineMachine;
+    std::map<std::string, BaselineEntry> baseline;
+    if (!options.baseline.empty() && !ReadBaseline(options.baseline, options.tolerance, baseline, baselineMachine)) {
+        fprintf(stderr, "Could not read baseline %s\n", options.baseline.c_str());
+        return 1;
+    }
+    bool gate = baseline.empty() || SameMachine(baselineMachine, machine) || options.force;
+    if (!gate)
+        fprintf(stderr, "%s was recorded on another machine or build: comparing without gating (--force to gate)\n",
+                options.baseline.c_str());
+
+    printf("%-12s %-22s %14s %16s\n", "kernel", "params", "ns/op", "interactions/s");
+    if (Selected(options, "force_step"))
+        BenchForceStep(options);
+    if (Selected(options, "collision"))
+        BenchCollision(options);
+    if (Selected(options, "grid"))
+        BenchGrid(options);
+    if (Selected(options, "sphere_mesh"))
+        BenchSphereMesh(options);
+    if (Selected(options, "trails"))
+        BenchTrails(options);
+
+    if (!options.json.empty() && !WriteJson(options.json, options, machine)) {
+        fprintf(stderr, "Could not write %s\n", options.json.c_str());
+        return 1;
+    }
+    if (!baseline.empty()) {
+        int regressions = CompareBaseline(baseline);
+        if (!gate) {
+            printf("\n%d kernel%s slower than tolerance, not gated: %s is from another machine or build\n",
+                   regressions, regressions == 1 ? "" : "s", options.baseline.c_str());
+            return 0;
+        }
+        if (regressions > 0) {
+            fprintf(stderr, "\n*** %d kernel%s regressed beyond tolerance against %s ***\n", regressions,
+                    regressions == 1 ? "" : "s", options.baseline.c_str());
+            return 2;
+        }
+        printf("\nNo regressions against %s\n", options.baseline.c_str());
+    }
+    return 0;
+}
@@ -0,0 +1,271 @@
+#include "checkpoint.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+
+namespace {
+
+size_t AlignUp(size_t value) {
+    return (value + checkpointAlignment - 1) / checkpointAlignment * checkpointAlignment;
+}
+
+// Makes a rename into the directory durable; file systems that cannot sync a directory say EINVAL
+bool SyncDirectoryOf(const std::string& path) {
+    size_t slash = path.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0 || errno == EINVAL;
+    close(fd);
+    return ok;
+}
+
+}
+
+CheckpointFieldBytes CheckpointFieldView(const BodyStore& bodies, CheckpointField field) {
+    switch (field) {
+        case CheckpointField::X: return {bodies.x.data(), 4};
+        case CheckpointField::Y: return {bodies.y.data(), 4};
+        case CheckpointField::Z: return {bodies.z.data(), 4};
+        case CheckpointField::VX: return {bodies.vx.data(), 4};
+        case CheckpointField::VY: return {bodies.vy.data(), 4};
+        case CheckpointField::VZ: return {bodies.vz.data(), 4};
+        case CheckpointField::Mass: return {bodies.mass.data(), 4};
+        case CheckpointField::Density: return {bodies.density.data(), 4};
+        case CheckpointField::Radius: return {bodies.radius.data(), 4};
+        case CheckpointField::Color: return {bodies.color.data(), 4};
+        case CheckpointField::Id: return {bodies.id.data(), 4};
+        case CheckpointField::Flags: return {bodies.flags.data(), 1};
+        case CheckpointField::Count: break;
+    }
+    return {nullptr, 0};
+}
+
+namespace {
+
+void* Destination(BodyStore& bodies, CheckpointField field) {
+    return const_cast<void*>(CheckpointFieldView(bodies, field).data);
+}
+
+bool SetError(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+volatile std::sig_atomic_t terminationRequested = 0;
+
+void OnTerminate(int) {
+    terminationRequested = 1;
+}
+
+}
+
+bool WriteCheckpoint(const std::string& path, const Snapshot& snapshot, const SimulationParams& params) {
+    const BodyStore& bodies = snapshot.bodies;
+    const size_t count = bodies.Size();
+
+    CheckpointHeader header = {};
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = checkpointVersion;
+    header.byteOrder = checkpointByteOrder;
+    header.headerSize = sizeof(CheckpointHeader);
+    header.sectionCount = (uint32_t)CheckpointField::Count;
+    header.bodyCount = count;
+    header.step = snapshot.step;
+    header.time = snapshot.time;
+    header.totalInteractions = snapshot.totalInteractions;
+    header.speed = snapshot.speed;
+    header.theta = params.theta;
+    header.paused = snapshot.paused;
+    header.collisions = params.collisions;
+    header.backend = (uint8_t)params.backend;
+    header.integrator = (uint8_t)params.integrator;
+    uint32_t nextId = 0;
+    for (uint32_t id : bodies.id) nextId = id + 1 > nextId ? id + 1 : nextId;
+    header.nextId = nextId;
+
+    size_t offset = AlignUp(sizeof(CheckpointHeader));
+    for (uint32_t f = 0; f < header.sectionCount; ++f) {
+        CheckpointFieldBytes view = CheckpointFieldView(bodies, (CheckpointField)f);
+        header.sections[f] = {f, view.elementSize, offset, (uint64_t)view.elementSize * count};
+        offset = AlignUp(offset + header.sections[f].bytes);
+    }
+
+    std::string temporary = path + ".tmp";
+    FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) return false;
+    static const uint8_t zeros[checkpointAlignment] = {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t written = sizeof(header);
+    for (uint32_t f = 0; ok && f < header.sectionCount; ++f) {
+        const CheckpointSection& section = header.sections[f];
+        ok = std::fwrite(zeros, 1, section.offset - written, file) == section.offset - written;
+        if (ok && section.bytes > 0) {
+            ok = std::fwrite(CheckpointFieldView(bodies, (CheckpointField)f).data, 1, section.bytes, file) == section.bytes;
+        }
+        written = section.offset + section.bytes;
+    }
+    ok = ok && std::fflush(file) == 0 && fsync(fileno(file)) == 0;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    // Without this a power failure can still lose the rename (and bring back the old checkpoint)
+    return SyncDirectoryOf(path);
+}
+
+bool MappedCheckpoint::Open(const std::string& path, std::string* error) {
+    Close();
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return SetError(error, "cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(CheckpointHeader)) {
+        close(fd);
+        return SetError(error, path + " is too short to be a checkpoint");
+    }
+    size = (size_t)info.st_size;
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        size = 0;
+        return SetError(error, "cannot map " + path);
+    }
+    data = (const uint8_t*)mapping;
+    header = (const CheckpointHeader*)data;
+
+    std::string problem;
+    if (std::memcmp(header->magic, checkpointMagic, sizeof(checkpointMagic)) != 0) {
+        problem = " is not a checkpoint";
+    } else if (header->byteOrder != checkpointByteOrder) {
+        problem = " was written on a machine of the other byte order";
+    } else if (header->version != checkpointVersion || header->headerSize != sizeof(CheckpointHeader)) {
+        problem = " has checkpoint version " + std::to_string(header->version) + ", expected " +
+                  std::to_string(checkpointVersion);
+    } else if (header->sectionCount != (uint32_t)CheckpointField::Count || header->bodyCount > size) {
+        problem = " has a damaged section table";
+    } else {
+        // Every section lies inside the file and holds bodyCount elements; dividing instead of
+        // multiplying keeps a damaged elementSize or bodyCount from overflowing the check
+        for (uint32_t f = 0; f < header->sectionCount; ++f) {
+            const CheckpointSection& section = header->sections[f];
+            if (section.offset % checkpointAlignment != 0 || section.offset > size || section.bytes > size - section.offset ||
+                section.elementSize == 0 || section.bytes % section.elementSize != 0 ||
+                section.bytes / section.elementSize != header->bodyCount) {
+                problem = " is truncated or has a damaged section table";
+                break;
+            }
+        }
+    }
+    if (!problem.empty()) {
+        Close();
+        return SetError(error, path + problem);
+    }
+    // The arrays are read front to back when loading
+    madvise(mapping, size, MADV_SEQUENTIAL);
+    return true;
+}
+
+void MappedCheckpoint::Close() {
+    if (data) munmap(const_cast<uint8_t*>(data), size);
+    data = nullptr;
+    header = nullptr;
+    size = 0;
+}
+
+const void* MappedCheckpoint::Field(CheckpointField field, uint32_t elementSize) const {
+    for (uint32_t f = 0; f < header->sectionCount; ++f) {
+        const CheckpointSection& section = header->sections[f];
+        if (section.field == (uint32_t)field) {
+            return section.elementSize == elementSize ? data + section.offset : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+bool LoadCheckpoint(const std::string& path, Simulation& simulation, std::string* error) {
+    MappedCheckpoint checkpoint;
+    if (!checkpoint.Open(path, error)) return false;
+    const CheckpointHeader& header = checkpoint.Header();
+    const size_t count = checkpoint.BodyCount();
+
+    // Every array is present before anything is allocated; Open bounded the count by the file size
+    BodyStore& bodies = simulation.bodies;
+    for (uint32_t f = 0; f < (uint32_t)CheckpointField::Count; ++f) {
+        CheckpointField field = (CheckpointField)f;
+        if (!checkpoint.Field(field, CheckpointFieldView(bodies, field).elementSize)) {
+            return SetError(error, path + " is missing a body array");
+        }
+    }
+    bodies.Resize(count);
+    for (uint32_t f = 0; f < (uint32_t)CheckpointField::Count; ++f) {
+        CheckpointField field = (CheckpointField)f;
+        uint32_t elementSize = CheckpointFieldView(bodies, field).elementSize;
+        if (count > 0) std::memcpy(Destination(bodies, field), checkpoint.Field(field, elementSize), (size_t)elementSize * count);
+    }
+
+    simulation.step = header.step;
+    simulation.time = header.time;
+    simulation.totalInteractions = header.totalInteractions;
+    simulation.params.speed = header.speed;
+    simulation.params.theta = header.theta;
+    simulation.params.paused = header.paused != 0;
+    simulation.params.collisions = header.collisions != 0;
+    simulation.params.backend = header.backend == (uint8_t)ForceBackend::BarnesHut ? ForceBackend::BarnesHut : ForceBackend::Direct;
+    simulation.params.integrator = header.integrator == (uint8_t)Integrator::Leapfrog ? Integrator::Leapfrog : Integrator::Euler;
+    simulation.SetNextId(header.nextId);
+    simulation.Invalidate();
+    return true;
+}
+
+bool CheckpointWriter::WriteAsync(const std::string& path, const Snapshot& snapshot, const SimulationParams& params) {
+    if (busy.load()) {
+        skipped++;
+        return false;
+    }
+    if (thread.joinable()) thread.join();
+    pending = snapshot; // reuses the capacity of the previous copy
+    pendingParams = params;
+    pendingPath = path;
+    busy = true;
+    thread = std::thread([this] {
+        auto start = std::chrono::steady_clock::now();
+        bool ok = WriteCheckpoint(pendingPath, pending, pendingParams);
+        lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        (ok ? written : failed)++;
+        busy = false;
+    });
+    return true;
+}
+
+bool CheckpointWriter::Write(const std::string& path, const Snapshot& snapshot, const SimulationParams& params) {
+    Wait();
+    auto start = std::chrono::steady_clock::now();
+    bool ok = WriteCheckpoint(path, snapshot, params);
+    lastSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    (ok ? written : failed)++;
+    return ok;
+}
+
+void CheckpointWriter::Wait() {
+    if (thread.joinable()) thread.join();
+}
+
+void InstallTerminationHandler() {
+    struct sigaction action = {};
+    action.sa_handler = OnTerminate;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGTERM, &action, nullptr);
+    sigaction(SIGINT, &action, nullptr);
+}
+
+bool TerminationRequested() {
+    return terminationRequested != 0;
+}
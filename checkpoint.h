@@ -0,0 +1,116 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "simulation.h"
+
+// Binary snapshot of the simulation that can be memory-mapped and used without parsing:
+// a fixed header followed by one section per BodyStore array, each starting on a 64-byte
+// boundary, in native (little-endian) byte order.
+//
+//   CheckpointHeader | pad | x[n] | pad | y[n] | ... | flags[n]
+//
+// Files are written to PATH.tmp, synced and renamed, so a crash mid-write keeps the previous one.
+const char checkpointMagic[8] = {'G', 'R', 'A', 'V', 'S', 'N', 'A', 'P'};
+const uint32_t checkpointVersion = 1;
+const uint32_t checkpointByteOrder = 0x01020304; // reads back differently on a machine of the other endianness
+const size_t checkpointAlignment = 64;
+
+enum class CheckpointField : uint32_t {
+    X, Y, Z, VX, VY, VZ, Mass, Density, Radius, Color, Id, Flags,
+    Count
+};
+
+struct CheckpointSection {
+    uint32_t field;       // CheckpointField
+    uint32_t elementSize; // bytes per body
+    uint64_t offset;      // from the start of the file, a multiple of checkpointAlignment
+    uint64_t bytes;
+};
+
+struct CheckpointHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t headerSize;  // sizeof(CheckpointHeader) of the writer
+    uint32_t sectionCount;
+    uint64_t bodyCount;
+    uint64_t step;
+    double time;
+    uint64_t totalInteractions;
+    float speed;
+    float theta;
+    uint8_t paused;
+    uint8_t collisions;
+    uint8_t backend;      // ForceBackend
+    uint8_t integrator;   // Integrator
+    uint32_t nextId;      // first id not used yet
+    CheckpointSection sections[(int)CheckpointField::Count];
+};
+
+// The BodyStore array behind a field, as bytes
+struct CheckpointFieldBytes {
+    const void* data;
+    uint32_t elementSize;
+};
+CheckpointFieldBytes CheckpointFieldView(const BodyStore& bodies, CheckpointField field);
+
+// Writes the snapshot (the consistent copy the simulation publishes) plus the parameters it does not carry
+bool WriteCheckpoint(const std::string& path, const Snapshot& snapshot, const SimulationParams& params);
+
+// Read-only mapping of a checkpoint file; the arrays point straight into the mapping
+class MappedCheckpoint {
+    public:
+        ~MappedCheckpoint() { Close(); }
+
+        // Validates magic, version, byte order and that every section lies inside the file
+        bool Open(const std::string& path, std::string* error = nullptr);
+        void Close();
+
+        const CheckpointHeader& Header() const { return *header; }
+        size_t BodyCount() const { return header->bodyCount; }
+        // nullptr when the section is missing or has an unexpected element size
+        const void* Field(CheckpointField field, uint32_t elementSize) const;
+
+    private:
+        const CheckpointHeader* header = nullptr;
+        const uint8_t* data = nullptr;
+        size_t size = 0;
+};
+
+// Replaces the simulation's bodies, counters and parameters with the checkpoint's (one memcpy per array)
+bool LoadCheckpoint(const std::string& path, Simulation& simulation, std::string* error = nullptr);
+
+// Writes checkpoints on a background thread. The snapshot is copied on the calling thread,
+// so the caller can keep going while the file is written.
+class CheckpointWriter {
+    public:
+        ~CheckpointWriter() { Wait(); }
+
+        // Returns false (and counts a skip) while the previous checkpoint is still being written
+        bool WriteAsync(const std::string& path, const Snapshot& snapshot, const SimulationParams& params);
+        // Waits for the background write, then writes on the calling thread
+        bool Write(const std::string& path, const Snapshot& snapshot, const SimulationParams& params);
+        void Wait();
+        bool Busy() const { return busy.load(); }
+
+        std::atomic<int> written{0};
+        std::atomic<int> failed{0};
+        int skipped = 0;
+        std::atomic<double> lastSeconds{0.0}; // wall time of the last write
+
+    private:
+        std::thread thread;
+        std::atomic<bool> busy{false};
+        Snapshot pending;
+        SimulationParams pendingParams;
+        std::string pendingPath;
+};
+
+// SIGTERM (and SIGINT) set a flag instead of killing the process, so the main loop can checkpoint and exit
+void InstallTerminationHandler();
+bool TerminationRequested();
@@ -0,0 +1,56 @@
+#include "conserved.h"
+
+#include <cmath>
+
+ConservedDrift MeasureDrift(const ConservedQuantities& now, const ConservedQuantities& reference) {
+    ConservedDrift drift;
+    if (!now.valid || !reference.valid) return drift;
+
+    double energy = reference.Energy();
+    drift.energy = energy != 0.0 ? (now.Energy() - energy) / std::fabs(energy) : 0.0;
+
+    double momentumScale = std::sqrt(2.0 * reference.mass * reference.kinetic);
+    double dpx = now.px - reference.px, dpy = now.py - reference.py, dpz = now.pz - reference.pz;
+    double dp = std::sqrt(dpx * dpx + dpy * dpy + dpz * dpz);
+    drift.momentum = momentumScale > 0.0 ? dp / momentumScale : dp;
+
+    double l = std::sqrt(reference.lx * reference.lx + reference.ly * reference.ly + reference.lz * reference.lz);
+    double dlx = now.lx - reference.lx, dly = now.ly - reference.ly, dlz = now.lz - reference.lz;
+    double dl = std::sqrt(dlx * dlx + dly * dly + dlz * dlz);
+    drift.angularMomentum = l > 0.0 ? dl / l : dl;
+
+    // The center of mass moves in a straight line at p0 / M
+    if (reference.mass > 0.0) {
+        double elapsed = now.time - reference.time;
+        double ex = reference.comX + reference.px / reference.mass * elapsed - now.comX;
+        double ey = reference.comY + reference.py / reference.mass * elapsed - now.comY;
+        double ez = reference.comZ + reference.pz / reference.mass * elapsed - now.comZ;
+        drift.centerOfMass = std::sqrt(ex * ex + ey * ey + ez * ez);
+    }
+    return drift;
+}
+
+bool ConservedLog::Open(const std::string& path) {
+    Close();
+    file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+    std::fprintf(file, "step,time,mass,kinetic,potential,energy,energy_drift,px,py,pz,momentum_drift,"
+                       "lx,ly,lz,angular_momentum_drift,com_x,com_y,com_z,com_drift\n");
+    return true;
+}
+
+void ConservedLog::Write(uint64_t step, const ConservedQuantities& now, const ConservedQuantities& reference) {
+    if (!file || !now.valid) return;
+    ConservedDrift drift = MeasureDrift(now, reference);
+    std::fprintf(file, "%llu,%.9g,%.9g,%.9g,%.9g,%.9g,%.3e,%.9g,%.9g,%.9g,%.3e,%.9g,%.9g,%.9g,%.3e,%.9g,%.9g,%.9g,%.3e\n",
+                 (unsigned long long)step, now.time, now.mass, now.kinetic, now.potential, now.Energy(), drift.energy,
+                 now.px, now.py, now.pz, drift.momentum, now.lx, now.ly, now.lz, drift.angularMomentum,
+                 now.comX, now.comY, now.comZ, drift.centerOfMass);
+}
+
+void ConservedLog::Close() {
+    if (file) {
+        std::fclose(file);
+        file = nullptr;
+    }
+}
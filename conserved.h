@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "simulation.h"
+
+// How far the conserved quantities moved from their reference, each relative to a natural scale
+struct ConservedDrift {
+    double energy = 0.0;          // (E - E0) / |E0|
+    double momentum = 0.0;        // |p - p0| / sqrt(2 M K0)
+    double angularMomentum = 0.0; // |L - L0| / |L0|
+    double centerOfMass = 0.0;    // distance from where p0 / M would have carried the center of mass, scene units
+};
+
+ConservedDrift MeasureDrift(const ConservedQuantities& now, const ConservedQuantities& reference);
+
+// One CSV row per measurement: the raw sums and their drift
+class ConservedLog {
+    public:
+        ~ConservedLog() { Close(); }
+
+        bool Open(const std::string& path);
+        void Write(uint64_t step, const ConservedQuantities& now, const ConservedQuantities& reference);
+        void Close();
+        bool Active() const { return file != nullptr; }
+
+    private:
+        FILE* file = nullptr;
+};
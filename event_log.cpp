@@ -0,0 +1,158 @@
+#include "event_log.h"
+
+#include <cstring>
+
+#include "checkpoint.h"
+
+namespace {
+
+bool SetError(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+uint64_t Fnv1a(uint64_t hash, const void* data, size_t bytes) {
+    const uint8_t* p = (const uint8_t*)data;
+    for (size_t i = 0; i < bytes; ++i) {
+        hash = (hash ^ p[i]) * 0x100000001B3ull;
+    }
+    return hash;
+}
+
+template <typename T>
+uint64_t HashArray(uint64_t hash, const std::vector<T>& array) {
+    return Fnv1a(hash, array.data(), array.size() * sizeof(T));
+}
+
+}
+
+uint64_t StateHash(const Simulation& simulation) {
+    const BodyStore& bodies = simulation.bodies;
+    uint64_t hash = 0xCBF29CE484222325ull;
+    hash = Fnv1a(hash, &simulation.step, sizeof(simulation.step));
+    hash = Fnv1a(hash, &simulation.time, sizeof(simulation.time));
+    for (const std::vector<float>* array : {&bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz,
+                                            &bodies.mass, &bodies.density, &bodies.radius}) {
+        hash = HashArray(hash, *array);
+    }
+    hash = HashArray(hash, bodies.color);
+    hash = HashArray(hash, bodies.id);
+    return HashArray(hash, bodies.flags);
+}
+
+bool EventRecorder::Open(const std::string& path, const Simulation& simulation) {
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    failed = false;
+    EventLogHeader header = {};
+    std::memcpy(header.magic, eventLogMagic, sizeof(header.magic));
+    header.version = eventLogVersion;
+    header.byteOrder = checkpointByteOrder;
+    header.bodyCount = simulation.bodies.Size();
+    header.step = simulation.step;
+    header.time = simulation.time;
+    header.stateHash = StateHash(simulation);
+    header.speed = simulation.params.speed;
+    header.theta = simulation.params.theta;
+    header.paused = simulation.params.paused;
+    header.collisions = simulation.params.collisions;
+    header.backend = (uint8_t)simulation.params.backend;
+    header.integrator = (uint8_t)simulation.params.integrator;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    return true;
+}
+
+void EventRecorder::Record(uint64_t tick, const Command& command) {
+    if (!file) return;
+    EventRecord record = {};
+    record.tick = tick;
+    record.type = (uint8_t)command.type;
+    record.x = command.x;
+    record.y = command.y;
+    record.z = command.z;
+    record.value = command.value;
+    if (failed) return;
+    if (std::fwrite(&record, sizeof(record), 1, file) != 1) {
+        failed = true; // Close then leaves the log without an end record, so a replay rejects it
+        return;
+    }
+    events++;
+}
+
+bool EventRecorder::Close(uint64_t tick, const Simulation& simulation) {
+    if (!file) return false;
+    EventRecord record = {};
+    record.tick = tick;
+    record.type = eventEnd;
+    EventLogEnd end = {simulation.step, simulation.time, simulation.bodies.Size(), StateHash(simulation)};
+    bool ok = !failed && std::fwrite(&record, sizeof(record), 1, file) == 1 && std::fwrite(&end, sizeof(end), 1, file) == 1;
+    ok = std::fclose(file) == 0 && ok;
+    file = nullptr;
+    return ok;
+}
+
+bool EventReplay::Open(const std::string& path, Simulation& simulation, std::string* error) {
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return SetError(error, "cannot open " + path);
+    EventLogHeader header;
+    bool ok = std::fread(&header, sizeof(header), 1, file) == 1 &&
+              std::memcmp(header.magic, eventLogMagic, sizeof(header.magic)) == 0;
+    if (!ok || header.version != eventLogVersion || header.byteOrder != checkpointByteOrder) {
+        std::fclose(file);
+        return SetError(error, path + " is not an event log of this version");
+    }
+
+    events.clear();
+    next = 0;
+    bool ended = false;
+    EventRecord record;
+    while (std::fread(&record, sizeof(record), 1, file) == 1) {
+        if (record.type == eventEnd) {
+            ended = std::fread(&end, sizeof(end), 1, file) == 1;
+            endTick = record.tick;
+            break;
+        }
+        if (record.type > (uint8_t)CommandType::SetPaused) { // the last CommandType
+            std::fclose(file);
+            return SetError(error, path + " has an unknown event type " + std::to_string(record.type) + " at step " +
+                                   std::to_string(record.tick));
+        }
+        events.push_back(record);
+    }
+    std::fclose(file);
+    if (!ended) {
+        return SetError(error, path + " has no end record (the recording did not exit cleanly, or a write failed)");
+    }
+    if (header.bodyCount != simulation.bodies.Size() || header.step != simulation.step ||
+        header.stateHash != StateHash(simulation)) {
+        return SetError(error, path + " was recorded from a different starting state (" +
+                               std::to_string(header.bodyCount) + " bodies at step " + std::to_string(header.step) +
+                               "); start the replay with the same --scene, --generate or --restart");
+    }
+
+    simulation.params.speed = header.speed;
+    simulation.params.theta = header.theta;
+    simulation.params.paused = header.paused != 0;
+    simulation.params.collisions = header.collisions != 0;
+    simulation.params.backend = header.backend == (uint8_t)ForceBackend::BarnesHut ? ForceBackend::BarnesHut : ForceBackend::Direct;
+    simulation.params.integrator = header.integrator == (uint8_t)Integrator::Leapfrog ? Integrator::Leapfrog : Integrator::Euler;
+    simulation.Invalidate();
+    return true;
+}
+
+void EventReplay::ApplyDue(uint64_t tick, Simulation& simulation) {
+    while (next < events.size() && events[next].tick <= tick) {
+        const EventRecord& record = events[next++];
+        Command command;
+        command.type = (CommandType)record.type;
+        command.x = record.x;
+        command.y = record.y;
+        command.z = record.z;
+        command.value = record.value;
+        simulation.Apply(command);
+    }
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "simulation.h"
+
+// Input event log: every Command the UI sent, keyed by the tick it was applied at (the number of
+// Step calls the simulation thread had made since it started, paused steps included, since those
+// still bounce overlapping bodies). Replaying the commands at the same ticks from the same starting
+// state reproduces the run exactly.
+//
+//   EventLogHeader | EventRecord | ... | EventRecord (type eventEnd) | EventLogEnd
+//
+// The header carries a fingerprint of the starting state instead of the bodies themselves, so a
+// replay must start from the same scene (same --scene, --generate or --restart); the end record
+// carries the fingerprint of the final state to compare against.
+const char eventLogMagic[8] = {'G', 'R', 'A', 'V', 'E', 'V', 'N', 'T'};
+const uint32_t eventLogVersion = 1;
+const uint8_t eventEnd = 0xFF; // EventRecord::type of the last record
+
+struct EventLogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;   // checkpointByteOrder convention: 0x01020304
+    uint64_t bodyCount;
+    uint64_t step;
+    double time;
+    uint64_t stateHash;   // StateHash of the starting state
+    float speed;
+    float theta;
+    uint8_t paused;
+    uint8_t collisions;
+    uint8_t backend;      // ForceBackend
+    uint8_t integrator;   // Integrator
+    uint32_t reserved;
+};
+
+struct EventRecord {
+    uint64_t tick;
+    uint8_t type;         // CommandType, or eventEnd
+    uint8_t reserved[3];
+    float x, y, z, value;
+};
+
+struct EventLogEnd {
+    uint64_t step;
+    double time;
+    uint64_t bodyCount;
+    uint64_t stateHash;
+};
+
+// FNV-1a over step, time and every body array: equal hashes mean (all but certainly) equal states
+uint64_t StateHash(const Simulation& simulation);
+
+// Appends commands as the simulation thread applies them; compact (32 bytes per event) and buffered
+class EventRecorder {
+    public:
+        ~EventRecorder() { if (file) std::fclose(file); }
+
+        // Writes the header from the state the recording starts from
+        bool Open(const std::string& path, const Simulation& simulation);
+        void Record(uint64_t tick, const Command& command);
+        // Writes the end record with the final state, once the simulation thread has stopped
+        bool Close(uint64_t tick, const Simulation& simulation);
+        bool Active() const { return file != nullptr; }
+
+        size_t events = 0;
+
+    private:
+        FILE* file = nullptr;
+        bool failed = false; // a record could not be written; Close writes no end record
+};
+
+// Reads a whole log and feeds its commands back at their ticks
+class EventReplay {
+    public:
+        // Checks the log and that `simulation` is the state it was recorded from, then sets the
+        // recorded parameters (speed, pause, collisions, force backend, integrator)
+        bool Open(const std::string& path, Simulation& simulation, std::string* error = nullptr);
+
+        // Applies the commands recorded at `tick`; call before each step with the ticks taken so far
+        void ApplyDue(uint64_t tick, Simulation& simulation);
+
+        uint64_t EndTick() const { return endTick; }
+        size_t EventCount() const { return events.size(); }
+        const EventLogEnd& End() const { return end; }
+
+    private:
+        std::vector<EventRecord> events;
+        size_t next = 0;
+        uint64_t endTick = 0;
+        EventLogEnd end = {};
+};
@@ -0,0 +1,409 @@
+// Round-trip tests for the file formats: write, read back, compare, and make sure damaged files are
+// rejected instead of trusted. No window or GL context needed; make test builds and runs them.
+// Usage: format_tests [NAME] runs only the cases whose name contains NAME.
+#include <unistd.h>
+#include <cmath>
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "checkpoint.h"
+#include "event_log.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "simulation.h"
+#include "thread_pool.h"
+#include "trajectory.h"
+
+static int failures = 0;
+static std::string testDirectory;
+static std::vector<std::string> testFiles; // removed at exit
+
+static void Check(bool ok, const char* expression, const char* file, int line) {
+    if (ok) return;
+    std::fprintf(stderr, "%s:%d: check failed: %s\n", file, line, expression);
+    failures++;
+}
+#define CHECK(expression) Check((expression), #expression, __FILE__, __LINE__)
+
+static std::string TestPath(const char* name) {
+    std::string path = testDirectory + "/" + name;
+    testFiles.push_back(path);
+    testFiles.push_back(path + ".tmp");
+    return path;
+}
+
+static std::vector<char> ReadFile(const std::string& path) {
+    std::vector<char> bytes;
+    FILE* file = std::fopen(path.c_str(), "rb");
+    if (!file) return bytes;
+    char buffer[4096];
+    size_t got;
+    while ((got = std::fread(buffer, 1, sizeof(buffer), file)) > 0) bytes.insert(bytes.end(), buffer, buffer + got);
+    std::fclose(file);
+    return bytes;
+}
+
+static bool WriteFile(const std::string& path, const std::vector<char>& bytes) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    bool ok = std::fwrite(bytes.data(), 1, bytes.size(), file) == bytes.size();
+    return std::fclose(file) == 0 && ok;
+}
+
+// Every BodyStore array byte for byte
+static bool SameBodies(const BodyStore& a, const BodyStore& b) {
+    if (a.Size() != b.Size()) return false;
+    for (int f = 0; f < (int)CheckpointField::Count; ++f) {
+        CheckpointFieldBytes fieldA = CheckpointFieldView(a, (CheckpointField)f);
+        CheckpointFieldBytes fieldB = CheckpointFieldView(b, (CheckpointField)f);
+        if (a.Size() > 0 && std::memcmp(fieldA.data, fieldB.data, (size_t)fieldA.elementSize * a.Size()) != 0) return false;
+    }
+    return true;
+}
+
+// A few hundred bodies that have moved, so every array holds something other than its initial value
+static void MakeScene(Simulation& simulation, size_t count = 300) {
+    AddGenerated(simulation, SceneGenerator::Plummer, count, 11, nullptr);
+    for (int step = 0; step < 3; ++step) simulation.Step();
+}
+
+static void TestCheckpointRoundTrip() {
+    Simulation simulation;
+    MakeScene(simulation);
+    simulation.params.speed = 2.5f;
+    Snapshot snapshot;
+    simulation.WriteSnapshot(snapshot);
+    const std::string path = TestPath("round_trip.grav");
+    CHECK(WriteCheckpoint(path, snapshot, simulation.params));
+
+    Simulation loaded;
+    std::string error;
+    CHECK(LoadCheckpoint(path, loaded, &error));
+    CHECK(SameBodies(loaded.bodies, simulation.bodies));
+    CHECK(loaded.step == simulation.step);
+    CHECK(loaded.time == simulation.time);
+    CHECK(loaded.params.speed == simulation.params.speed);
+    CHECK(loaded.NextId() == simulation.NextId());
+}
+
+static void TestCheckpointRejectsDamage() {
+    Simulation simulation;
+    MakeScene(simulation);
+    Snapshot snapshot;
+    simulation.WriteSnapshot(snapshot);
+    const std::string path = TestPath("damaged_source.grav");
+    CHECK(WriteCheckpoint(path, snapshot, simulation.params));
+    const std::vector<char> good = ReadFile(path);
+    CHECK(good.size() > sizeof(CheckpointHeader));
+
+    // Cut inside the header, and inside the last section
+    const std::string damaged = TestPath("damaged.grav");
+    for (size_t size : {(size_t)16, sizeof(CheckpointHeader) - 1, good.size() - 1}) {
+        Simulation loaded;
+        CHECK(WriteFile(damaged, std::vector<char>(good.begin(), good.begin() + size)));
+        CHECK(!LoadCheckpoint(damaged, loaded));
+    }
+
+    // A body count far beyond the file, and a section with a wrong element size
+    std::vector<char> bytes = good;
+    const uint64_t hugeCount = 1ull << 62;
+    std::memcpy(bytes.data() + offsetof(CheckpointHeader, bodyCount), &hugeCount, sizeof(hugeCount));
+    CHECK(WriteFile(damaged, bytes));
+    Simulation loaded;
+    CHECK(!LoadCheckpoint(damaged, loaded));
+    bytes = good;
+    const uint32_t wrongSize = 3;
+    std::memcpy(bytes.data() + offsetof(CheckpointHeader, sections) + offsetof(CheckpointSection, elementSize),
+                &wrongSize, sizeof(wrongSize));
+    CHECK(WriteFile(damaged, bytes));
+    CHECK(!LoadCheckpoint(damaged, loaded));
+}
+
+// The frame as it was pushed, to compare the dequantized one against
+static TrajectoryFrame Expected(const Simulation& simulation) {
+    const BodyStore& bodies = simulation.bodies;
+    TrajectoryFrame frame;
+    frame.step = simulation.step;
+    frame.time = simulation.time;
+    frame.id = bodies.id;
+    frame.x = bodies.x; frame.y = bodies.y; frame.z = bodies.z;
+    frame.vx = bodies.vx; frame.vy = bodies.vy; frame.vz = bodies.vz;
+    return frame;
+}
+
+// Within half a quantum, plus the float rounding of the dequantized value
+static bool NearFrame(const TrajectoryFrame& read, const TrajectoryFrame& expected, float positionQuantum,
+                      float velocityQuantum) {
+    if (read.step != expected.step || read.time != expected.time || read.id != expected.id) return false;
+    const std::vector<float>* readArrays[6] = {&read.x, &read.y, &read.z, &read.vx, &read.vy, &read.vz};
+    const std::vector<float>* expectedArrays[6] = {&expected.x, &expected.y, &expected.z,
+                                                   &expected.vx, &expected.vy, &expected.vz};
+    for (int a = 0; a < 6; ++a) {
+        const float quantum = a < 3 ? positionQuantum : velocityQuantum;
+        if (readArrays[a]->size() != expectedArrays[a]->size()) return false;
+        for (size_t i = 0; i < expectedArrays[a]->size(); ++i) {
+            const float want = (*expectedArrays[a])[i];
+            if (!(std::fabs((*readArrays[a])[i] - want) <= 0.5f * quantum + 1e-6f * std::fabs(want))) return false;
+        }
+    }
+    return true;
+}
+
+// 10 frames in chunks of 4: the last chunk is partial
+static void WriteTrajectory(const std::string& path, float positionQuantum, float velocityQuantum,
+                            std::vector<TrajectoryFrame>& expected) {
+    Simulation simulation;
+    MakeScene(simulation, 200);
+    TrajectoryWriter writer;
+    CHECK(writer.Open(path, positionQuantum, velocityQuantum, 4, 4));
+    for (int frame = 0; frame < 10; ++frame) {
+        simulation.Step();
+        CHECK(writer.Push(simulation.bodies, simulation.step, simulation.time, true));
+        expected.push_back(Expected(simulation));
+    }
+    writer.Close();
+    CHECK(!writer.Failed());
+    CHECK(writer.framesWritten == expected.size());
+    CHECK(writer.samplesClamped == 0);
+}
+
+static void TestTrajectoryRoundTrip() {
+    const float positionQuantum = 0.05f, velocityQuantum = 0.005f;
+    const std::string path = TestPath("round_trip.traj");
+    std::vector<TrajectoryFrame> expected;
+    WriteTrajectory(path, positionQuantum, velocityQuantum, expected);
+
+    TrajectoryReader reader;
+    std::string error;
+    CHECK(reader.Open(path, &error));
+    CHECK(reader.Indexed());
+    CHECK(reader.ChunkCount() == 3);
+    CHECK(reader.FrameCount() == expected.size());
+    // Every frame at its own time, in a different order than written, and between two frames
+    TrajectoryFrame frame;
+    for (size_t f : {(size_t)9, (size_t)0, (size_t)5, (size_t)3, (size_t)4}) {
+        CHECK(reader.ReadAt(expected[f].time, frame));
+        CHECK(NearFrame(frame, expected[f], positionQuantum, velocityQuantum));
+    }
+    CHECK(reader.ReadAt(0.5 * (expected[6].time + expected[7].time), frame));
+    CHECK(frame.step == expected[6].step);
+    CHECK(reader.ReadAt(expected[0].time - 1.0, frame));
+    CHECK(frame.step == expected[0].step);
+}
+
+// A writer killed mid-run leaves complete chunks, part of the next one and no index:
+// the reader rebuilds the index by scanning up to the last complete chunk
+static void TestTrajectoryScanAfterKill() {
+    const float positionQuantum = 0.05f, velocityQuantum = 0.005f;
+    const std::string path = TestPath("killed.traj");
+    std::vector<TrajectoryFrame> expected;
+    WriteTrajectory(path, positionQuantum, velocityQuantum, expected);
+
+    std::vector<char> bytes = ReadFile(path);
+    TrajectoryFooter footer;
+    CHECK(bytes.size() > sizeof(TrajectoryHeader) + sizeof(footer));
+    std::memcpy(&footer, bytes.data() + bytes.size() - sizeof(footer), sizeof(footer));
+    CHECK(footer.chunkCount == 3 && footer.indexOffset < bytes.size());
+    std::vector<TrajectoryIndexEntry> index(3);
+    std::memcpy(index.data(), bytes.data() + footer.indexOffset, sizeof(TrajectoryIndexEntry) * index.size());
+    // Half of the last chunk made it to the disk
+    bytes.resize(index[2].offset + (footer.indexOffset - index[2].offset) / 2);
+    CHECK(WriteFile(path, bytes));
+
+    TrajectoryReader reader;
+    CHECK(reader.Open(path));
+    CHECK(!reader.Indexed());
+    CHECK(reader.ChunkCount() == 2);
+    CHECK(reader.FrameCount() == 8);
+    TrajectoryFrame frame;
+    CHECK(reader.ReadAt(expected[7].time, frame));
+    CHECK(NearFrame(frame, expected[7], positionQuantum, velocityQuantum));
+    CHECK(reader.ReadAt(expected[9].time, frame)); // past the end: the last complete frame
+    CHECK(frame.step == expected[7].step);
+    CHECK(reader.ReadAt(expected[1].time, frame));
+    CHECK(NearFrame(frame, expected[1], positionQuantum, velocityQuantum));
+
+    // A chunk header claiming no frames ends the scan there
+    TrajectoryChunkHeader chunk;
+    std::memcpy(&chunk, bytes.data() + index[1].offset, sizeof(chunk));
+    chunk.frameCount = 0;
+    std::memcpy(bytes.data() + index[1].offset, &chunk, sizeof(chunk));
+    CHECK(WriteFile(path, bytes));
+    CHECK(reader.Open(path));
+    CHECK(reader.ChunkCount() == 1);
+}
+
+// Text scene with every optional column in use, loaded on a pool, written as binary and loaded again:
+// both loads must give the same bodies, trail flags included
+static void TestSceneTextBinary() {
+    const std::string textPath = TestPath("scene.txt");
+    FILE* file = std::fopen(textPath.c_str(), "w");
+    CHECK(file != nullptr);
+    if (!file) return;
+    std::fprintf(file, "# x y z vx vy vz mass [density [color [trail]]]\n\n");
+    const size_t count = 5000; // enough lines to be split across the pool
+    for (size_t i = 0; i < count; ++i) {
+        const float t = (float)i;
+        std::fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g", 100.0f * t, -3.5f * t, 0.25f + t, 0.001f * t, -2.0f, 7.0f,
+                     1e20f + 1e17f * t);
+        if (i % 2 == 1) std::fprintf(file, " %.9g", 1000.0f + t);
+        if (i % 4 == 3) std::fprintf(file, " %s", i % 8 == 3 ? "ff8000" : "10203040");
+        if (i % 3 == 0 && i % 2 == 1) std::fprintf(file, " trail");
+        std::fprintf(file, "%s\n", i % 5 == 0 ? "  # comment" : "");
+    }
+    CHECK(std::fclose(file) == 0);
+
+    ThreadPool pool(3);
+    Simulation fromText;
+    std::string error;
+    CHECK(LoadScene(textPath, fromText, &pool, &error));
+    CHECK(fromText.bodies.Size() == count);
+    if (fromText.bodies.Size() != count) return;
+    size_t trails = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const bool trail = i % 3 == 0 && i % 2 == 1;
+        CHECK(((fromText.bodies.flags[i] & BodyTrail) != 0) == trail);
+        trails += trail;
+    }
+    CHECK(trails > 0);
+    CHECK(fromText.bodies.color[3] != fromText.bodies.color[0]);
+
+    const std::string binaryPath = TestPath("scene.bin");
+    CHECK(WriteBinaryScene(binaryPath, fromText.bodies));
+    Simulation fromBinary;
+    CHECK(LoadScene(binaryPath, fromBinary, &pool, &error));
+    CHECK(SameBodies(fromBinary.bodies, fromText.bodies));
+
+    // Only the trail flag is a scene property: transient flags are not written
+    fromText.bodies.flags[0] |= BodyInitializing;
+    CHECK(WriteBinaryScene(binaryPath, fromText.bodies));
+    Simulation again;
+    CHECK(LoadScene(binaryPath, again, nullptr, &error));
+    CHECK(again.bodies.Size() == count && again.bodies.flags[0] == 0);
+}
+
+// The same rule on both paths: a body without positive mass rejects the scene
+static void TestSceneRejectsBadBody() {
+    const std::string textPath = TestPath("bad_scene.txt");
+    FILE* file = std::fopen(textPath.c_str(), "w");
+    CHECK(file != nullptr);
+    if (!file) return;
+    std::fprintf(file, "0 0 0 0 0 0 1e20\n1 0 0 0 0 0 0\n");
+    CHECK(std::fclose(file) == 0);
+    Simulation text;
+    CHECK(!LoadScene(textPath, text, nullptr));
+
+    Simulation simulation;
+    MakeScene(simulation, 100);
+    simulation.bodies.mass[42] = 0.0f;
+    const std::string binaryPath = TestPath("bad_scene.bin");
+    CHECK(WriteBinaryScene(binaryPath, simulation.bodies));
+    Simulation binary;
+    CHECK(!LoadScene(binaryPath, binary, nullptr));
+}
+
+// Records a run with every kind of command, then replays the log from the same starting state the
+// way --replay does: the final state hash must be the recorded one
+static void TestEventRecordReplay() {
+    struct Timed {
+        uint64_t tick;
+        Command command;
+    };
+    const Timed script[] = {
+        {2, {CommandType::SpawnBody, 150.0f, 20.0f, -80.0f, 5e21f}},
+        {3, {CommandType::MoveLast, 1.0f, 0.0f, -2.0f, 0.0f}},
+        {4, {CommandType::GrowLast, 0.0f, 0.0f, 0.0f, 1.5f}},
+        {4, {CommandType::MoveLast, 0.0f, 3.0f, 0.0f, 0.0f}},
+        {6, {CommandType::LaunchLast, 0.0f, 0.0f, 0.0f, 0.0f}},
+        {8, {CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 3.0f}},
+        {10, {CommandType::SetPaused, 0.0f, 0.0f, 0.0f, 1.0f}},
+        {13, {CommandType::SetPaused, 0.0f, 0.0f, 0.0f, 0.0f}},
+    };
+    const uint64_t endTick = 20;
+    const std::string path = TestPath("run.events");
+
+    Simulation recorded;
+    MakeScene(recorded, 150);
+    EventRecorder recorder;
+    CHECK(recorder.Open(path, recorded));
+    size_t next = 0;
+    for (uint64_t tick = 0; tick < endTick; ++tick) {
+        for (; next < sizeof(script) / sizeof(script[0]) && script[next].tick == tick; ++next) {
+            recorder.Record(tick, script[next].command);
+            recorded.Apply(script[next].command);
+        }
+        recorded.Step();
+    }
+    CHECK(recorder.Close(endTick, recorded));
+    CHECK(recorded.bodies.Size() == 151); // the spawned body is still there
+    CHECK(recorder.events == sizeof(script) / sizeof(script[0]));
+
+    Simulation replayed;
+    MakeScene(replayed, 150);
+    EventReplay replay;
+    std::string error;
+    CHECK(replay.Open(path, replayed, &error));
+    CHECK(replay.EndTick() == endTick);
+    CHECK(replay.EventCount() == recorder.events);
+    for (uint64_t tick = 0; tick < replay.EndTick(); ++tick) {
+        replay.ApplyDue(tick, replayed);
+        replayed.Step();
+    }
+    CHECK(StateHash(replayed) == replay.End().stateHash);
+    CHECK(StateHash(replayed) == StateHash(recorded));
+    CHECK(SameBodies(replayed.bodies, recorded.bodies));
+
+    // Another starting state is refused instead of replayed into a different run
+    Simulation other;
+    AddGenerated(other, SceneGenerator::Plummer, 150, 12, nullptr);
+    EventReplay mismatched;
+    CHECK(!mismatched.Open(path, other));
+}
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+static const TestCase testCases[] = {
+    {"checkpoint_round_trip", TestCheckpointRoundTrip},
+    {"checkpoint_rejects_damage", TestCheckpointRejectsDamage},
+    {"trajectory_round_trip", TestTrajectoryRoundTrip},
+    {"trajectory_scan_after_kill", TestTrajectoryScanAfterKill},
+    {"scene_text_binary", TestSceneTextBinary},
+    {"scene_rejects_bad_body", TestSceneRejectsBadBody},
+    {"event_record_replay", TestEventRecordReplay},
+};
+
+int main(int argc, char** argv) {
+    const char* filter = argc > 1 ? argv[1] : "";
+    const char* tmp = std::getenv("TMPDIR");
+    std::string pattern = std::string(tmp && *tmp ? tmp : "/tmp") + "/gravity_tests.XXXXXX";
+    if (!mkdtemp(&pattern[0])) {
+        std::fprintf(stderr, "cannot create a directory for the test files\n");
+        return 1;
+    }
+    testDirectory = pattern;
+
+    int run = 0;
+    for (const TestCase& test : testCases) {
+        if (!std::strstr(test.name, filter)) continue;
+        const int before = failures;
+        test.run();
+        std::printf("%-32s %s\n", test.name, failures == before ? "ok" : "FAILED");
+        run++;
+    }
+
+    for (const std::string& path : testFiles) unlink(path.c_str());
+    rmdir(testDirectory.c_str());
+    if (run == 0) {
+        std::fprintf(stderr, "no test matches '%s'\n", filter);
+        return 1;
+    }
+    std::printf("%d test%s, %d failed check%s\n", run, run == 1 ? "" : "s", failures, failures == 1 ? "" : "s");
+    return failures == 0 ? 0 : 1;
+}
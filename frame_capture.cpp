@@ -0,0 +1,142 @@
+#include "frame_capture.h"
+
+#include <chrono>
+#include <cstring>
+
+bool FrameCapture::Start(const std::string& path, int captureWidth, int captureHeight, int ringSize, size_t depth) {
+    if (!writer.Open(path, captureWidth, captureHeight)) return false;
+    width = captureWidth;
+    height = captureHeight;
+    frameBytes = (size_t)width * height * 4;
+    queueDepth = depth;
+    stopping = false;
+    failed = false;
+
+    slots.assign(ringSize, Slot());
+    for (Slot& slot : slots) {
+        glGenBuffers(1, &slot.pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, frameBytes, nullptr, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    nextSlot = 0;
+
+    encoder = std::thread(&FrameCapture::EncodeLoop, this);
+    active = true;
+    return true;
+}
+
+void FrameCapture::Capture() {
+    auto start = std::chrono::steady_clock::now();
+
+    // The slot about to be reused holds the oldest frame still in flight
+    Slot& slot = slots[nextSlot];
+    if (slot.fence && !Retire(slot, false)) {
+        ringStalls++;
+        Retire(slot, true);
+    }
+
+    // RGBA is the format implementations read back without a conversion pass
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    nextSlot = (nextSlot + 1) % slots.size();
+    framesCaptured++;
+    captureSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+bool FrameCapture::Retire(Slot& slot, bool wait) {
+    GLenum status = glClientWaitSync(slot.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000 : 0);
+    if (status == GL_TIMEOUT_EXPIRED && !wait) return false;
+    glDeleteSync(slot.fence);
+    slot.fence = nullptr;
+
+    std::vector<uint8_t> frame;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (queue.size() >= queueDepth) {
+            queueStalls++;
+            queueSpace.wait(lock, [&] { return queue.size() < queueDepth; });
+        }
+        if (!spare.empty()) {
+            frame.swap(spare.back());
+            spare.pop_back();
+        }
+    }
+    frame.resize(frameBytes);
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, frameBytes, GL_MAP_READ_BIT);
+    if (pixels) {
+        std::memcpy(frame.data(), pixels, frameBytes);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    if (!pixels) {
+        failed = true;
+        return true;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(frame));
+    }
+    queueReady.notify_one();
+    return true;
+}
+
+void FrameCapture::EncodeLoop() {
+    std::vector<uint8_t> rgb((size_t)width * height * 3);
+    for (;;) {
+        std::vector<uint8_t> frame;
+        {
+            std::unique_lock<std::mutex> lock(queueMutex);
+            queueReady.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) return;
+            frame = std::move(queue.front());
+            queue.pop_front();
+        }
+        queueSpace.notify_one();
+
+        // RGBA bottom row first -> RGB top row first
+        for (int y = 0; y < height; ++y) {
+            const uint8_t* src = &frame[(size_t)(height - 1 - y) * width * 4];
+            uint8_t* dst = &rgb[(size_t)y * width * 3];
+            for (int x = 0; x < width; ++x) {
+                dst[3 * x + 0] = src[4 * x + 0];
+                dst[3 * x + 1] = src[4 * x + 1];
+                dst[3 * x + 2] = src[4 * x + 2];
+            }
+        }
+        if (!failed && !writer.Write(rgb)) {
+            failed = true;
+        }
+
+        std::lock_guard<std::mutex> lock(queueMutex);
+        spare.push_back(std::move(frame));
+    }
+}
+
+void FrameCapture::Finish() {
+    if (!active) return;
+    for (size_t i = 0; i < slots.size(); ++i) {
+        Slot& slot = slots[(nextSlot + i) % slots.size()];
+        if (slot.fence) Retire(slot, true);
+    }
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+    encoder.join();
+    writer.Close();
+
+    for (Slot& slot : slots) {
+        glDeleteBuffers(1, &slot.pbo);
+    }
+    slots.clear();
+    active = false;
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "offscreen.h"
+
+// Asynchronous readback of rendered frames. glReadPixels goes into a ring of pixel buffer
+// objects and returns at once; a fence per slot tells when the copy has landed, and the slot
+// is only mapped when it comes round again (ringSize - 1 frames later). Mapped pixels are
+// handed to an encoder thread that flips, converts and writes them through a FrameWriter,
+// so the render thread never waits on the GPU copy or on the disk.
+class FrameCapture {
+    public:
+        bool Start(const std::string& path, int width, int height, int ringSize = 3, size_t queueDepth = 8);
+        // Queue a readback of the current read framebuffer; call after drawing, before swapping
+        void Capture();
+        // Write out every frame still in flight and stop the encoder
+        void Finish();
+
+        bool Active() const { return active; }
+        bool Failed() const { return failed.load(); }  // the encoder could not write a frame
+        int FramesCaptured() const { return framesCaptured; }
+
+        // Render-thread cost, to check the overhead against the frame time
+        double captureSeconds = 0.0; // total time spent in Capture()
+        int ringStalls = 0;          // a slot was still being copied when it was needed again
+        int queueStalls = 0;         // the encoder was behind and the queue was full
+
+    private:
+        struct Slot {
+            GLuint pbo = 0;
+            GLsync fence = nullptr;
+        };
+
+        bool Retire(Slot& slot, bool wait); // false if !wait and the copy has not finished
+        void EncodeLoop();
+
+        bool active = false;
+        int width = 0, height = 0;
+        size_t frameBytes = 0;
+        std::vector<Slot> slots;
+        size_t nextSlot = 0;
+        int framesCaptured = 0;
+
+        FrameWriter writer;
+        std::thread encoder;
+        std::mutex queueMutex;
+        std::condition_variable queueReady, queueSpace;
+        std::deque<std::vector<uint8_t>> queue; // RGBA frames, bottom row first
+        std::vector<std::vector<uint8_t>> spare; // recycled frame buffers
+        size_t queueDepth = 0;
+        bool stopping = false;
+        std::atomic<bool> failed{false};
+};
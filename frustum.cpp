@@ -0,0 +1,131 @@
+#include "frustum.h"
+
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+Frustum ExtractFrustum(const glm::mat4& m) {
+    // glm is column major: row i is (m[0][i], m[1][i], m[2][i], m[3][i])
+    glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+    glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+    glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+    glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+    Frustum frustum;
+    frustum.planes[0] = row3 + row0; // left
+    frustum.planes[1] = row3 - row0; // right
+    frustum.planes[2] = row3 + row1; // bottom
+    frustum.planes[3] = row3 - row1; // top
+    frustum.planes[4] = row3 + row2; // near
+    frustum.planes[5] = row3 - row2; // far
+
+    // normalize so the plane equation gives a real distance (needed for the radius test)
+    for (glm::vec4& plane : frustum.planes) {
+        float length = std::sqrt(plane.x*plane.x + plane.y*plane.y + plane.z*plane.z);
+        plane = plane * (1.0f / length);
+    }
+    return frustum;
+}
+
+bool SphereVisible(const Frustum& frustum, const glm::vec3& center, float radius) {
+    for (const glm::vec4& plane : frustum.planes) {
+        if (plane.x*center.x + plane.y*center.y + plane.z*center.z + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool BoxVisible(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max) {
+    for (const glm::vec4& plane : frustum.planes) {
+        // corner furthest along the plane normal
+        float px = plane.x >= 0.0f ? max.x : min.x;
+        float py = plane.y >= 0.0f ? max.y : min.y;
+        float pz = plane.z >= 0.0f ? max.z : min.z;
+        if (plane.x*px + plane.y*py + plane.z*pz + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void SphereList::Clear() {
+    x.clear();
+    y.clear();
+    z.clear();
+    radius.clear();
+    visible.clear();
+}
+
+void SphereList::Add(const glm::vec3& center, float r) {
+    x.push_back(center.x);
+    y.push_back(center.y);
+    z.push_back(center.z);
+    radius.push_back(r);
+}
+
+size_t CullSpheres(const Frustum& frustum, SphereList& spheres) {
+    const size_t count = spheres.Size();
+    spheres.visible.resize(count);
+    const float* xs = spheres.x.data();
+    const float* ys = spheres.y.data();
+    const float* zs = spheres.z.data();
+    const float* rs = spheres.radius.data();
+    uint8_t* out = spheres.visible.data();
+
+    size_t i = 0;
+    size_t visibleCount = 0;
+
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(xs + i);
+        __m128 y = _mm_loadu_ps(ys + i);
+        __m128 z = _mm_loadu_ps(zs + i);
+        __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(rs + i));
+        __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+        for (const glm::vec4& plane : frustum.planes) {
+            __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, _mm_set1_ps(plane.x)),
+                                             _mm_mul_ps(y, _mm_set1_ps(plane.y))),
+                                  _mm_add_ps(_mm_mul_ps(z, _mm_set1_ps(plane.z)),
+                                             _mm_set1_ps(plane.w)));
+            inside = _mm_and_ps(inside, _mm_cmpge_ps(d, negR));
+        }
+        int mask = _mm_movemask_ps(inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            out[i + lane] = (mask >> lane) & 1;
+        }
+        visibleCount += __builtin_popcount(mask);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        float32x4_t x = vld1q_f32(xs + i);
+        float32x4_t y = vld1q_f32(ys + i);
+        float32x4_t z = vld1q_f32(zs + i);
+        float32x4_t negR = vnegq_f32(vld1q_f32(rs + i));
+        uint32x4_t inside = vdupq_n_u32(0xFFFFFFFFu);
+        for (const glm::vec4& plane : frustum.planes) {
+            float32x4_t d = vdupq_n_f32(plane.w);
+            d = vmlaq_n_f32(d, x, plane.x);
+            d = vmlaq_n_f32(d, y, plane.y);
+            d = vmlaq_n_f32(d, z, plane.z);
+            inside = vandq_u32(inside, vcgeq_f32(d, negR));
+        }
+        uint32_t lanes[4];
+        vst1q_u32(lanes, inside);
+        for (int lane = 0; lane < 4; ++lane) {
+            out[i + lane] = lanes[lane] ? 1 : 0;
+            visibleCount += out[i + lane];
+        }
+    }
+#endif
+
+    for (; i < count; ++i) {
+        out[i] = SphereVisible(frustum, glm::vec3(xs[i], ys[i], zs[i]), rs[i]) ? 1 : 0;
+        visibleCount += out[i];
+    }
+    return visibleCount;
+}
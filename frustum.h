@@ -0,0 +1,30 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Six planes (a, b, c, d) with normals pointing inwards: a point p is inside
+// a plane when a*p.x + b*p.y + c*p.z + d >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// Gribb/Hartmann extraction from projection * view
+Frustum ExtractFrustum(const glm::mat4& viewProjection);
+
+bool SphereVisible(const Frustum& frustum, const glm::vec3& center, float radius);
+bool BoxVisible(const Frustum& frustum, const glm::vec3& min, const glm::vec3& max);
+
+// Bounding spheres stored as separate arrays so they can be tested four at a time
+struct SphereList {
+    std::vector<float> x, y, z, radius;
+    std::vector<uint8_t> visible; // written by CullSpheres, 1 = inside or intersecting
+
+    void Clear();
+    void Add(const glm::vec3& center, float r);
+    size_t Size() const { return x.size(); }
+};
+
+// Tests every sphere against the frustum (SSE2 / NEON when available), returns how many are visible
+size_t CullSpheres(const Frustum& frustum, SphereList& spheres);
@@ -0,0 +1,80 @@
+#include "gpu_timer.h"
+
+bool GpuTimers::Create() {
+#if GRAVITY_PROFILE
+    if (!GLEW_VERSION_3_3 && !GLEW_ARB_timer_query) return false;
+    // some implementations expose the query but count nothing
+    GLint bits = 0;
+    glGetQueryiv(GL_TIME_ELAPSED, GL_QUERY_COUNTER_BITS, &bits);
+    active = bits > 0;
+#endif
+    return active;
+}
+
+void GpuTimers::BeginFrame() {
+    if (!active) return;
+    current ^= 1;
+    Collect(frames[current]);
+}
+
+void GpuTimers::Collect(FrameQueries& frame) {
+    if (frame.used.empty()) return;
+
+    // results arrive in order, so the last query being ready means they all are
+    GLint available = 0;
+    glGetQueryObjectiv(frame.used.back().query, GL_QUERY_RESULT_AVAILABLE, &available);
+    if (available) {
+        double seconds[(int)Phase::Count] = {};
+        bool timed[(int)Phase::Count] = {};
+        for (const Timing& timing : frame.used) {
+            GLuint64 nanoseconds = 0;
+            glGetQueryObjectui64v(timing.query, GL_QUERY_RESULT, &nanoseconds);
+            seconds[(int)timing.phase] += nanoseconds * 1e-9;
+            timed[(int)timing.phase] = true;
+        }
+        for (int i = 0; i < (int)Phase::Count; ++i) {
+            if (timed[i]) ProfileRecord((Phase)i, seconds[i]);
+        }
+    } else {
+        dropped++;
+    }
+
+    // a query whose result was never read can still be reused: beginning it again discards the old one
+    for (const Timing& timing : frame.used) {
+        frame.pool.push_back(timing.query);
+    }
+    frame.used.clear();
+}
+
+void GpuTimers::Begin(Phase phase) {
+    if (!active) return;
+    FrameQueries& frame = frames[current];
+    GLuint query;
+    if (frame.pool.empty()) {
+        glGenQueries(1, &query);
+    } else {
+        query = frame.pool.back();
+        frame.pool.pop_back();
+    }
+    glBeginQuery(GL_TIME_ELAPSED, query);
+    frame.used.push_back({query, phase});
+}
+
+void GpuTimers::End() {
+    if (!active) return;
+    glEndQuery(GL_TIME_ELAPSED);
+}
+
+void GpuTimers::Destroy() {
+    for (FrameQueries& frame : frames) {
+        for (const Timing& timing : frame.used) {
+            frame.pool.push_back(timing.query);
+        }
+        frame.used.clear();
+        if (!frame.pool.empty()) {
+            glDeleteQueries((GLsizei)frame.pool.size(), frame.pool.data());
+        }
+        frame.pool.clear();
+    }
+    active = false;
+}
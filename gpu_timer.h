@@ -0,0 +1,40 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <vector>
+
+#include "profiler.h"
+
+// GPU time of individual draws through GL_TIME_ELAPSED queries. Queries are double-buffered
+// by frame: the results of a frame are collected two frames later, when its query set is
+// reused, so reading them never waits on the GPU. Results that are still not ready by then
+// are dropped rather than waited for. The times go to the profiler under their (Gpu*) phase.
+class GpuTimers {
+    public:
+        int dropped = 0; // frames whose results were not ready in time
+
+        // False if the context has no usable timer queries (the timers then stay inactive)
+        bool Create();
+        // Call once per frame before the first Begin()
+        void BeginFrame();
+        // Time everything between Begin and End under `phase`; pairs cannot nest
+        void Begin(Phase phase);
+        void End();
+        void Destroy();
+        bool Active() const { return active; }
+
+    private:
+        struct Timing {
+            GLuint query;
+            Phase phase;
+        };
+        struct FrameQueries {
+            std::vector<GLuint> pool; // idle queries
+            std::vector<Timing> used; // issued this frame, in order
+        };
+        void Collect(FrameQueries& frame);
+
+        FrameQueries frames[2];
+        int current = 0;
+        bool active = false;
+};
@@ -0,0 +1,339 @@
+#include "gravity_api.h"
+
+#include <atomic>
+#include <cstring>
+#include <exception>
+#include <memory>
+#include <string>
+
+#include "checkpoint.h"
+#include "scene_file.h"
+#include "scenes.h"
+#include "simulation.h"
+#include "thread_pool.h"
+
+struct gravity_sim {
+    Simulation simulation;
+    std::unique_ptr<ThreadPool> ownPool; // null when created in a gravity_pool
+    std::string error;
+};
+
+struct gravity_pool {
+    explicit gravity_pool(size_t threads) : pool(threads) {}
+    ThreadPool pool;
+};
+
+namespace {
+
+int Fail(const gravity_sim* sim, const std::string& message) {
+    const_cast<gravity_sim*>(sim)->error = message;
+    return -1;
+}
+
+int Succeed(const gravity_sim* sim) {
+    const_cast<gravity_sim*>(sim)->error.clear();
+    return 0;
+}
+
+// Runs a call, turning exceptions (out of memory) into an error instead of letting them cross the C boundary
+template <typename Call>
+int Guard(const gravity_sim* sim, const Call& call) {
+    if (!sim) return -1;
+    try {
+        return call();
+    } catch (const std::exception& exception) {
+        return Fail(sim, exception.what());
+    }
+}
+
+bool ValidField(gravity_field field) {
+    return field >= GRAVITY_X && field <= GRAVITY_FLAGS;
+}
+
+int CheckRange(const gravity_sim* sim, size_t first, size_t count) {
+    if (first > sim->simulation.bodies.Size() || count > sim->simulation.bodies.Size() - first) {
+        return Fail(sim, "bodies " + std::to_string(first) + " + " + std::to_string(count) + " out of range (" +
+                         std::to_string(sim->simulation.bodies.Size()) + " bodies)");
+    }
+    return 0;
+}
+
+// gravity_field follows CheckpointField (FieldBytes casts one to the other)
+static_assert((int)GRAVITY_X == (int)CheckpointField::X && (int)GRAVITY_Y == (int)CheckpointField::Y &&
+              (int)GRAVITY_Z == (int)CheckpointField::Z && (int)GRAVITY_VX == (int)CheckpointField::VX &&
+              (int)GRAVITY_VY == (int)CheckpointField::VY && (int)GRAVITY_VZ == (int)CheckpointField::VZ &&
+              (int)GRAVITY_MASS == (int)CheckpointField::Mass && (int)GRAVITY_DENSITY == (int)CheckpointField::Density &&
+              (int)GRAVITY_RADIUS == (int)CheckpointField::Radius && (int)GRAVITY_COLOR == (int)CheckpointField::Color &&
+              (int)GRAVITY_ID == (int)CheckpointField::Id && (int)GRAVITY_FLAGS == (int)CheckpointField::Flags &&
+              (int)GRAVITY_FLAGS + 1 == (int)CheckpointField::Count,
+              "gravity_field and CheckpointField must stay in the same order");
+
+CheckpointFieldBytes FieldBytes(const gravity_sim* sim, gravity_field field) {
+    return CheckpointFieldView(sim->simulation.bodies, (CheckpointField)field);
+}
+
+int GetInterleaved(const gravity_sim* sim, size_t first, size_t count, float* xyz, const std::vector<float>& x,
+                   const std::vector<float>& y, const std::vector<float>& z) {
+    return Guard(sim, [&] {
+        if (CheckRange(sim, first, count) != 0) return -1;
+        if (count > 0 && !xyz) return Fail(sim, "null buffer");
+        for (size_t i = 0; i < count; ++i) {
+            xyz[3 * i] = x[first + i];
+            xyz[3 * i + 1] = y[first + i];
+            xyz[3 * i + 2] = z[first + i];
+        }
+        return Succeed(sim);
+    });
+}
+
+}
+
+int gravity_api_version(void) {
+    return GRAVITY_API_VERSION;
+}
+
+gravity_sim* gravity_create(int threads) {
+    try {
+        gravity_sim* sim = new gravity_sim;
+        sim->ownPool.reset(new ThreadPool(threads > 0 ? (size_t)threads : 0));
+        sim->simulation.pool = sim->ownPool.get();
+        return sim;
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+gravity_pool* gravity_pool_create(int threads) {
+    try {
+        return new gravity_pool(threads > 0 ? (size_t)threads : 0);
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void gravity_pool_destroy(gravity_pool* pool) {
+    delete pool;
+}
+
+gravity_sim* gravity_create_in_pool(gravity_pool* pool) {
+    if (!pool) return nullptr;
+    try {
+        gravity_sim* sim = new gravity_sim;
+        sim->simulation.pool = &pool->pool;
+        return sim;
+    } catch (const std::exception&) {
+        return nullptr;
+    }
+}
+
+void gravity_destroy(gravity_sim* sim) {
+    delete sim;
+}
+
+const char* gravity_last_error(const gravity_sim* sim) {
+    return sim ? sim->error.c_str() : "null simulation";
+}
+
+int gravity_load_scene(gravity_sim* sim, const char* path) {
+    return Guard(sim, [&] {
+        std::string error;
+        if (!path || !LoadScene(path, sim->simulation, sim->simulation.pool, &error)) return Fail(sim, path ? error : "null path");
+        return Succeed(sim);
+    });
+}
+
+int gravity_load_checkpoint(gravity_sim* sim, const char* path) {
+    return Guard(sim, [&] {
+        std::string error;
+        if (!path || !LoadCheckpoint(path, sim->simulation, &error)) return Fail(sim, path ? error : "null path");
+        return Succeed(sim);
+    });
+}
+
+int gravity_save_checkpoint(gravity_sim* sim, const char* path) {
+    return Guard(sim, [&] {
+        Snapshot snapshot;
+        sim->simulation.WriteSnapshot(snapshot);
+        if (!path || !WriteCheckpoint(path, snapshot, sim->simulation.params)) {
+            return Fail(sim, std::string("cannot write ") + (path ? path : "null path"));
+        }
+        return Succeed(sim);
+    });
+}
+
+int gravity_generate(gravity_sim* sim, const char* name, size_t count, uint32_t seed) {
+    return Guard(sim, [&] {
+        SceneGenerator generator;
+        if (!name || !ParseSceneGenerator(name, generator)) {
+            return Fail(sim, std::string("unknown generator ") + (name ? name : "(null)"));
+        }
+        if (count == 0) return Fail(sim, "no bodies to generate");
+        AddGenerated(sim->simulation, generator, count, seed, sim->simulation.pool);
+        return Succeed(sim);
+    });
+}
+
+int gravity_add_bodies(gravity_sim* sim, size_t count, const float* x, const float* y, const float* z,
+                       const float* vx, const float* vy, const float* vz, const float* mass, const float* density) {
+    return Guard(sim, [&] {
+        if (count > 0 && (!x || !y || !z || !vx || !vy || !vz || !mass)) return Fail(sim, "null buffer");
+        Simulation& simulation = sim->simulation;
+        simulation.bodies.Reserve(simulation.bodies.Size() + count);
+        for (size_t i = 0; i < count; ++i) {
+            simulation.AddBody(x[i], y[i], z[i], vx[i], vy[i], vz[i], mass[i], density ? density[i] : 3344.0f,
+                               PackColor(0.8f, 0.8f, 0.8f, 1.0f));
+        }
+        return Succeed(sim);
+    });
+}
+
+void gravity_clear(gravity_sim* sim) {
+    if (!sim) return;
+    sim->simulation.bodies.Clear();
+    sim->simulation.Invalidate();
+}
+
+size_t gravity_body_count(const gravity_sim* sim) {
+    return sim ? sim->simulation.bodies.Size() : 0;
+}
+
+int gravity_get_field(const gravity_sim* sim, gravity_field field, size_t first, size_t count, void* out) {
+    return Guard(sim, [&] {
+        if (!ValidField(field)) return Fail(sim, "unknown field");
+        if (CheckRange(sim, first, count) != 0) return -1;
+        if (count > 0 && !out) return Fail(sim, "null buffer");
+        CheckpointFieldBytes bytes = FieldBytes(sim, field);
+        if (count > 0) std::memcpy(out, (const uint8_t*)bytes.data + first * bytes.elementSize, count * bytes.elementSize);
+        return Succeed(sim);
+    });
+}
+
+int gravity_set_field(gravity_sim* sim, gravity_field field, size_t first, size_t count, const void* in) {
+    return Guard(sim, [&] {
+        if (!ValidField(field)) return Fail(sim, "unknown field");
+        if (field == GRAVITY_RADIUS || field == GRAVITY_ID) return Fail(sim, "radius and id are read only");
+        if (CheckRange(sim, first, count) != 0) return -1;
+        if (count > 0 && !in) return Fail(sim, "null buffer");
+        CheckpointFieldBytes bytes = FieldBytes(sim, field);
+        if (count > 0) {
+            std::memcpy((uint8_t*)const_cast<void*>(bytes.data) + first * bytes.elementSize, in, count * bytes.elementSize);
+        }
+        BodyStore& bodies = sim->simulation.bodies;
+        if (field == GRAVITY_MASS || field == GRAVITY_DENSITY) {
+            for (size_t i = first; i < first + count; ++i) bodies.radius[i] = BodyRadius(bodies.mass[i], bodies.density[i]);
+        }
+        sim->simulation.Invalidate();
+        return Succeed(sim);
+    });
+}
+
+int gravity_get_positions(const gravity_sim* sim, size_t first, size_t count, float* xyz) {
+    if (!sim) return -1;
+    const BodyStore& bodies = sim->simulation.bodies;
+    return GetInterleaved(sim, first, count, xyz, bodies.x, bodies.y, bodies.z);
+}
+
+int gravity_get_velocities(const gravity_sim* sim, size_t first, size_t count, float* xyz) {
+    if (!sim) return -1;
+    const BodyStore& bodies = sim->simulation.bodies;
+    return GetInterleaved(sim, first, count, xyz, bodies.vx, bodies.vy, bodies.vz);
+}
+
+const void* gravity_field_data(const gravity_sim* sim, gravity_field field) {
+    if (!sim || !ValidField(field)) return nullptr;
+    return FieldBytes(sim, field).data;
+}
+
+int gravity_set_speed(gravity_sim* sim, float speed) {
+    return Guard(sim, [&] {
+        if (!(speed > 0.0f)) return Fail(sim, "speed must be positive");
+        sim->simulation.Apply({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, speed});
+        return Succeed(sim);
+    });
+}
+
+int gravity_set_collisions(gravity_sim* sim, int enabled) {
+    return Guard(sim, [&] {
+        sim->simulation.params.collisions = enabled != 0;
+        sim->simulation.Invalidate();
+        return Succeed(sim);
+    });
+}
+
+int gravity_set_backend(gravity_sim* sim, const char* name) {
+    return Guard(sim, [&] {
+        if (!name || !ParseForceBackend(name, sim->simulation.params.backend)) {
+            return Fail(sim, std::string("unknown force backend ") + (name ? name : "(null)"));
+        }
+        sim->simulation.Invalidate();
+        return Succeed(sim);
+    });
+}
+
+int gravity_set_theta(gravity_sim* sim, float theta) {
+    return Guard(sim, [&] {
+        if (!(theta >= 0.0f)) return Fail(sim, "theta must not be negative");
+        sim->simulation.params.theta = theta;
+        sim->simulation.Invalidate();
+        return Succeed(sim);
+    });
+}
+
+int gravity_set_integrator(gravity_sim* sim, const char* name) {
+    return Guard(sim, [&] {
+        if (!name || !ParseIntegrator(name, sim->simulation.params.integrator)) {
+            return Fail(sim, std::string("unknown integrator ") + (name ? name : "(null)"));
+        }
+        sim->simulation.Invalidate();
+        return Succeed(sim);
+    });
+}
+
+int gravity_step(gravity_sim* sim, uint64_t steps) {
+    return Guard(sim, [&] {
+        for (uint64_t s = 0; s < steps; ++s) sim->simulation.Step();
+        return Succeed(sim);
+    });
+}
+
+int gravity_step_all(gravity_sim* const* sims, size_t count, uint64_t steps, gravity_pool* pool) {
+    if (count > 0 && !sims) return -1;
+    for (size_t i = 0; i < count; ++i) {
+        if (!sims[i]) return -1;
+    }
+    // A nested ParallelFor finds the pool busy and runs inline, so every simulation steps exactly
+    // as it would alone; gravity_step catches exceptions before they reach a pool thread
+    std::atomic<bool> failed{false};
+    auto run = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            if (gravity_step(sims[i], steps) != 0) failed.store(true, std::memory_order_relaxed);
+        }
+    };
+    if (pool) {
+        pool->pool.ParallelFor(0, count, 1, run);
+    } else {
+        run(0, count, 0);
+    }
+    return failed.load() ? -1 : 0;
+}
+
+uint64_t gravity_step_count(const gravity_sim* sim) {
+    return sim ? sim->simulation.step : 0;
+}
+
+double gravity_time(const gravity_sim* sim) {
+    return sim ? sim->simulation.time : 0.0;
+}
+
+uint64_t gravity_interactions(const gravity_sim* sim) {
+    return sim ? sim->simulation.totalInteractions : 0;
+}
+
+int gravity_energy(const gravity_sim* sim, double* kinetic, double* potential) {
+    if (!sim) return -1;
+    const ConservedQuantities& conserved = sim->simulation.conserved;
+    if (!conserved.valid) return Fail(sim, "no step taken yet");
+    if (kinetic) *kinetic = conserved.kinetic;
+    if (potential) *potential = conserved.potential;
+    return Succeed(sim);
+}
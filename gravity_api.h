@@ -0,0 +1,101 @@
+/* C interface to the simulation core, built as a shared library (make libgravity): create a
+ * simulation, fill it, step it and read it back without GLFW or the interactive program.
+ * Bulk calls copy whole arrays to and from caller-owned buffers in one call; gravity_field_data
+ * reads an array in place. Functions returning int give 0 on success and -1 on failure, with the
+ * reason in gravity_last_error. A handle may be used from one thread at a time; different handles
+ * are independent and may be used concurrently, also when they share a gravity_pool. */
+#ifndef GRAVITY_API_H
+#define GRAVITY_API_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(GRAVITY_BUILD_LIBRARY)
+#define GRAVITY_API __attribute__((visibility("default")))
+#else
+#define GRAVITY_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Bumped when a function's meaning or signature changes; new functions do not bump it */
+#define GRAVITY_API_VERSION 1
+
+typedef struct gravity_sim gravity_sim;
+typedef struct gravity_pool gravity_pool;
+
+/* Body arrays; all are 4 bytes per body (float, or uint32_t for COLOR and ID) except FLAGS (uint8_t) */
+typedef enum gravity_field {
+    GRAVITY_X, GRAVITY_Y, GRAVITY_Z,
+    GRAVITY_VX, GRAVITY_VY, GRAVITY_VZ,
+    GRAVITY_MASS,     /* kg; setting it (or DENSITY) updates RADIUS */
+    GRAVITY_DENSITY,  /* kg / m^3 */
+    GRAVITY_RADIUS,   /* scene units, read only */
+    GRAVITY_COLOR,    /* RGBA8, red in the low byte */
+    GRAVITY_ID,       /* stable across steps, read only */
+    GRAVITY_FLAGS
+} gravity_field;
+
+GRAVITY_API int gravity_api_version(void);
+
+/* threads: force-pass workers including the caller, 0 = one per hardware thread. NULL when out of memory. */
+GRAVITY_API gravity_sim* gravity_create(int threads);
+GRAVITY_API void gravity_destroy(gravity_sim* sim);
+/* Message of the last failed call on this handle, "" if none; valid until the next call */
+GRAVITY_API const char* gravity_last_error(const gravity_sim* sim);
+
+/* Worker threads shared by many simulations (parameter sweeps) instead of one pool per handle.
+ * threads as in gravity_create. Destroy the pool after every simulation created in it. */
+GRAVITY_API gravity_pool* gravity_pool_create(int threads);
+GRAVITY_API void gravity_pool_destroy(gravity_pool* pool);
+/* A simulation whose force pass runs on `pool`. NULL when out of memory or pool is NULL. */
+GRAVITY_API gravity_sim* gravity_create_in_pool(gravity_pool* pool);
+
+/* Bodies. Loading and generating append to the current bodies; a checkpoint replaces everything. */
+GRAVITY_API int gravity_load_scene(gravity_sim* sim, const char* path);
+GRAVITY_API int gravity_load_checkpoint(gravity_sim* sim, const char* path);
+GRAVITY_API int gravity_save_checkpoint(gravity_sim* sim, const char* path);
+/* name: plummer, hernquist, disk or cube */
+GRAVITY_API int gravity_generate(gravity_sim* sim, const char* name, size_t count, uint32_t seed);
+/* Appends count bodies from separate arrays; density may be NULL (3344) */
+GRAVITY_API int gravity_add_bodies(gravity_sim* sim, size_t count, const float* x, const float* y, const float* z,
+                                   const float* vx, const float* vy, const float* vz, const float* mass,
+                                   const float* density);
+GRAVITY_API void gravity_clear(gravity_sim* sim);
+GRAVITY_API size_t gravity_body_count(const gravity_sim* sim);
+
+/* Copies bodies [first, first + count) of one array to or from a caller buffer */
+GRAVITY_API int gravity_get_field(const gravity_sim* sim, gravity_field field, size_t first, size_t count, void* out);
+GRAVITY_API int gravity_set_field(gravity_sim* sim, gravity_field field, size_t first, size_t count, const void* in);
+/* Positions or velocities as interleaved x, y, z triples (3 * count floats) */
+GRAVITY_API int gravity_get_positions(const gravity_sim* sim, size_t first, size_t count, float* xyz);
+GRAVITY_API int gravity_get_velocities(const gravity_sim* sim, size_t first, size_t count, float* xyz);
+/* The array itself, without copying; valid until the next call that steps or changes the bodies */
+GRAVITY_API const void* gravity_field_data(const gravity_sim* sim, gravity_field field);
+
+/* Parameters */
+GRAVITY_API int gravity_set_speed(gravity_sim* sim, float speed);        /* time step multiplier, dt = speed / 94 */
+GRAVITY_API int gravity_set_collisions(gravity_sim* sim, int enabled);
+GRAVITY_API int gravity_set_backend(gravity_sim* sim, const char* name);  /* direct or barnes-hut */
+GRAVITY_API int gravity_set_theta(gravity_sim* sim, float theta);
+GRAVITY_API int gravity_set_integrator(gravity_sim* sim, const char* name); /* euler or leapfrog */
+
+/* Time */
+GRAVITY_API int gravity_step(gravity_sim* sim, uint64_t steps);
+/* Steps every simulation (each handle at most once), one per task on `pool`, NULL: one after
+ * another on the calling thread. Each one's own loops run on the thread stepping it. -1 if any
+ * failed, with the reason in that handle's gravity_last_error. */
+GRAVITY_API int gravity_step_all(gravity_sim* const* sims, size_t count, uint64_t steps, gravity_pool* pool);
+GRAVITY_API uint64_t gravity_step_count(const gravity_sim* sim);
+GRAVITY_API double gravity_time(const gravity_sim* sim);
+GRAVITY_API uint64_t gravity_interactions(const gravity_sim* sim);
+/* Kinetic and potential energy measured by the last step (scene units); -1 before the first step */
+GRAVITY_API int gravity_energy(const gravity_sim* sim, double* kinetic, double* potential);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
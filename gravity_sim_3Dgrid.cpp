@@ -5,13 +5,43 @@
 #include <glm/gtc/type_ptr.hpp>
 #include <vector>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "shader_program.h"
+#include "render_queue.h"
+#include "frustum.h"
+#include "hud_text.h"
+#include "simulation.h"
+#include "simulation_thread.h"
+#include "interpolation.h"
+#include "options.h"
+#include "offscreen.h"
+#include "frame_capture.h"
+#include "profiler.h"
+#include "gpu_timer.h"
+#include "trace.h"
+#include "grid.h"
+#include "sphere_mesh.h"
+#include "trails.h"
+#include "scenes.h"
+#include "thread_pool.h"
+#include "conserved.h"
+#include "checkpoint.h"
+#include "trajectory.h"
+#include "scene_file.h"
+#include "event_log.h"
+#include "shared_snapshots.h"
 
 const char* vertexShaderSource = R"glsl(
 #version 330 core
 layout(location=0) in vec3 aPos;
 uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
 void main() {
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 })glsl";
@@ -25,305 +55,383 @@ void main() {
 }
 )glsl";
 
-bool running = true;
-bool pause = false;
-float simulationSpeed = 1.0f; // Default simulation speed multiplier
-glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f,  1.0f);
-glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
-glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f,  0.0f);
-float lastX = 400.0, lastY = 300.0;
-float yaw = -90;
-float pitch =0.0;
-float deltaTime = 0.0;
-float lastFrame = 0.0;
-
-const double G = 6.6743e-11; // m^3 kg^-1 s^-2
-const float c = 299792458.0;
-float initMass = 5.0f * pow(10, 20) / 5;
-
-GLFWwindow* StartGLU();
-GLuint CreateShaderProgram(const char* vertexSource, const char* fragmentSource);
+// Instanced spheres: per-instance center/radius and color, one draw for every body (or trail sphere)
+const char* instancedVertexShaderSource = R"glsl(
+#version 330 core
+layout(location=0) in vec3 aPos;
+layout(location=1) in vec4 aCenterRadius;
+layout(location=2) in vec4 aColor;
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+out vec4 vColor;
+void main() {
+    vColor = aColor;
+    gl_Position = projection * view * vec4(aPos * aCenterRadius.w + aCenterRadius.xyz, 1.0);
+})glsl";
+
+const char* instancedFragmentShaderSource = R"glsl(
+#version 330 core
+in vec4 vColor;
+out vec4 FragColor;
+void main() {
+    FragColor = vColor;
+}
+)glsl";
+
+// One simulated scene and the view of it: main owns it and the GLFW callbacks reach it through the
+// window user pointer, so nothing about the scene is global. The rest of the globals below are GL
+// resources and overlay settings of the single window.
+struct ViewerState {
+    // The simulation steps on its own thread at a fixed rate (--step-rate)
+    explicit ViewerState(double stepRate) : simulationThread(simulation, stepRate) {}
+
+    Simulation simulation;
+    SimulationThread simulationThread;
+    bool running = true;
+    bool pause = false;       // last pause state sent to the simulation
+    bool placingBody = false; // left mouse held: the newest body is still being placed
+    float initMass = 5.0f * pow(10, 20) / 5;
+    SnapshotInterpolator interpolator; // smooth body motion between the fixed steps
+    Trails trails;                     // render-side trails, sampled from the snapshots
+
+    glm::vec3 cameraPos   = glm::vec3(0.0f, 0.0f,  1.0f);
+    glm::vec3 cameraFront = glm::vec3(0.0f, 0.0f, -1.0f);
+    glm::vec3 cameraUp    = glm::vec3(0.0f, 1.0f,  0.0f);
+    float lastX = 400.0, lastY = 300.0;
+    float yaw = -90;
+    float pitch = 0.0;
+    float deltaTime = 0.0;
+    float lastFrame = 0.0;
+};
+
+ViewerState& Viewer(GLFWwindow* window) {
+    return *static_cast<ViewerState*>(glfwGetWindowUserPointer(window));
+}
+
+// view/projection shared by all programs; the screen camera is the HUD's pixel projection (origin top-left)
+CameraUniforms sceneCamera;
+CameraUniforms screenCamera;
+glm::mat4 sceneProjection; // CPU copy of the scene projection, for frustum culling
+
+RenderQueue renderQueue;
+GpuTimers gpuTimers; // GPU time of the grid, body, trail and HUD draws, shown with the CPU phases
+
+// On-screen statistics, refreshed every hudInterval seconds
+HudText hud;
+bool showHud = true;
+bool showRenderStats = false;
+bool showProfile = false;
+
+std::string tracePath;    // --trace
+bool traceRequested = false; // T pressed: write the trace so far
+const double hudInterval = 0.5;
+
+GLFWwindow* StartGLU(int width, int height, bool headless);
 void CreateVBOVAO(GLuint& VAO, GLuint& VBO, const float* vertices, size_t vertexCount);
-void UpdateCam(GLuint shaderProgram, glm::vec3 cameraPos);
+glm::mat4 UpdateCam(const CameraUniforms& camera, const ViewerState& viewer);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
-glm::vec3 sphericalToCartesian(float r, float theta, float phi);
-void DrawGrid(GLuint shaderProgram, GLuint gridVAO, size_t vertexCount);
+void DrawGrid(RenderQueue& queue, const ShaderProgram& shader, GLuint gridVAO, size_t vertexCount);
 
-// Function prototype for renderText (declare it before using it)
-void renderText(const std::string& text, float x, float y, float scale, GLuint shaderProgram, GLint colorLoc);
+// Shared sphere geometry: every body (and every trail sphere) draws the same unit sphere
+// scaled by its radius, so the whole scene binds two VAOs instead of one per body
+struct Mesh {
+    GLuint VAO = 0, VBO = 0;
+    size_t vertexCount = 0;
+};
+Mesh bodyMesh;  // 10x10 unit sphere
+Mesh trailMesh; // 8x8 unit sphere
 
-class Object {
-    public:
-        GLuint VAO, VBO;
-        glm::vec3 position = glm::vec3(400, 300, 0);
-        glm::vec3 velocity = glm::vec3(0, 0, 0);
-        size_t vertexCount;
-        glm::vec4 color = glm::vec4(1.0f, 0.0f, 0.0f, 1.0f);
+// Per-instance data of the instanced sphere shader
+struct SphereInstance {
+    glm::vec4 centerRadius;
+    glm::vec4 color;
+};
 
-        bool Initalizing = false;
-        bool Launched = false;
-        bool target = false;
+// A sphere mesh plus a streamed instance buffer; one glDrawArraysInstanced per batch
+struct SphereBatch {
+    GLuint VAO = 0, instanceVBO = 0;
+    size_t capacity = 0;
+    std::vector<SphereInstance> instances;
+};
+void CreateSphereBatch(SphereBatch& batch, const Mesh& mesh);
+void UploadSphereBatch(SphereBatch& batch);
+SphereBatch bodyBatch;
+SphereBatch trailBatch;
 
-        float mass;
-        float density;  // kg / m^3  HYDROGEN
-        float radius;
+glm::vec4 UnpackColor(uint32_t color);
 
-        glm::vec3 LastPos = position;
-        
-        // Trail as spheres
-        struct TrailSphere {
-            glm::vec3 position;
-            GLuint VAO, VBO;
-            size_t vertexCount;
-        };
-        
-        std::vector<TrailSphere> trailSpheres;
-        int maxTrailLength = 30; // Fewer, larger spheres
-        bool hasTrail = false; // Flag to determine if this object should have a trail
-
-        Object(glm::vec3 initPosition, glm::vec3 initVelocity, float mass, float density = 3344) {   
-            this->position = initPosition;
-            this->velocity = initVelocity;
-            this->mass = mass;
-            this->density = density;
-            this->radius = pow(((3 * this->mass/this->density)/(4 * 3.14159265359)), (1.0f/3.0f)) / 100000;
-            
-            // Initialize trail vectors (but don't create any spheres yet)
-            trailSpheres.clear();
-
-            // Generate vertices (centered at origin)
-            std::vector<float> vertices = Draw();
-            vertexCount = vertices.size();
-
-            CreateVBOVAO(VAO, VBO, vertices.data(), vertexCount);
-        }
-
-        std::vector<float> Draw() {
-            std::vector<float> vertices;
-            int stacks = 10;
-            int sectors = 10;
-
-            // Generate circumference points using integer steps
-            for(float i = 0.0f; i <= stacks; ++i){
-                float theta1 = (i / stacks) * glm::pi<float>();
-                float theta2 = (i+1) / stacks * glm::pi<float>();
-                for (float j = 0.0f; j < sectors; ++j){
-                    float phi1 = j / sectors * 2 * glm::pi<float>();
-                    float phi2 = (j+1) / sectors * 2 * glm::pi<float>();
-                    glm::vec3 v1 = sphericalToCartesian(radius, theta1, phi1);
-                    glm::vec3 v2 = sphericalToCartesian(radius, theta1, phi2);
-                    glm::vec3 v3 = sphericalToCartesian(radius, theta2, phi1);
-                    glm::vec3 v4 = sphericalToCartesian(radius, theta2, phi2);
-
-                    // Triangle 1: v1-v2-v3
-                    vertices.insert(vertices.end(), {v1.x, v1.y, v1.z}); //      /|
-                    vertices.insert(vertices.end(), {v2.x, v2.y, v2.z}); //     / |
-                    vertices.insert(vertices.end(), {v3.x, v3.y, v3.z}); //    /__|
-                    
-                    // Triangle 2: v2-v4-v3
-                    vertices.insert(vertices.end(), {v2.x, v2.y, v2.z});
-                    vertices.insert(vertices.end(), {v4.x, v4.y, v4.z});
-                    vertices.insert(vertices.end(), {v3.x, v3.y, v3.z});
-                }   
-            }
-            return vertices;
+GLuint gridVAO, gridVBO; // quadtree grid, buffer sized once for gridVertexBudget vertices
+
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!ParseOptions(argc, argv, options)) {
+        return 1;
+    }
+    InstallTerminationHandler(); // SIGTERM / SIGINT leave the loop below, so the exit path (and checkpoint) runs
+
+    // The starting state does not need a window (replays never open one)
+    ThreadPool forcePool(options.threads); // outlives the simulation thread, which is stopped before main returns
+    ViewerState viewer(options.stepRate);
+    Simulation& simulation = viewer.simulation;
+    SimulationThread& simulationThread = viewer.simulationThread;
+    simulation.pool = &forcePool;
+    // A restart takes bodies, time and parameters from the checkpoint
+    if (!options.restart.empty()) {
+        std::string error;
+        if (!LoadCheckpoint(options.restart, simulation, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
         }
-        
-        void UpdatePos(){
-            this->position[0] += this->velocity[0] / 94 * simulationSpeed;
-            this->position[1] += this->velocity[1] / 94 * simulationSpeed;
-            this->position[2] += this->velocity[2] / 94 * simulationSpeed;
-            this->radius = pow(((3 * this->mass/this->density)/(4 * 3.14159265359)), (1.0f/3.0f)) / 100000;
-            
-            // Update trail after position change
-            if (hasTrail) {
-                UpdateTrail();
-            }
+        std::cout << "Restarted from " << options.restart << ": " << simulation.bodies.Size() << " bodies, step "
+                  << simulation.step << ", t = " << simulation.time << std::endl;
+        if (options.headless && simulation.params.paused) {
+            // Saved while K was held; nothing can unpause a headless run, and time would never advance
+            simulation.params.paused = false;
+            std::cout << "The checkpoint was paused; resuming for the headless run" << std::endl;
         }
-        void UpdateVertices() {
-            // Generate new vertices with current radius
-            std::vector<float> vertices = Draw();
-            
-            // Update the VBO with new vertex data
-            glBindBuffer(GL_ARRAY_BUFFER, VBO);
-            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
-        }
-        glm::vec3 GetPos() const {
-            return this->position;
-        }
-        void accelerate(float x, float y, float z){
-            this->velocity[0] += x / 96 * simulationSpeed;
-            this->velocity[1] += y / 96 * simulationSpeed;
-            this->velocity[2] += z / 96 * simulationSpeed;
-        }
-        float CheckCollision(const Object& other) {
-            float dx = other.position[0] - this->position[0];
-            float dy = other.position[1] - this->position[1];
-            float dz = other.position[2] - this->position[2];
-            float distance = std::pow(dx*dx + dy*dy + dz*dz, (1.0f/2.0f));
-            if (other.radius + this->radius > distance){
-                return -0.2f;
-            }
-            return 1.0f;
-        }
-
-        // Method to update the trail positions
-        void UpdateTrail() {
-            if (!hasTrail) return; // Skip if trail is not enabled
-            
-            // Only add a new sphere every few frames
-            static int frameCount = 0;
-            frameCount++;
-            if (frameCount % 5 == 0) { // Add a new sphere every 5 frames
-                // Create a new trail sphere
-                TrailSphere newSphere;
-                newSphere.position = position;
-                
-                // Create a smaller sphere
-                float trailSphereRadius = radius * 0.3f; // 30% the size of the main object
-                std::vector<float> vertices;
-                int stacks = 8;
-                int sectors = 8;
-                
-                // Generate the sphere vertices
-                for(float i = 0.0f; i <= stacks; ++i){
-                    float theta1 = (i / stacks) * glm::pi<float>();
-                    float theta2 = (i+1) / stacks * glm::pi<float>();
-                    for (float j = 0.0f; j < sectors; ++j){
-                        float phi1 = j / sectors * 2 * glm::pi<float>();
-                        float phi2 = (j+1) / sectors * 2 * glm::pi<float>();
-                        glm::vec3 v1 = sphericalToCartesian(trailSphereRadius, theta1, phi1);
-                        glm::vec3 v2 = sphericalToCartesian(trailSphereRadius, theta1, phi2);
-                        glm::vec3 v3 = sphericalToCartesian(trailSphereRadius, theta2, phi1);
-                        glm::vec3 v4 = sphericalToCartesian(trailSphereRadius, theta2, phi2);
-
-                        // Triangle 1
-                        vertices.insert(vertices.end(), {v1.x, v1.y, v1.z});
-                        vertices.insert(vertices.end(), {v2.x, v2.y, v2.z});
-                        vertices.insert(vertices.end(), {v3.x, v3.y, v3.z});
-                        
-                        // Triangle 2
-                        vertices.insert(vertices.end(), {v2.x, v2.y, v2.z});
-                        vertices.insert(vertices.end(), {v4.x, v4.y, v4.z});
-                        vertices.insert(vertices.end(), {v3.x, v3.y, v3.z});
-                    }   
-                }
-                
-                newSphere.vertexCount = vertices.size();
-                CreateVBOVAO(newSphere.VAO, newSphere.VBO, vertices.data(), vertices.size());
-                
-                // Add to trail
-                trailSpheres.push_back(newSphere);
-                
-                // Keep trail at maximum length
-                if (trailSpheres.size() > static_cast<size_t>(maxTrailLength)) {
-                    // Clean up the oldest sphere
-                    glDeleteVertexArrays(1, &trailSpheres[0].VAO);
-                    glDeleteBuffers(1, &trailSpheres[0].VBO);
-                    trailSpheres.erase(trailSpheres.begin());
-                }
-                
-                // Remove trail size debug print
+    } else {
+        if (!options.scene.empty()) {
+            std::string error;
+            double loadStart = SteadySeconds();
+            if (!LoadScene(options.scene, simulation, &forcePool, &error)) {
+                std::cerr << error << std::endl;
+                return 1;
             }
+            std::cout << "Loaded " << simulation.bodies.Size() << " bodies from " << options.scene << " in "
+                      << SteadySeconds() - loadStart << " s" << std::endl;
         }
-        
-        // Method to draw the trail
-        void DrawTrail(GLuint shaderProgram, GLint colorLoc) {
-            if (!hasTrail || trailSpheres.empty()) return;
-            
-            // Use a bright, high-contrast color for the trail
-            glUniform4f(colorLoc, 1.0f, 0.0f, 0.0f, 1.0f); // Bright red
-            
-            // Draw each sphere in the trail
-            for (size_t i = 0; i < trailSpheres.size(); ++i) {
-                // Fade the color based on age (older spheres are more transparent)
-                float alpha = (float)(i + 1) / trailSpheres.size(); // 0.0 to 1.0
-                glUniform4f(colorLoc, 1.0f, 0.0f, 0.0f, alpha);
-                
-                // Position the sphere
-                glm::mat4 model = glm::mat4(1.0f);
-                model = glm::translate(model, trailSpheres[i].position);
-                GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-                
-                // Draw the sphere
-                glBindVertexArray(trailSpheres[i].VAO);
-                glDrawArrays(GL_TRIANGLES, 0, trailSpheres[i].vertexCount / 3);
-            }
-            
-            glBindVertexArray(0);
+        if (options.generate) {
+            double generateStart = SteadySeconds();
+            AddGenerated(simulation, options.generator, options.generateCount, options.seed, &forcePool);
+            std::cout << "Generated " << options.generateCount << " bodies (" << SceneGeneratorName(options.generator)
+                      << ", seed " << options.seed << ") in " << SteadySeconds() - generateStart << " s" << std::endl;
         }
-};
-std::vector<Object> objs = {};
-
-std::vector<float> CreateGridVertices(float size, int divisions, const std::vector<Object>& objs);
-
-GLuint gridVAO, gridVBO; // 100x100 grid with 10 divisions
-
+        if (options.scene.empty() && !options.generate) {
+            AddEarthMoon(simulation);
+        }
+        simulation.params.backend = options.backend;
+        simulation.params.integrator = options.integrator;
+    }
+    if (!options.saveScene.empty() && !WriteBinaryScene(options.saveScene, simulation.bodies)) {
+        std::cerr << "Cannot write " << options.saveScene << std::endl;
+    }
 
-int main() {
-    GLFWwindow* window = StartGLU();
-    GLuint shaderProgram = CreateShaderProgram(vertexShaderSource, fragmentShaderSource);
+    // Replay: the recorded commands at their ticks, at full speed and without a window
+    if (!options.replay.empty()) {
+        EventReplay replay;
+        std::string error;
+        if (!replay.Open(options.replay, simulation, &error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+        double replayStart = SteadySeconds();
+        uint64_t tick = 0;
+        for (; tick < replay.EndTick() && !TerminationRequested(); ++tick) {
+            replay.ApplyDue(tick, simulation);
+            simulation.Step();
+        }
+        double seconds = SteadySeconds() - replayStart;
+        bool identical = tick == replay.EndTick() && StateHash(simulation) == replay.End().stateHash;
+        std::cout << "Replayed " << replay.EventCount() << " events over " << tick << " steps in " << seconds << " s ("
+                  << tick / seconds << " steps/s, " << simulation.totalInteractions / seconds << " interactions/s), "
+                  << simulation.bodies.Size() << " bodies at t = " << simulation.time << ": final state "
+                  << (identical ? "identical to" : "DIFFERS from") << " the recording" << std::endl;
+        if (GRAVITY_PROFILE && !options.profileCsv.empty() && !WriteProfileCsv(options.profileCsv)) {
+            std::cerr << "Cannot write " << options.profileCsv << std::endl;
+        }
+        return identical ? 0 : 2;
+    }
 
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    GLint objectColorLoc = glGetUniformLocation(shaderProgram, "objectColor");
-    glUseProgram(shaderProgram);
+    GLFWwindow* window = StartGLU(options.width, options.height, options.headless);
+    if (!window) {
+        return 1;
+    }
+    glfwSetWindowUserPointer(window, &viewer); // the input callbacks act on this scene
+    ShaderProgram shader(vertexShaderSource, fragmentShaderSource);
+    ShaderProgram instancedShader(instancedVertexShaderSource, instancedFragmentShaderSource);
+    shader.Use();
 
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    //projection matrix
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 750000.0f);
-    GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    cameraPos = glm::vec3(0.0f, 1000.0f,  5000.0f);
+    //projection matrix, uploaded once into the camera block (and again on resize)
+    sceneCamera.Create();
+    sceneProjection = glm::perspective(glm::radians(45.0f), (float)options.width / options.height, 0.1f, 750000.0f);
+    sceneCamera.SetProjection(sceneProjection);
+    sceneCamera.Bind();
+    int framebufferWidth, framebufferHeight;
+    glfwGetFramebufferSize(window, &framebufferWidth, &framebufferHeight);
+    if (options.headless) {
+        framebufferWidth = options.width;
+        framebufferHeight = options.height;
+    }
+    screenCamera.Create();
+    screenCamera.SetProjection(glm::ortho(0.0f, (float)framebufferWidth, (float)framebufferHeight, 0.0f, -1.0f, 1.0f));
+    hud.Create();
+    viewer.cameraPos = glm::vec3(0.0f, 1000.0f,  5000.0f);
 
     
-    objs = {
-        Object(glm::vec3(3844, 0, 0), glm::vec3(0, 0, 228), 7.34767309*pow(10, 22), 3344),
-        // Object(glm::vec3(-250, 0, 0), glm::vec3(0, -50, 0), 7.34767309*pow(10, 22), 3344),
-        Object(glm::vec3(0, 0, 0), glm::vec3(0, 0, 0), 5.97219*pow(10, 24), 5515),
+    // Only speed and pause change once the simulation thread runs, and those come from the snapshot
+    const SimulationParams checkpointParams = simulation.params;
+    CheckpointWriter checkpoints;
+    double lastCheckpoint = glfwGetTime();
+
+    SharedSnapshotRing sharedSnapshots;
+    if (!options.sharedMemory.empty()) {
+        sharedSnapshots.Open(options.sharedMemory, (uint32_t)options.sharedSlots);
+    }
 
+    // Input events, recorded as the simulation thread applies them
+    EventRecorder eventRecorder;
+    if (!options.recordEvents.empty()) {
+        if (eventRecorder.Open(options.recordEvents, simulation)) {
+            simulationThread.onCommand = [&](uint64_t tick, const Command& command) { eventRecorder.Record(tick, command); };
+        } else {
+            std::cerr << "Cannot write " << options.recordEvents << std::endl;
+        }
+    }
+
+    // Trajectory: the starting state, then every trajectoryEvery-th step as it is taken (on the
+    // simulation thread, or in the headless loop, which waits for the writer instead of dropping)
+    TrajectoryWriter trajectory;
+    uint64_t trajectoryStep = simulation.step;
+    auto recordStep = [&](bool wait) {
+        if (simulation.step != trajectoryStep && simulation.step % options.trajectoryEvery == 0) {
+            trajectory.Push(simulation.bodies, simulation.step, simulation.time, wait);
+            trajectoryStep = simulation.step;
+        }
     };
+    if (!options.trajectory.empty()) {
+        if (trajectory.Open(options.trajectory, options.trajectoryQuantum, options.trajectoryQuantum * 0.1f)) {
+            trajectory.Push(simulation.bodies, simulation.step, simulation.time);
+            simulationThread.onStep = [&](const Simulation&) { recordStep(false); };
+        } else {
+            std::cerr << "Cannot write " << options.trajectory << std::endl;
+        }
+    }
     
-    // Set moon to grey color
-    objs[0].color = glm::vec4(0.8f, 0.8f, 0.8f, 1.0f);
-    // Enable trail for the moon
-    objs[0].hasTrail = true;
-    // Set earth to blue color
-    objs[1].color = glm::vec4(0.0f, 0.3f, 0.8f, 1.0f);
-    
+    // Headless: everything is drawn into an offscreen framebuffer and captured every frame.
+    // Windowed runs can record what is displayed the same way.
+    OffscreenTarget offscreen;
+    FrameCapture capture;
+    if (options.headless) {
+        if (!offscreen.Create(options.width, options.height) ||
+            !capture.Start(options.output, options.width, options.height)) {
+            glfwTerminate();
+            return 1;
+        }
+        offscreen.Bind();
+        showHud = false;
+    } else if (!options.record.empty()) {
+        if (!capture.Start(options.record, framebufferWidth, framebufferHeight)) {
+            glfwTerminate();
+            return 1;
+        }
+    }
+
     // Print simulation speed control instructions
-    std::cout << "===== SIMULATION SPEED CONTROLS =====" << std::endl;
-    std::cout << "Press 0: Normal speed (1.0x)" << std::endl;
-    std::cout << "Press 1: Slow motion (0.5x)" << std::endl;
-    std::cout << "Press 2: Fast (2.0x)" << std::endl;
-    std::cout << "Press 3: Faster (5.0x)" << std::endl;
-    std::cout << "Press 4: Super fast (10.0x)" << std::endl;
-    std::cout << "===================================" << std::endl;
-    std::cout << "===== CAMERA CONTROLS =====" << std::endl;
-    std::cout << "Hold X: 5x camera movement speed" << std::endl;
-    std::cout << "WASD: Move camera" << std::endl;
-    std::cout << "Mouse: Look around" << std::endl;
-    std::cout << "Space/Shift: Up/Down" << std::endl;
-    std::cout << "===================================" << std::endl;
+    if (!options.headless) {
+        std::cout << "===== SIMULATION SPEED CONTROLS =====" << std::endl;
+        std::cout << "Press 0: Normal speed (1.0x)" << std::endl;
+        std::cout << "Press 1: Slow motion (0.5x)" << std::endl;
+        std::cout << "Press 2: Fast (2.0x)" << std::endl;
+        std::cout << "Press 3: Faster (5.0x)" << std::endl;
+        std::cout << "Press 4: Super fast (10.0x)" << std::endl;
+        std::cout << "===================================" << std::endl;
+        std::cout << "===== CAMERA CONTROLS =====" << std::endl;
+        std::cout << "Hold X: 5x camera movement speed" << std::endl;
+        std::cout << "WASD: Move camera" << std::endl;
+        std::cout << "Mouse: Look around" << std::endl;
+        std::cout << "Space/Shift: Up/Down" << std::endl;
+        std::cout << "H: Toggle statistics overlay" << std::endl;
+        std::cout << "R: Toggle draw call / state change counters in the overlay" << std::endl;
+        std::cout << "P: Toggle per-phase CPU timings in the overlay" << std::endl;
+        if (!options.trace.empty()) {
+            std::cout << "T: Write the trace recorded so far to " << options.trace << std::endl;
+        }
+        std::cout << "===================================" << std::endl;
+    }
     
-    std::vector<float> gridVertices = CreateGridVertices(100000.0f, 50, objs);
-    CreateVBOVAO(gridVAO, gridVBO, gridVertices.data(), gridVertices.size());
-    std::cout<<"Earth radius: "<<objs[1].radius<<std::endl;
-    std::cout<<"Moon radius: "<<objs[0].radius<<std::endl;
+    // The grid buffer is allocated once at the vertex budget and refilled with glBufferSubData
+    std::vector<float> gridVertices;
+    gridVertices.reserve(gridVertexBudget * 3);
+    CreateVBOVAO(gridVAO, gridVBO, nullptr, 0);
+    glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
+    glBufferData(GL_ARRAY_BUFFER, gridVertexBudget * 3 * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    std::vector<float> sphereVertices = CreateSphereVertices(1.0f, 10, 10);
+    CreateVBOVAO(bodyMesh.VAO, bodyMesh.VBO, sphereVertices.data(), sphereVertices.size());
+    bodyMesh.vertexCount = sphereVertices.size() / 3;
+    sphereVertices = CreateSphereVertices(1.0f, 8, 8);
+    CreateVBOVAO(trailMesh.VAO, trailMesh.VBO, sphereVertices.data(), sphereVertices.size());
+    trailMesh.vertexCount = sphereVertices.size() / 3;
+    CreateSphereBatch(bodyBatch, bodyMesh);
+    CreateSphereBatch(trailBatch, trailMesh);
+
+    // Per-frame scratch for culling, kept across frames to avoid reallocating
+    SphereList bodySpheres, trailSpheres;
+    std::vector<glm::vec4> trailColors;
+    std::vector<size_t> trailOrder;
+
+    // Opt-in timeline: every phase timer also records its span from here on
+    tracePath = options.trace;
+    if (!tracePath.empty()) {
+        TraceStart();
+        TraceSetThreadName("render");
+    }
+
+    // Physics runs on its own thread from here on; the loop below only reads its snapshots.
+    // Headless runs step on this thread instead, up to the simulated time of each frame.
+    TripleBuffer<Snapshot>& snapshots = simulationThread.Snapshots();
+    Snapshot headlessSnapshot;
+    double nextFrameTime = simulation.time;
+    bool timeStalled = false; // headless: a frame's steps did not reach its time
+    if (!options.headless) {
+        if (options.restart.empty() && options.scene.empty() && !options.generate) {
+            std::cout<<"Earth radius: "<<simulation.bodies.radius[1]<<std::endl;
+            std::cout<<"Moon radius: "<<simulation.bodies.radius[0]<<std::endl;
+        }
+
+        simulationThread.Start();
+        snapshots.Acquire();
+        viewer.interpolator.Push(snapshots.ReadBuffer());
+    }
+
+    if (GRAVITY_PROFILE && gpuTimers.Create()) {
+        renderQueue.gpuTimers = &gpuTimers;
+    }
+
+    // Statistics accumulated over one HUD interval
+    int hudFrames = 0;
+    uint64_t hudStartStep = snapshots.ReadBuffer().step;
+    uint64_t hudStartInteractions = snapshots.ReadBuffer().totalInteractions;
+    double hudStart = glfwGetTime();
+    char hudLines[3][128] = {"", "", ""};
+    char profileLines[(int)Phase::Count][128] = {};
+    char conservedLines[2][128] = {"", ""};
+
+    ConservedLog conservedLog;
+    uint64_t conservedLogged = UINT64_MAX; // step of the last row written
+    if (!options.conservedCsv.empty() && !conservedLog.Open(options.conservedCsv)) {
+        std::cerr << "Cannot write " << options.conservedCsv << std::endl;
+    }
 
-    while (!glfwWindowShouldClose(window) && running == true) {
+    while (!glfwWindowShouldClose(window) && viewer.running == true && !TerminationRequested()) {
+        PhaseTimer frameTimer(Phase::Frame);
+        PhaseTimer inputTimer(Phase::Input);
+        gpuTimers.BeginFrame();
         float currentFrame = glfwGetTime();
-        deltaTime = currentFrame - lastFrame;
-        lastFrame = currentFrame;
+        viewer.deltaTime = currentFrame - viewer.lastFrame;
+        viewer.lastFrame = currentFrame;
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -332,148 +440,331 @@ int main() {
         
         // Handle continuous camera movement in main loop
         float speedMultiplier = (glfwGetKey(window, GLFW_KEY_X) == GLFW_PRESS) ? 5.0f : 1.0f;
-        float cameraSpeed = 1000.0f * deltaTime * speedMultiplier;
+        float cameraSpeed = 1000.0f * viewer.deltaTime * speedMultiplier;
         
         if (glfwGetKey(window, GLFW_KEY_W)==GLFW_PRESS){
-            cameraPos += cameraSpeed * cameraFront;
+            viewer.cameraPos += cameraSpeed * viewer.cameraFront;
         }
         if (glfwGetKey(window, GLFW_KEY_S)==GLFW_PRESS){
-            cameraPos -= cameraSpeed * cameraFront;
+            viewer.cameraPos -= cameraSpeed * viewer.cameraFront;
         }
         if (glfwGetKey(window, GLFW_KEY_A)==GLFW_PRESS){
-            cameraPos -= cameraSpeed * glm::normalize(glm::cross(cameraFront, cameraUp));
+            viewer.cameraPos -= cameraSpeed * glm::normalize(glm::cross(viewer.cameraFront, viewer.cameraUp));
         }
         if (glfwGetKey(window, GLFW_KEY_D)==GLFW_PRESS){
-            cameraPos += cameraSpeed * glm::normalize(glm::cross(cameraFront, cameraUp));
+            viewer.cameraPos += cameraSpeed * glm::normalize(glm::cross(viewer.cameraFront, viewer.cameraUp));
         }
         if (glfwGetKey(window, GLFW_KEY_SPACE) == GLFW_PRESS){
-            cameraPos += cameraSpeed * cameraUp;
+            viewer.cameraPos += cameraSpeed * viewer.cameraUp;
         }
         if (glfwGetKey(window, GLFW_KEY_LEFT_SHIFT) == GLFW_PRESS){
-            cameraPos -= cameraSpeed * cameraUp;
+            viewer.cameraPos -= cameraSpeed * viewer.cameraUp;
         }
-        if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS){
-            pause = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_K) == GLFW_RELEASE){
-            pause = false;
+        // paused while K is held; only changes are sent to the simulation thread
+        bool pauseKey = glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS;
+        if (pauseKey != viewer.pause){
+            viewer.pause = pauseKey;
+            simulationThread.Push({CommandType::SetPaused, 0.0f, 0.0f, 0.0f, viewer.pause ? 1.0f : 0.0f});
         }
         if (glfwGetKey(window, GLFW_KEY_Q) == GLFW_PRESS){
-            glfwTerminate();
-            glfwWindowShouldClose(window);
-            running = false;
+            viewer.running = false;
         }
         
-        UpdateCam(shaderProgram, cameraPos);
-        if (!objs.empty() && objs.back().Initalizing) {
+        glm::mat4 view = UpdateCam(sceneCamera, viewer);
+        Frustum frustum = ExtractFrustum(sceneProjection * view);
+        if (viewer.placingBody) {
             if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS) {
-                // Increase mass by 1% per second
-                objs.back().mass *= 1.0 + 1.0 * deltaTime;
-                
-                // Update radius based on new mass
-                objs.back().radius = pow(
-                    (3 * objs.back().mass / objs.back().density) / 
-                    (4 * 3.14159265359f), 
-                    1.0f/3.0f
-                ) / 100000.0f;
-                
-                // Update vertex data
-                objs.back().UpdateVertices();
+                // Increase mass by 100% per second (the radius follows on the simulation side)
+                simulationThread.Push({CommandType::GrowLast, 0.0f, 0.0f, 0.0f, 1.0f + 1.0f * viewer.deltaTime});
+            }
+        }
+        inputTimer.Stop();
+
+        // Newest state published by the simulation thread (the previous one if nothing new arrived),
+        // drawn one step late and blended with the state before it so motion stays smooth between steps.
+        // Headless frames are exact states spaced options.frameTime apart in simulated time.
+        PhaseTimer snapshotTimer(Phase::Snapshot);
+        bool freshSnapshot = options.headless;
+        if (options.headless) {
+            // Bounded by the steps one frame needs, so a state whose time cannot advance does not spin here
+            const double stepTime = simulation.params.paused ? 0.0 : simulation.params.speed / 94.0;
+            uint64_t stepBudget = stepTime > 0.0 ? (uint64_t)std::ceil(options.frameTime / stepTime) + 2 : 0;
+            while (simulation.time < nextFrameTime && stepBudget > 0 && !TerminationRequested()) {
+                simulation.Step();
+                stepBudget--;
+                if (trajectory.Active()) recordStep(true);
             }
+            if (simulation.time < nextFrameTime && !TerminationRequested()) {
+                std::cerr << "Simulated time stopped advancing at t = " << simulation.time << " (speed "
+                          << simulation.params.speed << "), stopping" << std::endl;
+                timeStalled = true;
+                viewer.running = false;
+            }
+            nextFrameTime += options.frameTime;
+            simulation.WriteSnapshot(headlessSnapshot);
+        } else if (snapshots.Acquire()) {
+            viewer.interpolator.Push(snapshots.ReadBuffer());
+            freshSnapshot = true;
+        }
+        const Snapshot& snapshot = options.headless ? headlessSnapshot : snapshots.ReadBuffer();
+        float stepAlpha = viewer.interpolator.Alpha(SteadySeconds());
+        const BodyStore& bodies = options.headless ? snapshot.bodies : viewer.interpolator.Blend(snapshot, stepAlpha);
+        viewer.trails.Update(snapshot);
+        if (conservedLog.Active() && snapshot.step != conservedLogged) {
+            conservedLog.Write(snapshot.step, snapshot.conserved, snapshot.conservedReference);
+            conservedLogged = snapshot.step;
+        }
+        // Other processes read the shared ring; the copy is made here, not on the simulation thread
+        if (freshSnapshot && sharedSnapshots.Active() && !sharedSnapshots.Publish(snapshot)) {
+            std::cerr << "Cannot publish " << snapshot.bodies.Size() << " bodies to shared memory "
+                      << options.sharedMemory << ", stopped publishing" << std::endl;
+            sharedSnapshots.Close();
         }
+        // Periodic checkpoint: the snapshot is copied here and written on the writer's thread
+        if (!options.checkpoint.empty() && options.checkpointInterval > 0.0 &&
+            glfwGetTime() - lastCheckpoint >= options.checkpointInterval) {
+            checkpoints.WriteAsync(options.checkpoint, snapshot, checkpointParams);
+            lastCheckpoint = glfwGetTime();
+        }
+        snapshotTimer.Stop();
 
         // Draw the grid
-        glUseProgram(shaderProgram);
-        glUniform4f(objectColorLoc, 1.0f, 1.0f, 1.0f, 0.25f); // White color with 50% transparency for the grid
-        gridVertices = CreateGridVertices(10000.0f, 50, objs);
+        renderQueue.Clear();
+        PhaseTimer gridTimer(Phase::Grid);
+        CreateGridVertices(10000.0f, gridVertexBudget, viewer.cameraPos, frustum, bodies, gridVertices);
+        gridTimer.Stop();
+        PhaseTimer gridUploadTimer(Phase::GridUpload);
         glBindBuffer(GL_ARRAY_BUFFER, gridVBO);
-        glBufferData(GL_ARRAY_BUFFER, gridVertices.size() * sizeof(float), gridVertices.data(), GL_DYNAMIC_DRAW);
-        DrawGrid(shaderProgram, gridVAO, gridVertices.size());
-
-        // Draw the triangle
-        for(auto& obj : objs) {
-            glUniform4f(objectColorLoc, obj.color.r, obj.color.g, obj.color.b, obj.color.a);
-
-            for(auto& obj2 : objs){
-                if(&obj2 != &obj && !obj.Initalizing && !obj2.Initalizing){
-                    float dx = obj2.GetPos()[0] - obj.GetPos()[0];
-                    float dy = obj2.GetPos()[1] - obj.GetPos()[1];
-                    float dz = obj2.GetPos()[2] - obj.GetPos()[2];
-                    float distance = sqrt(dx * dx + dy * dy + dz * dz);
-
-                    if (distance > 0) {
-                        std::vector<float> direction = {dx / distance, dy / distance, dz / distance};
-                        distance *= 1000;
-                        double Gforce = (G * obj.mass * obj2.mass) / (distance * distance);
-                        
-
-                        float acc1 = Gforce / obj.mass;
-                        std::vector<float> acc = {direction[0] * acc1, direction[1]*acc1, direction[2]*acc1};
-                        if(!pause){
-                            obj.accelerate(acc[0], acc[1], acc[2]);
-                        }
-
-                        //collision
-                        obj.velocity *= obj.CheckCollision(obj2);
-                    }
-                }
+        glBufferSubData(GL_ARRAY_BUFFER, 0, gridVertices.size() * sizeof(float), gridVertices.data());
+        gridUploadTimer.Stop();
+        DrawGrid(renderQueue, shader, gridVAO, gridVertices.size());
+
+        // Cull bodies against the frustum in one batch, then draw the visible ones in one instanced call
+        PhaseTimer bodiesTimer(Phase::Bodies);
+        bodySpheres.Clear();
+        for (size_t i = 0; i < bodies.Size(); ++i) {
+            bodySpheres.Add(glm::vec3(bodies.x[i], bodies.y[i], bodies.z[i]), bodies.radius[i]);
+        }
+        size_t visibleBodies = CullSpheres(frustum, bodySpheres);
+        bodyBatch.instances.clear();
+        for (size_t i = 0; i < bodies.Size(); ++i) {
+            if (bodySpheres.visible[i]) {
+                glm::vec4 centerRadius(bodies.x[i], bodies.y[i], bodies.z[i], bodies.radius[i]);
+                bodyBatch.instances.push_back({centerRadius, UnpackColor(bodies.color[i])});
             }
-            if(obj.Initalizing){
-                obj.radius = pow(((3 * obj.mass/obj.density)/(4 * 3.14159265359)), (1.0f/3.0f)) / 100000;
-                obj.UpdateVertices();
+        }
+        if (!bodyBatch.instances.empty()) {
+            UploadSphereBatch(bodyBatch);
+            DrawItem item;
+            item.program = &instancedShader;
+            item.VAO = bodyBatch.VAO;
+            item.count = bodyMesh.vertexCount;
+            item.instanceCount = bodyBatch.instances.size();
+            item.gpuPhase = Phase::GpuBodies;
+            renderQueue.Submit(item);
+        }
+        bodiesTimer.Stop();
+
+        // Same for every trail sphere, sorted back to front since they are translucent
+        PhaseTimer trailsTimer(Phase::Trails);
+        trailSpheres.Clear();
+        trailColors.clear();
+        viewer.trails.Draw(trailSpheres, trailColors);
+        size_t visibleTrail = CullSpheres(frustum, trailSpheres);
+        trailOrder.clear();
+        for (size_t i = 0; i < trailSpheres.Size(); ++i) {
+            if (trailSpheres.visible[i]) trailOrder.push_back(i);
+        }
+        auto trailDepth = [&](size_t i) {
+            return glm::length(glm::vec3(trailSpheres.x[i], trailSpheres.y[i], trailSpheres.z[i]) - viewer.cameraPos);
+        };
+        std::sort(trailOrder.begin(), trailOrder.end(), [&](size_t a, size_t b) { return trailDepth(a) > trailDepth(b); });
+        trailBatch.instances.clear();
+        for (size_t i : trailOrder) {
+            glm::vec4 centerRadius(trailSpheres.x[i], trailSpheres.y[i], trailSpheres.z[i], trailSpheres.radius[i]);
+            trailBatch.instances.push_back({centerRadius, trailColors[i]});
+        }
+        if (!trailBatch.instances.empty()) {
+            UploadSphereBatch(trailBatch);
+            DrawItem item;
+            item.program = &instancedShader;
+            item.VAO = trailBatch.VAO;
+            item.count = trailMesh.vertexCount;
+            item.instanceCount = trailBatch.instances.size();
+            item.blend = true;
+            item.gpuPhase = Phase::GpuTrails;
+            renderQueue.Submit(item);
+        }
+        trailsTimer.Stop();
+
+        PhaseTimer submitTimer(Phase::Submit);
+        renderQueue.Flush();
+        submitTimer.Stop();
+
+        // Statistics overlay: the text is rebuilt every frame but drawn in a single call
+        PhaseTimer hudTimer(Phase::Hud);
+        hudFrames++;
+        double hudElapsed = glfwGetTime() - hudStart;
+        if (hudElapsed >= hudInterval) {
+            std::snprintf(hudLines[0], sizeof(hudLines[0]), "FPS %.1f (%.2f MS)  STEP %.3f MS  STEPS %.1f/S",
+                          hudFrames / hudElapsed, 1000.0 * hudElapsed / hudFrames, 1000.0 * snapshot.stepSeconds,
+                          (snapshot.step - hudStartStep) / hudElapsed);
+            std::snprintf(hudLines[1], sizeof(hudLines[1]), "BODIES %zu  INTERACTIONS %.3g/S  SPEED %.1fX%s",
+                          bodies.Size(), (snapshot.totalInteractions - hudStartInteractions) / hudElapsed,
+                          snapshot.speed, snapshot.paused ? "  PAUSED" : "");
+            hudFrames = 0;
+            hudStartStep = snapshot.step;
+            hudStartInteractions = snapshot.totalInteractions;
+            hudStart = glfwGetTime();
+
+            // recent CPU time per phase, simulation phases first
+            for (int i = 0; i < (int)Phase::Count; ++i) {
+                PhaseStats stats = ProfileRecent((Phase)i);
+                std::snprintf(profileLines[i], sizeof(profileLines[i]), "%-12s MEAN %7.3f  P50 %7.3f  P99 %7.3f  MAX %7.3f MS",
+                              PhaseName((Phase)i), stats.mean, stats.p50, stats.p99, stats.max);
             }
-
-            //update positions
-            if(!pause){
-                obj.UpdatePos();
+            const ConservedQuantities& conserved = snapshot.conserved;
+            ConservedDrift drift = MeasureDrift(conserved, snapshot.conservedReference);
+            std::snprintf(conservedLines[0], sizeof(conservedLines[0]), "ENERGY %.6g  DRIFT %+.2e  MOMENTUM DRIFT %.2e  ANGULAR DRIFT %.2e",
+                          conserved.Energy(), drift.energy, drift.momentum, drift.angularMomentum);
+            std::snprintf(conservedLines[1], sizeof(conservedLines[1]), "CENTER OF MASS %.1f %.1f %.1f  DRIFT %.2e",
+                          conserved.comX, conserved.comY, conserved.comZ, drift.centerOfMass);
+        }
+        std::snprintf(hudLines[2], sizeof(hudLines[2]), "DRAWS %d  STATE CHANGES %d  UNIFORMS %d  VISIBLE %zu/%zu TRAIL %zu/%zu",
+                      renderQueue.stats.drawCalls, renderQueue.stats.StateChanges(), renderQueue.stats.uniformUploads,
+                      visibleBodies, bodies.Size(), visibleTrail, trailSpheres.Size());
+        hud.Clear();
+        if (showHud) {
+            const float hudScale = 2.0f;
+            const glm::vec4 hudColor(1.0f, 1.0f, 1.0f, 0.9f);
+            int lines = showRenderStats ? 3 : 2;
+            for (int i = 0; i < lines; ++i) {
+                hud.Add(hudLines[i], 10.0f, 10.0f + i * HudText::LineHeight(hudScale), hudScale, hudColor);
             }
-            
-            glm::mat4 model = glm::mat4(1.0f);
-            model = glm::translate(model, obj.position); // Apply position here
-            glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-            
-            // Draw the object
-            glBindVertexArray(obj.VAO);
-            glDrawArrays(GL_TRIANGLES, 0, obj.vertexCount / 3);
-            
-            // Draw the trail if this object has one
-            if (obj.hasTrail) {
-                // Reset model matrix for trail (don't want to translate the trail vertices)
-                glm::mat4 identityModel = glm::mat4(1.0f);
-                glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(identityModel));
-                obj.DrawTrail(shaderProgram, objectColorLoc);
+            if (GRAVITY_PROFILE && showProfile) {
+                const float profileScale = 1.5f;
+                float y = 10.0f + (lines + 0.5f) * HudText::LineHeight(hudScale);
+                for (int i = 0; i < (int)Phase::Count; ++i) {
+                    hud.Add(profileLines[i], 10.0f, y + i * HudText::LineHeight(profileScale), profileScale, hudColor);
+                }
+                y += ((int)Phase::Count + 0.5f) * HudText::LineHeight(profileScale);
+                for (int i = 0; i < 2; ++i) {
+                    hud.Add(conservedLines[i], 10.0f, y + i * HudText::LineHeight(profileScale), profileScale, hudColor);
+                }
             }
         }
+        gpuTimers.Begin(Phase::GpuHud);
+        hud.Draw(screenCamera, sceneCamera);
+        gpuTimers.End();
+        hudTimer.Stop();
         
-        // Just swap buffers and poll events without rendering text
-        glfwSwapBuffers(window);
+        if (capture.Active()) {
+            PhaseTimer captureTimer(Phase::Capture);
+            capture.Capture();
+            if (capture.Failed() || (options.headless && capture.FramesCaptured() >= options.frames)) {
+                viewer.running = false;
+            }
+        }
+        PhaseTimer swapTimer(Phase::Swap);
+        if (!options.headless) {
+            glfwSwapBuffers(window);
+        }
         glfwPollEvents();
+        swapTimer.Stop();
+
+        if (traceRequested) {
+            traceRequested = false;
+            std::cout << (WriteTrace(tracePath) ? "Trace written to " : "Cannot write ") << tracePath << std::endl;
+        }
     }
 
-    for (auto& obj : objs) {
-        glDeleteVertexArrays(1, &obj.VAO);
-        glDeleteBuffers(1, &obj.VBO);
-        // Clean up trail buffers
-        if (obj.hasTrail) {
-            for (auto& sphere : obj.trailSpheres) {
-                glDeleteVertexArrays(1, &sphere.VAO);
-                glDeleteBuffers(1, &sphere.VBO);
-            }
+    simulationThread.Stop();
+    if (eventRecorder.Active()) {
+        uint64_t ticks = simulationThread.Ticks();
+        size_t events = eventRecorder.events;
+        bool written = eventRecorder.Close(ticks, simulation);
+        std::cerr << (written ? "Recorded " : "Cannot write ") << events << " events over " << ticks << " steps to "
+                  << options.recordEvents << std::endl;
+    }
+    if (trajectory.Active()) {
+        trajectory.Close();
+        std::cerr << (trajectory.Failed() ? "Trajectory failed after " : "Trajectory: ") << trajectory.framesWritten
+                  << " frames to " << options.trajectory << ", " << trajectory.compressedBytes / 1048576.0 << " MB ("
+                  << (double)trajectory.rawBytes / std::max<uint64_t>(trajectory.compressedBytes, 1) << "x compressed), "
+                  << trajectory.framesDropped << " dropped while the writer was behind" << std::endl;
+        if (trajectory.samplesClamped > 0) {
+            std::cerr << "Trajectory: " << trajectory.samplesClamped << " values were outside the range of "
+                      << "--trajectory-quantum and were saturated; use a larger quantum" << std::endl;
+        }
+    }
+    if (TerminationRequested()) {
+        std::cerr << "Terminated at step " << simulation.step << ", t = " << simulation.time << std::endl;
+    }
+    // Final checkpoint, on a normal exit as well as on SIGTERM
+    if (!options.checkpoint.empty()) {
+        Snapshot finalState;
+        simulation.WriteSnapshot(finalState);
+        bool written = checkpoints.Write(options.checkpoint, finalState, checkpointParams);
+        std::cerr << (written ? "Checkpoint written to " : "Cannot write checkpoint ") << options.checkpoint << " ("
+                  << finalState.bodies.Size() << " bodies, step " << finalState.step << ", "
+                  << 1000.0 * checkpoints.lastSeconds << " ms; " << checkpoints.written << " written, "
+                  << checkpoints.skipped << " skipped while busy)" << std::endl;
+    }
+    if (capture.Active()) {
+        capture.Finish();
+        std::cerr << (capture.Failed() ? "Capture failed after " : "Captured ") << capture.FramesCaptured() << " frames to "
+                  << (options.headless ? options.output : options.record) << " (t = " << simulation.time << "), "
+                  << 1000.0 * capture.captureSeconds / std::max(capture.FramesCaptured(), 1) << " ms/frame on the render thread, "
+                  << capture.ringStalls << " readback stalls, " << capture.queueStalls << " encoder stalls" << std::endl;
+    }
+    if (options.headless) {
+        offscreen.Destroy();
+    }
+    if (!tracePath.empty() && !WriteTrace(tracePath)) {
+        std::cerr << "Cannot write " << tracePath << std::endl;
+    }
+    conservedLog.Close();
+    sharedSnapshots.Close(); // readers see the ring retired
+    if (GRAVITY_PROFILE && !options.profileCsv.empty()) {
+        if (!WriteProfileCsv(options.profileCsv)) {
+            std::cerr << "Cannot write " << options.profileCsv << std::endl;
         }
     }
 
+    glDeleteVertexArrays(1, &bodyMesh.VAO);
+    glDeleteBuffers(1, &bodyMesh.VBO);
+    glDeleteVertexArrays(1, &trailMesh.VAO);
+    glDeleteBuffers(1, &trailMesh.VBO);
+    for (SphereBatch* batch : {&bodyBatch, &trailBatch}) {
+        glDeleteVertexArrays(1, &batch->VAO);
+        glDeleteBuffers(1, &batch->instanceVBO);
+    }
+
     glDeleteVertexArrays(1, &gridVAO);
     glDeleteBuffers(1, &gridVBO);
 
-    glDeleteProgram(shaderProgram);
+    gpuTimers.Destroy();
+    sceneCamera.Destroy();
+    screenCamera.Destroy();
+    hud.Destroy();
+    shader.Destroy();
+    instancedShader.Destroy();
     glfwTerminate();
 
     glfwTerminate();
-    return 0;
+    return timeStalled ? 1 : 0;
 }
 
-GLFWwindow* StartGLU() {
-    if (!glfwInit()) {
+GLFWwindow* StartGLU(int width, int height, bool headless) {
+    bool initialized = glfwInit();
+#ifdef GLFW_PLATFORM_NULL
+    // No display server: GLFW 3.4's null platform can still create (OSMesa, software) contexts
+    if (!initialized && headless) {
+        glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+        initialized = glfwInit();
+    }
+#endif
+    if (!initialized) {
         std::cout << "Failed to initialize GLFW, panic" << std::endl;
         return nullptr;
     }
@@ -483,8 +774,17 @@ GLFWwindow* StartGLU() {
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);  // Required on macOS
+    if (headless) {
+        // The window only provides the context; frames go to an offscreen framebuffer
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+#ifdef GLFW_PLATFORM_NULL
+        if (glfwGetPlatform() == GLFW_PLATFORM_NULL) {
+            glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        }
+#endif
+    }
     
-    GLFWwindow* window = glfwCreateWindow(800, 600, "Gravity Simulator 3D Grid", NULL, NULL);
+    GLFWwindow* window = glfwCreateWindow(width, height, "Gravity Simulator 3D Grid", NULL, NULL);
     if (!window) {
         std::cerr << "Failed to create GLFW window." << std::endl;
         glfwTerminate();
@@ -493,7 +793,14 @@ GLFWwindow* StartGLU() {
     glfwMakeContextCurrent(window);
 
     glewExperimental = GL_TRUE;
-    if (glewInit() != GLEW_OK) {
+    GLenum glewStatus = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    // GLEW built for GLX complains without an X display, but the core entry points are loaded anyway
+    if (headless && glewStatus == GLEW_ERROR_NO_GLX_DISPLAY) {
+        glewStatus = GLEW_OK;
+    }
+#endif
+    if (glewStatus != GLEW_OK) {
         std::cerr << "Failed to initialize GLEW." << std::endl;
         glfwTerminate();
         return nullptr;
@@ -512,50 +819,6 @@ GLFWwindow* StartGLU() {
     return window;
 }
 
-GLuint CreateShaderProgram(const char* vertexSource, const char* fragmentSource) {
-    // Vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexSource, nullptr);
-    glCompileShader(vertexShader);
-
-    GLint success;
-    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
-        std::cerr << "Vertex shader compilation failed: " << infoLog << std::endl;
-    }
-
-    // Fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
-    glCompileShader(fragmentShader);
-
-    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
-        std::cerr << "Fragment shader compilation failed: " << infoLog << std::endl;
-    }
-
-    // Shader program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
-    if (!success) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
-        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
-    }
-
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-
-    return shaderProgram;
-}
 void CreateVBOVAO(GLuint& VAO, GLuint& VBO, const float* vertices, size_t vertexCount) {
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
@@ -569,15 +832,43 @@ void CreateVBOVAO(GLuint& VAO, GLuint& VBO, const float* vertices, size_t vertex
     glBindVertexArray(0);
 }
 
-void UpdateCam(GLuint shaderProgram, glm::vec3 cameraPos) {
-    glUseProgram(shaderProgram);
-    glm::mat4 view = glm::lookAt(cameraPos, cameraPos + cameraFront, cameraUp);
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
+glm::mat4 UpdateCam(const CameraUniforms& camera, const ViewerState& viewer) {
+    glm::mat4 view = glm::lookAt(viewer.cameraPos, viewer.cameraPos + viewer.cameraFront, viewer.cameraUp);
+    camera.SetView(view);
+    return view;
+}
+
+void CreateSphereBatch(SphereBatch& batch, const Mesh& mesh) {
+    glGenVertexArrays(1, &batch.VAO);
+    glGenBuffers(1, &batch.instanceVBO);
+
+    glBindVertexArray(batch.VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, mesh.VBO);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, centerRadius));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(SphereInstance), (void*)offsetof(SphereInstance, color));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glBindVertexArray(0);
+}
+
+void UploadSphereBatch(SphereBatch& batch) {
+    glBindBuffer(GL_ARRAY_BUFFER, batch.instanceVBO);
+    if (batch.instances.size() > batch.capacity) {
+        batch.capacity = std::max(batch.instances.size(), batch.capacity * 2);
+    }
+    // orphan the old storage so the driver does not wait on last frame's draw
+    glBufferData(GL_ARRAY_BUFFER, batch.capacity * sizeof(SphereInstance), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, batch.instances.size() * sizeof(SphereInstance), batch.instances.data());
 }
 
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
-    (void)window;
+    ViewerState& viewer = Viewer(window);
     (void)scancode;
     bool shiftPressed = (mods & GLFW_MOD_SHIFT) != 0;
     
@@ -585,90 +876,101 @@ void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods
     if (action == GLFW_PRESS) {
         switch (key) {
             case GLFW_KEY_0: // Reset to normal speed
-                simulationSpeed = 1.0f;
+                viewer.simulationThread.Push({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 1.0f});
                 std::cout << "Simulation speed: 1.0x (normal)" << std::endl;
                 break;
             case GLFW_KEY_1: // 0.5x speed
-                simulationSpeed = 0.5f;
+                viewer.simulationThread.Push({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 0.5f});
                 std::cout << "Simulation speed: 0.5x (slow)" << std::endl;
                 break;
             case GLFW_KEY_2: // 2x speed
-                simulationSpeed = 2.0f;
+                viewer.simulationThread.Push({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 2.0f});
                 std::cout << "Simulation speed: 2.0x" << std::endl;
                 break;
             case GLFW_KEY_3: // 5x speed
-                simulationSpeed = 5.0f;
+                viewer.simulationThread.Push({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 5.0f});
                 std::cout << "Simulation speed: 5.0x" << std::endl;
                 break;
             case GLFW_KEY_4: // 10x speed
-                simulationSpeed = 10.0f;
+                viewer.simulationThread.Push({CommandType::SetSpeed, 0.0f, 0.0f, 0.0f, 10.0f});
                 std::cout << "Simulation speed: 10.0x (fast)" << std::endl;
                 break;
+            case GLFW_KEY_H: // statistics overlay
+                showHud = !showHud;
+                break;
+            case GLFW_KEY_R: // render queue counters
+                showRenderStats = !showRenderStats;
+                break;
+            case GLFW_KEY_P: // per-phase timings
+                showProfile = !showProfile;
+                break;
+            case GLFW_KEY_T: // write the trace so far
+                traceRequested = !tracePath.empty();
+                break;
         }
     }
 
     // init arrows pos up down left right
-    if(!objs.empty() && objs[objs.size() - 1].Initalizing){
-        if (key == GLFW_KEY_UP && (action == GLFW_PRESS || action == GLFW_REPEAT)){
+    if (viewer.placingBody && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+        float dx = 0.0f, dy = 0.0f, dz = 0.0f;
+        if (key == GLFW_KEY_UP) {
             if (!shiftPressed) {
-                objs[objs.size()-1].position[1] += 0.5;
+                dy += 0.5f;
             }
-        };
-        if (key == GLFW_KEY_DOWN && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
+            dz += 0.5f;
+        }
+        if (key == GLFW_KEY_DOWN) {
             if (!shiftPressed) {
-                objs[objs.size()-1].position[1] -= 0.5;
+                dy -= 0.5f;
             }
+            dz -= 0.5f;
         }
-        if(key == GLFW_KEY_RIGHT && (action == GLFW_PRESS || action == GLFW_REPEAT)){
-            objs[objs.size()-1].position[0] += 0.5;
-        };
-        if(key == GLFW_KEY_LEFT && (action == GLFW_PRESS || action == GLFW_REPEAT)){
-            objs[objs.size()-1].position[0] -= 0.5;
-        };
-        if (key == GLFW_KEY_UP && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
-            objs[objs.size()-1].position[2] += 0.5;
-        };
-
-        if (key == GLFW_KEY_DOWN && (action == GLFW_PRESS || action == GLFW_REPEAT)) {
-            objs[objs.size()-1].position[2] -= 0.5;
+        if (key == GLFW_KEY_RIGHT) {
+            dx += 0.5f;
+        }
+        if (key == GLFW_KEY_LEFT) {
+            dx -= 0.5f;
+        }
+        if (dx != 0.0f || dy != 0.0f || dz != 0.0f) {
+            viewer.simulationThread.Push({CommandType::MoveLast, dx, dy, dz, 0.0f});
         }
     };
     
 };
 void mouse_callback(GLFWwindow* window, double xpos, double ypos) {
-    (void)window;
-    float xoffset = xpos - lastX;
-    float yoffset = lastY - ypos; 
-    lastX = xpos;
-    lastY = ypos;
+    ViewerState& viewer = Viewer(window);
+    float xoffset = xpos - viewer.lastX;
+    float yoffset = viewer.lastY - ypos; 
+    viewer.lastX = xpos;
+    viewer.lastY = ypos;
 
     float sensitivity = 0.1f;
     xoffset *= sensitivity;
     yoffset *= sensitivity;
 
-    yaw += xoffset;
-    pitch += yoffset;
+    viewer.yaw += xoffset;
+    viewer.pitch += yoffset;
 
-    if(pitch > 89.0f) pitch = 89.0f;
-    if(pitch < -89.0f) pitch = -89.0f;
+    if(viewer.pitch > 89.0f) viewer.pitch = 89.0f;
+    if(viewer.pitch < -89.0f) viewer.pitch = -89.0f;
 
     glm::vec3 front;
-    front.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
-    front.y = sin(glm::radians(pitch));
-    front.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
-    cameraFront = glm::normalize(front);
+    front.x = cos(glm::radians(viewer.yaw)) * cos(glm::radians(viewer.pitch));
+    front.y = sin(glm::radians(viewer.pitch));
+    front.z = sin(glm::radians(viewer.yaw)) * cos(glm::radians(viewer.pitch));
+    viewer.cameraFront = glm::normalize(front);
 }
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods){
-    (void)window;
+    ViewerState& viewer = Viewer(window);
     (void)mods;
     if (button == GLFW_MOUSE_BUTTON_LEFT){
         if (action == GLFW_PRESS){
-            objs.emplace_back(glm::vec3(0.0, 0.0, 0.0), glm::vec3(0.0f, 0.0f, 0.0f), initMass);
-            objs[objs.size()-1].Initalizing = true;
+            viewer.simulationThread.Push({CommandType::SpawnBody, 0.0f, 0.0f, 0.0f, viewer.initMass});
+            viewer.placingBody = true;
         };
         if (action == GLFW_RELEASE){
-            objs[objs.size()-1].Initalizing = false;
-            objs[objs.size()-1].Launched = true;
+            viewer.simulationThread.Push({CommandType::LaunchLast, 0.0f, 0.0f, 0.0f, 0.0f});
+            viewer.placingBody = false;
         };
     };
     // if (!objs.empty() && button == GLFW_MOUSE_BUTTON_RIGHT && objs[objs.size()-1].Initalizing) {
@@ -678,207 +980,42 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods){
     // }
 };
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset){
-    (void)window;
+    ViewerState& viewer = Viewer(window);
     (void)xoffset;
-    float cameraSpeed = 50000.0f * deltaTime;
+    float cameraSpeed = 50000.0f * viewer.deltaTime;
     if(yoffset>0){
-        cameraPos += cameraSpeed * cameraFront;
+        viewer.cameraPos += cameraSpeed * viewer.cameraFront;
     } else if(yoffset<0){
-        cameraPos -= cameraSpeed * cameraFront;
+        viewer.cameraPos -= cameraSpeed * viewer.cameraFront;
     }
 }
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height){
     (void)window;
     glViewport(0, 0, width, height);
-}
-
-glm::vec3 sphericalToCartesian(float r, float theta, float phi){
-    float x = r * sin(theta) * cos(phi);
-    float y = r * cos(theta);
-    float z = r * sin(theta) * sin(phi);
-    return glm::vec3(x, y, z);
-};
-void DrawGrid(GLuint shaderProgram, GLuint gridVAO, size_t vertexCount) {
-    glUseProgram(shaderProgram);
-    glm::mat4 model = glm::mat4(1.0f); // Identity matrix for the grid
-    GLint modelLoc = glGetUniformLocation(shaderProgram, "model");
-    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
-
-    glBindVertexArray(gridVAO);
-    glPointSize(5.0f);
-    glDrawArrays(GL_LINES, 0, vertexCount / 3);
-    glBindVertexArray(0);
-}
-std::vector<float> CreateGridVertices(float size, int divisions, const std::vector<Object>& objs) {
-    std::vector<float> vertices;
-    float step = size / divisions;
-    float halfSize = size / 2.0f;
-
-    // x axis
-    for (int yStep = 3; yStep <= 3; ++yStep) {
-        float y = -halfSize*0.3f + yStep * step;
-        for (int zStep = 0; zStep <= divisions; ++zStep) {
-            float z = -halfSize + zStep * step;
-            for (int xStep = 0; xStep < divisions; ++xStep) {
-                float xStart = -halfSize + xStep * step;
-                float xEnd = xStart + step;
-                vertices.push_back(xStart); vertices.push_back(y); vertices.push_back(z);
-                vertices.push_back(xEnd);   vertices.push_back(y); vertices.push_back(z);
-            }
-        }
-    }
-
-    // // yzxis
-    // for (int xStep = 0; xStep <= divisions; ++xStep) {
-    //     float x = -halfSize + xStep * step;
-    //     for (int zStep = 0; zStep <= divisions; ++zStep) {
-    //         float z = -halfSize + zStep * step;s
-    //         for (int yStep = 0; yStep < divisions; ++yStep) {
-    //             float yStart = -halfSize + yStep * step;
-    //             float yEnd = yStart + step;
-    //             vertices.push_back(x); vertices.push_back(yStart); vertices.push_back(z);
-    //             vertices.push_back(x); vertices.push_back(yEnd);   vertices.push_back(z);
-    //         }
-    //     }
-    // }
-
-    // zaxis
-    for (int xStep = 0; xStep <= divisions; ++xStep) {
-        float x = -halfSize + xStep * step;
-        for (int yStep = 3; yStep <= 3; ++yStep) {
-            float y = -halfSize*0.3f + yStep * step;
-            for (int zStep = 0; zStep < divisions; ++zStep) {
-                float zStart = -halfSize + zStep * step;
-                float zEnd = zStart + step;
-                vertices.push_back(x); vertices.push_back(y); vertices.push_back(zStart);
-                vertices.push_back(x); vertices.push_back(y); vertices.push_back(zEnd);
-            }
-        }
-    }
-    
-
-    // displacement
-    // for (int i = 0; i < vertices.size(); i += 3) {
-    //     glm::vec3 vertexPos(vertices[i], vertices[i+1], vertices[i+2]);
-    //     glm::vec3 totalDisplacement(0.0f);
-
-    //     for (const auto& obj : objs) {
-    //         glm::vec3 toObject = obj.GetPos() - vertexPos;
-    //         float distance = glm::length(toObject);
-
-    //         float distance_m = distance * 1000.0f;
-            
-    //         float strength = (G * obj.mass) / (distance_m * distance_m);
-    //         glm::vec3 displacement = glm::normalize(toObject) * strength;
-
-    //         totalDisplacement += -displacement * (2/distance);
-    //     }
-
-    //     vertexPos += totalDisplacement; 
-
-    //     // Update vertex data
-    //     vertices[i]   = vertexPos[0];
-    //     vertices[i+1] = vertexPos[1];
-    //     vertices[i+2] = vertexPos[2];
-    // }
-    for (size_t i = 0; i < vertices.size(); i += 3) {
-        glm::vec3 vertexPos(vertices[i], vertices[i+1], vertices[i+2]);
-        glm::vec3 totalDisplacement(0.0f);
-        
-
-        for (const auto& obj : objs) {
-            glm::vec3 toObject = obj.GetPos() - vertexPos;
-            float distance = glm::length(toObject);
-
-            float distance_m = distance * 1000.0f;
-            float rs = (2*G*obj.mass)/(c*c);
-
-            float z = 2 * sqrt(rs*(distance_m - rs)) * 100.0f;
-            totalDisplacement += z;
-            
-
-        }
-        
-        vertexPos += totalDisplacement; 
-
-         vertices[i+1] = vertexPos[1] / 15.0f - 3000.0f;
+    if (width > 0 && height > 0) {
+        sceneProjection = glm::perspective(glm::radians(45.0f), (float)width / height, 0.1f, 750000.0f);
+        sceneCamera.SetProjection(sceneProjection);
+        screenCamera.SetProjection(glm::ortho(0.0f, (float)width, (float)height, 0.0f, -1.0f, 1.0f));
     }
-    
-
-    return vertices;
 }
 
-// Function to render text for displaying simulation speed
-void renderText(const std::string& text, float x, float y, float scale, GLuint shaderProgram, GLint colorLoc) {
-    // Save current shader settings
-    GLint currentModelLoc = glGetUniformLocation(shaderProgram, "model");
-    
-    // Set color for text (white)
-    glUniform4f(colorLoc, 1.0f, 1.0f, 1.0f, 1.0f);
-    
-    // Setup orthographic projection for 2D rendering
-    glm::mat4 projection = glm::ortho(0.0f, 800.0f, 0.0f, 600.0f, -1.0f, 1.0f);
-    GLint projectionLoc = glGetUniformLocation(shaderProgram, "projection");
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
-    
-    // Setup view matrix (identity for 2D)
-    glm::mat4 view = glm::mat4(1.0f);
-    GLint viewLoc = glGetUniformLocation(shaderProgram, "view");
-    glUniformMatrix4fv(viewLoc, 1, GL_FALSE, glm::value_ptr(view));
-    
-    // Create simple text vertices (just a small square for each character)
-    float characterSize = 10.0f * scale;
-    float spacing = characterSize * 0.5f;
-    
-    // Render each character as a small square
-    for (size_t i = 0; i < text.length(); i++) {
-        float xpos = x + i * spacing;
-        
-        // Create a simple quad for each character
-        float vertices[] = {
-            xpos, y, 0.0f,
-            xpos + characterSize, y, 0.0f,
-            xpos, y + characterSize, 0.0f,
-            xpos + characterSize, y, 0.0f,
-            xpos + characterSize, y + characterSize, 0.0f,
-            xpos, y + characterSize, 0.0f
-        };
-        
-        // Create temporary VAO/VBO for this character
-        GLuint textVAO, textVBO;
-        glGenVertexArrays(1, &textVAO);
-        glGenBuffers(1, &textVBO);
-        
-        glBindVertexArray(textVAO);
-        glBindBuffer(GL_ARRAY_BUFFER, textVBO);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-        
-        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 3 * sizeof(float), (void*)0);
-        glEnableVertexAttribArray(0);
-        
-        // Draw the character
-        glm::mat4 model = glm::mat4(1.0f);
-        glUniformMatrix4fv(currentModelLoc, 1, GL_FALSE, glm::value_ptr(model));
-        glDrawArrays(GL_TRIANGLES, 0, 6);
-        
-        // Clean up
-        glDeleteVertexArrays(1, &textVAO);
-        glDeleteBuffers(1, &textVBO);
-    }
-    
-    // Restore 3D projection
-    projection = glm::perspective(glm::radians(45.0f), 800.0f / 600.0f, 0.1f, 750000.0f);
-    glUniformMatrix4fv(projectionLoc, 1, GL_FALSE, glm::value_ptr(projection));
+void DrawGrid(RenderQueue& queue, const ShaderProgram& shader, GLuint gridVAO, size_t vertexCount) {
+    DrawItem item;
+    item.program = &shader;
+    item.VAO = gridVAO;
+    item.mode = GL_LINES;
+    item.count = vertexCount / 3;
+    item.blend = true;
+    item.color = glm::vec4(1.0f, 1.0f, 1.0f, 0.25f); // White color with 25% opacity for the grid
+    item.model = glm::mat4(1.0f); // Identity matrix for the grid
+    item.gpuPhase = Phase::GpuGrid;
+    queue.Submit(item);
 }
 
-
-
-
-
-
-
-
+glm::vec4 UnpackColor(uint32_t color) {
+    return glm::vec4(color & 0xff, (color >> 8) & 0xff, (color >> 16) & 0xff, color >> 24) / 255.0f;
+}
 
 //check up
 
@@ -0,0 +1,176 @@
+#include "grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Keeps the maxWells heaviest bodies (largest rs) with a min-heap, so the sheet costs O(budget * maxWells)
+// per frame instead of O(budget * N). Light bodies only add a shallow dent, and the rs of a body is
+// proportional to its mass, so dropping them changes the picture least.
+void GatherGridWells(const BodyStore& bodies, size_t maxWells, std::vector<GridWell>& wells) {
+    auto lighter = [](const GridWell& a, const GridWell& b) { return a.rs > b.rs; };
+    wells.clear();
+    if (maxWells == 0) return;
+    for (size_t i = 0; i < bodies.Size(); ++i) {
+        float rs = (2*G*bodies.mass[i])/(speedOfLight*speedOfLight);
+        if (!(rs > 0.0f)) continue;
+        if (wells.size() == maxWells) {
+            if (rs <= wells.front().rs) continue;
+            std::pop_heap(wells.begin(), wells.end(), lighter);
+            wells.pop_back();
+        }
+        wells.push_back({bodies.x[i], bodies.y[i], bodies.z[i], rs});
+        std::push_heap(wells.begin(), wells.end(), lighter);
+    }
+}
+
+// Height of the curved grid sheet at (x, z): sum of the Flamm's paraboloid depth of every well
+float GridHeight(float x, float z, const std::vector<GridWell>& wells) {
+    glm::vec3 vertexPos(x, gridBaseY, z);
+    float totalDisplacement = 0.0f;
+
+    for (const GridWell& well : wells) {
+        glm::vec3 toObject = glm::vec3(well.x, well.y, well.z) - vertexPos;
+        float distance = glm::length(toObject);
+
+        float distance_m = distance * 1000.0f;
+        float rs = well.rs;
+
+        totalDisplacement += 2 * sqrt(rs*(distance_m - rs)) * 100.0f;
+    }
+
+    return (gridBaseY + totalDisplacement) / 15.0f - 3000.0f;
+}
+
+// Refinement priority of a cell: its size as seen from the camera, boosted by how steep the
+// wells under it are, so cells near the camera and near heavy bodies get split first
+float GridCellPriority(const GridCell& cell, const glm::vec3& cameraPos, const std::vector<GridWell>& wells) {
+    float x0 = cell.x, x1 = cell.x + cell.size;
+    float z0 = cell.z, z1 = cell.z + cell.size;
+
+    // distance from the camera to the closest point of the cell on the grid plane
+    float cx = glm::clamp(cameraPos.x, x0, x1) - cameraPos.x;
+    float cz = glm::clamp(cameraPos.z, z0, z1) - cameraPos.z;
+    float cy = (gridBaseY / 15.0f - 3000.0f) - cameraPos.y;
+    float cameraDistance = sqrt(cx*cx + cy*cy + cz*cz);
+
+    // slope of the well (world units of height per unit of distance) at the closest point of the cell
+    float slope = 0.0f;
+    for (const GridWell& well : wells) {
+        float dx = glm::clamp(well.x, x0, x1) - well.x;
+        float dz = glm::clamp(well.z, z0, z1) - well.z;
+        float distance_m = sqrt(dx*dx + dz*dz) * 1000.0f;
+        float rs = well.rs;
+        if (distance_m > 2.0f * rs) {
+            slope += 100.0f * sqrt(rs / (distance_m - rs)) * 1000.0f / 15.0f;
+        } else {
+            slope += gridMaxSlope;
+        }
+    }
+    slope = std::min(slope, gridMaxSlope);
+
+    return cell.size * (1.0f + slope) / std::max(cameraDistance, cell.size * 0.25f);
+}
+
+// Conservative bounds of the displaced cell: every well depth grows with distance, so the lowest the
+// sheet can get is with each body at its closest point and the highest with each at its furthest corner
+bool GridCellVisible(const GridCell& cell, const Frustum& frustum, const std::vector<GridWell>& wells) {
+    float x0 = cell.x, x1 = cell.x + cell.size;
+    float z0 = cell.z, z1 = cell.z + cell.size;
+
+    float nearSum = 0.0f, farSum = 0.0f;
+    for (const GridWell& well : wells) {
+        float dy = gridBaseY - well.y;
+        float nx = glm::clamp(well.x, x0, x1) - well.x;
+        float nz = glm::clamp(well.z, z0, z1) - well.z;
+        float fx = std::max(std::abs(x0 - well.x), std::abs(x1 - well.x));
+        float fz = std::max(std::abs(z0 - well.z), std::abs(z1 - well.z));
+        float rs = well.rs;
+        float near_m = sqrt(nx*nx + dy*dy + nz*nz) * 1000.0f;
+        float far_m = sqrt(fx*fx + dy*dy + fz*fz) * 1000.0f;
+        nearSum += 2 * sqrt(rs * std::max(near_m - rs, 0.0f)) * 100.0f;
+        farSum += 2 * sqrt(rs * std::max(far_m - rs, 0.0f)) * 100.0f;
+    }
+
+    glm::vec3 min(x0, (gridBaseY + nearSum) / 15.0f - 3000.0f, z0);
+    glm::vec3 max(x1, (gridBaseY + farSum) / 15.0f - 3000.0f, z1);
+    return BoxVisible(frustum, min, max);
+}
+
+// Builds the grid as a quadtree over the square [-size/2, size/2] on the XZ plane. Cells are split
+// highest priority first until the next split would overflow vertexBudget, so the vertex count (and
+// the cost of the height pass) is bounded no matter where the camera is. Cells outside the frustum
+// are never split: they keep their coarse edges (so visible neighbours have no gaps) and the budget
+// goes to what is on screen. Only the gridMaxWells heaviest bodies shape the sheet.
+// Writes GL_LINES vertices into `vertices`, reusing its capacity from the previous frame.
+void CreateGridVertices(float size, size_t vertexBudget, const glm::vec3& cameraPos, const Frustum& frustum,
+                        const BodyStore& bodies, std::vector<float>& vertices) {
+    const int finest = 1 << gridMaxDepth; // side of the grid in units of the smallest cell
+    const float halfSize = size / 2.0f;
+    const float unit = size / finest;
+
+    std::vector<GridWell> wells;
+    wells.reserve(gridMaxWells);
+    GatherGridWells(bodies, gridMaxWells, wells);
+
+    auto byPriority = [](const GridCell& a, const GridCell& b) { return a.priority < b.priority; };
+    std::vector<GridCell> open;   // leaves that may still be split (heap)
+    std::vector<GridCell> leaves; // leaves that are final
+    open.reserve(vertexBudget / 12 + 4);
+    leaves.reserve(vertexBudget / 4 + 4);
+
+    GridCell root = {-halfSize, -halfSize, size, 0, 0, finest, 0, 0.0f};
+    root.priority = GridCellPriority(root, cameraPos, wells);
+    open.push_back(root);
+
+    // every leaf draws its -x and -z edges, plus its +x / +z edge when it sits on the border
+    size_t vertexCount = 8;
+    while (!open.empty()) {
+        std::pop_heap(open.begin(), open.end(), byPriority);
+        GridCell cell = open.back();
+        open.pop_back();
+
+        // 3 more leaves, each with 2 edges, plus one extra border edge per border the cell touches
+        size_t splitCost = 12;
+        if (cell.ix + cell.span == finest) splitCost += 2;
+        if (cell.iz + cell.span == finest) splitCost += 2;
+
+        if (cell.depth >= gridMaxDepth || vertexCount + splitCost > vertexBudget) {
+            leaves.push_back(cell);
+            continue;
+        }
+        vertexCount += splitCost;
+
+        int half = cell.span / 2;
+        for (int child = 0; child < 4; ++child) {
+            GridCell sub;
+            sub.ix = cell.ix + (child & 1) * half;
+            sub.iz = cell.iz + (child >> 1) * half;
+            sub.span = half;
+            sub.depth = cell.depth + 1;
+            sub.x = -halfSize + sub.ix * unit;
+            sub.z = -halfSize + sub.iz * unit;
+            sub.size = half * unit;
+            if (!GridCellVisible(sub, frustum, wells)) {
+                leaves.push_back(sub);
+                continue;
+            }
+            sub.priority = GridCellPriority(sub, cameraPos, wells);
+            open.push_back(sub);
+            std::push_heap(open.begin(), open.end(), byPriority);
+        }
+    }
+
+    vertices.clear();
+    auto pushLine = [&](float xStart, float zStart, float xEnd, float zEnd) {
+        vertices.push_back(xStart); vertices.push_back(GridHeight(xStart, zStart, wells)); vertices.push_back(zStart);
+        vertices.push_back(xEnd);   vertices.push_back(GridHeight(xEnd, zEnd, wells));     vertices.push_back(zEnd);
+    };
+    for (const GridCell& cell : leaves) {
+        float x1 = cell.x + cell.size;
+        float z1 = cell.z + cell.size;
+        pushLine(cell.x, cell.z, x1, cell.z);
+        pushLine(cell.x, cell.z, cell.x, z1);
+        if (cell.ix + cell.span == finest) pushLine(x1, cell.z, x1, z1);
+        if (cell.iz + cell.span == finest) pushLine(cell.x, z1, x1, z1);
+    }
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstddef>
+#include <vector>
+
+#include "frustum.h"
+#include "simulation.h"
+
+const float speedOfLight = 299792458.0f; // m/s
+
+// Adaptive grid: a quadtree over the XZ plane refined near the camera and near deep wells
+struct GridCell {
+    float x, z, size;   // world-space corner and side length
+    int ix, iz, span;   // the same square in units of the finest cell
+    int depth;
+    float priority;
+};
+const int gridMaxDepth = 10;             // smallest cell is size / 1024
+const size_t gridVertexBudget = 16384;   // GL_LINES vertices uploaded per frame
+const float gridBaseY = -900.0f;         // plane height before the wells are applied (-halfSize*0.3 + 3*step of the old grid)
+const float gridMaxSlope = 50.0f;        // clamp for cells sitting right on top of a body
+const size_t gridMaxWells = 64;          // only the heaviest bodies bend the sheet, so a frame costs budget * 64 at most
+
+// A body that bends the grid: its position and Schwarzschild radius in metres
+struct GridWell {
+    float x, y, z, rs;
+};
+
+void GatherGridWells(const BodyStore& bodies, size_t maxWells, std::vector<GridWell>& wells);
+
+float GridHeight(float x, float z, const std::vector<GridWell>& wells);
+float GridCellPriority(const GridCell& cell, const glm::vec3& cameraPos, const std::vector<GridWell>& wells);
+bool GridCellVisible(const GridCell& cell, const Frustum& frustum, const std::vector<GridWell>& wells);
+void CreateGridVertices(float size, size_t vertexBudget, const glm::vec3& cameraPos, const Frustum& frustum,
+                        const BodyStore& bodies, std::vector<float>& vertices);
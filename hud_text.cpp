@@ -0,0 +1,238 @@
+#include "hud_text.h"
+
+#include <algorithm>
+
+namespace {
+
+const char* hudVertexShaderSource = R"glsl(
+#version 330 core
+layout(location=0) in vec2 aPos;
+layout(location=1) in vec2 aUV;
+layout(location=2) in vec4 aColor;
+layout(std140) uniform Camera {
+    mat4 view;
+    mat4 projection;
+};
+out vec2 vUV;
+out vec4 vColor;
+void main() {
+    vUV = aUV;
+    vColor = aColor;
+    gl_Position = projection * view * vec4(aPos, 0.0, 1.0);
+})glsl";
+
+const char* hudFragmentShaderSource = R"glsl(
+#version 330 core
+in vec2 vUV;
+in vec4 vColor;
+out vec4 FragColor;
+uniform sampler2D glyphAtlas;
+void main() {
+    FragColor = vec4(vColor.rgb, vColor.a * texture(glyphAtlas, vUV).r);
+}
+)glsl";
+
+const int glyphWidth = 5;
+const int glyphHeight = 7;
+const int cellWidth = glyphWidth + 1;   // one pixel of padding so neighbours never bleed
+const int cellHeight = glyphHeight + 1;
+const int atlasColumns = 16;
+const int atlasRows = 6;                // ASCII 32..127
+const int atlasWidth = atlasColumns * cellWidth;
+const int atlasHeight = atlasRows * cellHeight;
+
+struct Glyph {
+    char character;
+    const char* rows; // 7 rows of 5 pixels, '#' = set
+};
+
+// Lowercase letters are drawn with the uppercase glyphs
+const Glyph font[] = {
+    {' ', "....." "....." "....." "....." "....." "....." "....."},
+    {'!', "..#.." "..#.." "..#.." "..#.." "..#.." "....." "..#.."},
+    {'"', ".#.#." ".#.#." "....." "....." "....." "....." "....."},
+    {'#', ".#.#." ".#.#." "#####" ".#.#." "#####" ".#.#." ".#.#."},
+    {'$', "..#.." ".####" "#.#.." ".###." "..#.#" "####." "..#.."},
+    {'%', "##..." "##..#" "...#." "..#.." ".#..." "#..##" "...##"},
+    {'&', ".##.." "#..#." "#.#.." ".#..." "#.#.#" "#..#." ".##.#"},
+    {'\'', "..#.." "..#.." "....." "....." "....." "....." "....."},
+    {'(', "...#." "..#.." ".#..." ".#..." ".#..." "..#.." "...#."},
+    {')', ".#..." "..#.." "...#." "...#." "...#." "..#.." ".#..."},
+    {'*', "....." "..#.." "#.#.#" ".###." "#.#.#" "..#.." "....."},
+    {'+', "....." "..#.." "..#.." "#####" "..#.." "..#.." "....."},
+    {',', "....." "....." "....." "....." ".##.." "..#.." ".#..."},
+    {'-', "....." "....." "....." "#####" "....." "....." "....."},
+    {'.', "....." "....." "....." "....." "....." ".##.." ".##.."},
+    {'/', "....." "....#" "...#." "..#.." ".#..." "#...." "....."},
+    {'0', ".###." "#...#" "#..##" "#.#.#" "##..#" "#...#" ".###."},
+    {'1', "..#.." ".##.." "..#.." "..#.." "..#.." "..#.." ".###."},
+    {'2', ".###." "#...#" "....#" "...#." "..#.." ".#..." "#####"},
+    {'3', "#####" "...#." "..#.." "...#." "....#" "#...#" ".###."},
+    {'4', "...#." "..##." ".#.#." "#..#." "#####" "...#." "...#."},
+    {'5', "#####" "#...." "####." "....#" "....#" "#...#" ".###."},
+    {'6', "..##." ".#..." "#...." "####." "#...#" "#...#" ".###."},
+    {'7', "#####" "....#" "...#." "..#.." ".#..." ".#..." ".#..."},
+    {'8', ".###." "#...#" "#...#" ".###." "#...#" "#...#" ".###."},
+    {'9', ".###." "#...#" "#...#" ".####" "....#" "...#." ".##.."},
+    {':', "....." ".##.." ".##.." "....." ".##.." ".##.." "....."},
+    {';', "....." ".##.." ".##.." "....." ".##.." "..#.." ".#..."},
+    {'<', "...#." "..#.." ".#..." "#...." ".#..." "..#.." "...#."},
+    {'=', "....." "....." "#####" "....." "#####" "....." "....."},
+    {'>', ".#..." "..#.." "...#." "....#" "...#." "..#.." ".#..."},
+    {'?', ".###." "#...#" "....#" "...#." "..#.." "....." "..#.."},
+    {'@', ".###." "#...#" "....#" ".##.#" "#.#.#" "#.#.#" ".###."},
+    {'A', ".###." "#...#" "#...#" "#####" "#...#" "#...#" "#...#"},
+    {'B', "####." "#...#" "#...#" "####." "#...#" "#...#" "####."},
+    {'C', ".###." "#...#" "#...." "#...." "#...." "#...#" ".###."},
+    {'D', "###.." "#..#." "#...#" "#...#" "#...#" "#..#." "###.."},
+    {'E', "#####" "#...." "#...." "####." "#...." "#...." "#####"},
+    {'F', "#####" "#...." "#...." "####." "#...." "#...." "#...."},
+    {'G', ".###." "#...#" "#...." "#.###" "#...#" "#...#" ".####"},
+    {'H', "#...#" "#...#" "#...#" "#####" "#...#" "#...#" "#...#"},
+    {'I', ".###." "..#.." "..#.." "..#.." "..#.." "..#.." ".###."},
+    {'J', "..###" "...#." "...#." "...#." "...#." "#..#." ".##.."},
+    {'K', "#...#" "#..#." "#.#.." "##..." "#.#.." "#..#." "#...#"},
+    {'L', "#...." "#...." "#...." "#...." "#...." "#...." "#####"},
+    {'M', "#...#" "##.##" "#.#.#" "#.#.#" "#...#" "#...#" "#...#"},
+    {'N', "#...#" "#...#" "##..#" "#.#.#" "#..##" "#...#" "#...#"},
+    {'O', ".###." "#...#" "#...#" "#...#" "#...#" "#...#" ".###."},
+    {'P', "####." "#...#" "#...#" "####." "#...." "#...." "#...."},
+    {'Q', ".###." "#...#" "#...#" "#...#" "#.#.#" "#..#." ".##.#"},
+    {'R', "####." "#...#" "#...#" "####." "#.#.." "#..#." "#...#"},
+    {'S', ".####" "#...." "#...." ".###." "....#" "....#" "####."},
+    {'T', "#####" "..#.." "..#.." "..#.." "..#.." "..#.." "..#.."},
+    {'U', "#...#" "#...#" "#...#" "#...#" "#...#" "#...#" ".###."},
+    {'V', "#...#" "#...#" "#...#" "#...#" "#...#" ".#.#." "..#.."},
+    {'W', "#...#" "#...#" "#...#" "#.#.#" "#.#.#" "#.#.#" ".#.#."},
+    {'X', "#...#" "#...#" ".#.#." "..#.." ".#.#." "#...#" "#...#"},
+    {'Y', "#...#" "#...#" ".#.#." "..#.." "..#.." "..#.." "..#.."},
+    {'Z', "#####" "....#" "...#." "..#.." ".#..." "#...." "#####"},
+    {'[', ".###." ".#..." ".#..." ".#..." ".#..." ".#..." ".###."},
+    {'\\', "....." "#...." ".#..." "..#.." "...#." "....#" "....."},
+    {']', ".###." "...#." "...#." "...#." "...#." "...#." ".###."},
+    {'^', "..#.." ".#.#." "#...#" "....." "....." "....." "....."},
+    {'_', "....." "....." "....." "....." "....." "....." "#####"},
+    {'`', ".#..." "..#.." "....." "....." "....." "....." "....."},
+    {'{', "...#." "..#.." "..#.." ".#..." "..#.." "..#.." "...#."},
+    {'|', "..#.." "..#.." "..#.." "..#.." "..#.." "..#.." "..#.."},
+    {'}', ".#..." "..#.." "..#.." "...#." "..#.." "..#.." ".#..."},
+    {'~', "....." "....." ".#..." "#.#.#" "...#." "....." "....."},
+};
+
+} // namespace
+
+void HudText::Create() {
+    program = ShaderProgram(hudVertexShaderSource, hudFragmentShaderSource);
+    program.Use();
+    glUniform1i(program.Location("glyphAtlas"), 0);
+
+    // Bake the font into a single-channel atlas, glyph for ASCII code n in cell n - 32
+    std::vector<unsigned char> pixels(atlasWidth * atlasHeight, 0);
+    for (const Glyph& glyph : font) {
+        int cell = glyph.character - 32;
+        int cellX = (cell % atlasColumns) * cellWidth;
+        int cellY = (cell / atlasColumns) * cellHeight;
+        for (int row = 0; row < glyphHeight; ++row) {
+            for (int col = 0; col < glyphWidth; ++col) {
+                if (glyph.rows[row * glyphWidth + col] == '#') {
+                    pixels[(cellY + row) * atlasWidth + cellX + col] = 255;
+                }
+            }
+        }
+    }
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, atlasWidth, atlasHeight, 0, GL_RED, GL_UNSIGNED_BYTE, pixels.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(4 * sizeof(float)));
+    glEnableVertexAttribArray(2);
+    glBindVertexArray(0);
+}
+
+void HudText::Clear() {
+    vertices.clear();
+}
+
+void HudText::Add(const std::string& text, float x, float y, float scale, const glm::vec4& color) {
+    const float advance = cellWidth * scale;
+    const float width = glyphWidth * scale;
+    const float height = glyphHeight * scale;
+
+    float penX = x;
+    for (char ch : text) {
+        if (ch == '\n') {
+            penX = x;
+            y += LineHeight(scale);
+            continue;
+        }
+        if (ch >= 'a' && ch <= 'z') ch = ch - 'a' + 'A';
+        if (ch < 32 || ch > 126) ch = '?';
+        if (ch == ' ') {
+            penX += advance;
+            continue;
+        }
+
+        int cell = ch - 32;
+        float u0 = (float)((cell % atlasColumns) * cellWidth) / atlasWidth;
+        float v0 = (float)((cell / atlasColumns) * cellHeight) / atlasHeight;
+        float u1 = u0 + (float)glyphWidth / atlasWidth;
+        float v1 = v0 + (float)glyphHeight / atlasHeight;
+        float x1 = penX + width;
+        float y1 = y + height;
+
+        const float quad[6][4] = {
+            {penX, y, u0, v0}, {x1, y, u1, v0}, {penX, y1, u0, v1},
+            {x1, y, u1, v0}, {x1, y1, u1, v1}, {penX, y1, u0, v1},
+        };
+        for (const auto& corner : quad) {
+            vertices.insert(vertices.end(), {corner[0], corner[1], corner[2], corner[3],
+                                             color.r, color.g, color.b, color.a});
+        }
+        penX += advance;
+    }
+}
+
+void HudText::Draw(const CameraUniforms& screenCamera, const CameraUniforms& sceneCamera) {
+    if (vertices.empty()) return;
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (vertices.size() > capacity) {
+        capacity = std::max(vertices.size(), capacity * 2);
+    }
+    glBufferData(GL_ARRAY_BUFFER, capacity * sizeof(float), nullptr, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(float), vertices.data());
+
+    screenCamera.Bind();
+    glDisable(GL_DEPTH_TEST);
+    program.Use();
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glBindVertexArray(VAO);
+    glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 8);
+    glBindVertexArray(0);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glEnable(GL_DEPTH_TEST);
+    sceneCamera.Bind();
+}
+
+void HudText::Destroy() {
+    glDeleteTextures(1, &texture);
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    program.Destroy();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <vector>
+
+#include "shader_program.h"
+
+// Screen-space text from a 5x7 bitmap font baked into one glyph atlas texture.
+// All strings added during a frame go into a single vertex buffer that is
+// uploaded and drawn with one call in Draw().
+class HudText {
+    public:
+        void Create();
+        void Clear();
+        // x, y: top-left corner in pixels from the top-left of the screen; scale: pixels per font pixel
+        void Add(const std::string& text, float x, float y, float scale, const glm::vec4& color);
+        // Draws everything added since Clear() using the (top-left origin) screen camera
+        void Draw(const CameraUniforms& screenCamera, const CameraUniforms& sceneCamera);
+        void Destroy();
+
+        static float LineHeight(float scale) { return 10.0f * scale; }
+
+    private:
+        ShaderProgram program;
+        GLuint texture = 0, VAO = 0, VBO = 0;
+        size_t capacity = 0; // floats
+        std::vector<float> vertices; // x, y, u, v, r, g, b, a
+};
@@ -0,0 +1,32 @@
+#include "interpolation.h"
+
+#include <algorithm>
+
+void SnapshotInterpolator::Push(const Snapshot& newest) {
+    std::swap(previous, latest);
+    latest.x = newest.bodies.x;
+    latest.y = newest.bodies.y;
+    latest.z = newest.bodies.z;
+    latest.id = newest.bodies.id;
+    latest.time = newest.publishTime;
+}
+
+float SnapshotInterpolator::Alpha(double now) const {
+    if (previous.id.empty()) return 1.0f;
+    const double stepInterval = latest.time - previous.time;
+    if (stepInterval <= 0.0) return 1.0f;
+    float alpha = (float)((now - latest.time) / stepInterval);
+    return std::min(std::max(alpha, 0.0f), 1.0f + maxExtrapolation);
+}
+
+const BodyStore& SnapshotInterpolator::Blend(const Snapshot& newest, float alpha) {
+    display = newest.bodies; // reuses the capacity from the previous frame
+    const size_t count = std::min(display.Size(), previous.id.size());
+    for (size_t i = 0; i < count; ++i) {
+        if (previous.id[i] != display.id[i]) continue;
+        display.x[i] = previous.x[i] + (display.x[i] - previous.x[i]) * alpha;
+        display.y[i] = previous.y[i] + (display.y[i] - previous.y[i]) * alpha;
+        display.z[i] = previous.z[i] + (display.z[i] - previous.z[i]) * alpha;
+    }
+    return display;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "simulation.h"
+
+// Smooths motion between fixed physics steps. The renderer draws one step behind the newest
+// snapshot, blending it with the one before by how far the frame is into the next step, and
+// extrapolates a little past it when the next snapshot is late. The step interval is measured
+// from the publish times of those two snapshots, so slow steps (huge N, a low step rate) still
+// blend over their real duration.
+class SnapshotInterpolator {
+    public:
+        float maxExtrapolation = 0.5f; // steps past the newest snapshot
+
+        // Call once for every newly acquired snapshot, before drawing it
+        void Push(const Snapshot& newest);
+        // Fraction of a step from the previous to the newest snapshot at wall time `now`
+        // (SteadySeconds()); above 1 when extrapolating
+        float Alpha(double now) const;
+        // The bodies of the last pushed snapshot with their positions blended by alpha.
+        // Bodies without a previous position (new ones, or a reordered store) are drawn as is.
+        const BodyStore& Blend(const Snapshot& newest, float alpha);
+
+    private:
+        struct Positions {
+            std::vector<float> x, y, z;
+            std::vector<uint32_t> id;
+            double time = 0.0;
+        };
+        Positions previous, latest;
+        BodyStore display;
+};
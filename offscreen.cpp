@@ -0,0 +1,91 @@
+#include "offscreen.h"
+
+#include <iostream>
+
+bool OffscreenTarget::Create(int targetWidth, int targetHeight) {
+    width = targetWidth;
+    height = targetHeight;
+
+    glGenRenderbuffers(1, &colorRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, colorRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glGenRenderbuffers(1, &depthRenderbuffer);
+    glBindRenderbuffer(GL_RENDERBUFFER, depthRenderbuffer);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRenderbuffer);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRenderbuffer);
+    GLenum status = glCheckFramebufferStatus(GL_FRAMEBUFFER);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    if (status != GL_FRAMEBUFFER_COMPLETE) {
+        std::cerr << "Offscreen framebuffer incomplete (0x" << std::hex << status << std::dec << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void OffscreenTarget::Bind() const {
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glViewport(0, 0, width, height);
+}
+
+void OffscreenTarget::Destroy() {
+    glDeleteFramebuffers(1, &fbo);
+    glDeleteRenderbuffers(1, &colorRenderbuffer);
+    glDeleteRenderbuffers(1, &depthRenderbuffer);
+    fbo = colorRenderbuffer = depthRenderbuffer = 0;
+}
+
+bool FrameWriter::Open(const std::string& outputPath, int frameWidth, int frameHeight) {
+    path = outputPath;
+    width = frameWidth;
+    height = frameHeight;
+    frameIndex = 0;
+    perFrameFiles = path.find('%') != std::string::npos;
+    pipe = !path.empty() && path[0] == '|';
+    if (perFrameFiles) return true;
+
+    if (pipe) {
+        stream = popen(path.c_str() + 1, "w");
+    } else {
+        stream = path == "-" ? stdout : std::fopen(path.c_str(), "wb");
+    }
+    if (!stream) {
+        std::cerr << "Cannot open " << path << " for writing" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool FrameWriter::Write(const std::vector<uint8_t>& rgb) {
+    bool ok;
+    if (perFrameFiles) {
+        char name[1024];
+        std::snprintf(name, sizeof(name), path.c_str(), frameIndex);
+        FILE* file = std::fopen(name, "wb");
+        if (!file) {
+            std::cerr << "Cannot open " << name << " for writing" << std::endl;
+            return false;
+        }
+        std::fprintf(file, "P6\n%d %d\n255\n", width, height);
+        ok = std::fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+        ok = std::fclose(file) == 0 && ok;
+    } else {
+        ok = std::fwrite(rgb.data(), 1, rgb.size(), stream) == rgb.size();
+    }
+    if (ok) frameIndex++;
+    return ok;
+}
+
+void FrameWriter::Close() {
+    if (pipe && stream) {
+        pclose(stream);
+    } else if (stream && stream != stdout) {
+        std::fclose(stream);
+    } else if (stream == stdout) {
+        std::fflush(stdout);
+    }
+    stream = nullptr;
+}
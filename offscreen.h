@@ -0,0 +1,37 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+// Color + depth framebuffer object of any size, independent of the window (which may be hidden)
+class OffscreenTarget {
+    public:
+        GLuint fbo = 0, colorRenderbuffer = 0, depthRenderbuffer = 0;
+        int width = 0, height = 0;
+
+        bool Create(int width, int height); // false if the framebuffer is incomplete
+        void Bind() const;                  // also sets the viewport
+        void Destroy();
+};
+
+// Writes rendered frames either as numbered PPM files (when the path is a printf pattern)
+// or as one raw RGB24 stream: to a file, to stdout ("-") or into a command ("|ffmpeg ...")
+class FrameWriter {
+    public:
+        bool Open(const std::string& path, int width, int height);
+        // Tightly packed RGB8 pixels, top row first
+        bool Write(const std::vector<uint8_t>& rgb);
+        void Close();
+        int FramesWritten() const { return frameIndex; }
+
+    private:
+        std::string path;
+        bool perFrameFiles = false;
+        bool pipe = false;
+        FILE* stream = nullptr;
+        int width = 0, height = 0;
+        int frameIndex = 0;
+};
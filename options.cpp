@@ -0,0 +1,167 @@
+#include "options.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+void PrintUsage(const char* program) {
+    std::fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --headless WxH      render offscreen at W x H pixels and write frames instead of opening a window\n"
+        "  --frames N          headless: number of frames to write (default 300)\n"
+        "  --frame-time T      headless: simulated seconds between frames (default one 1x step, 1/94)\n"
+        "  --output PATH       headless: printf pattern such as frame_%%05d.ppm for one PPM per frame,\n"
+        "                      any other path for a single raw RGB24 stream, - for raw RGB24 on stdout,\n"
+        "                      |command to pipe the raw stream into a command (e.g. an encoder)\n"
+        "  --record PATH       windowed: record the displayed frames, PATH as for --output\n"
+        "  --profile-csv PATH  write a per-phase timing summary on exit\n"
+        "  --trace PATH        record a Chrome trace-event timeline, written on exit and when T is pressed\n"
+        "  --conserved-csv PATH  energy, momentum, angular momentum, center of mass and their drift per step drawn\n"
+        "  --checkpoint PATH   write a binary checkpoint on exit and on SIGTERM / SIGINT\n"
+        "  --checkpoint-interval S  also every S seconds of wall time, written in the background\n"
+        "  --restart PATH      continue from a checkpoint (bodies, time, speed, force backend, integrator)\n"
+        "  --scene PATH        start from a scene file (text: x y z vx vy vz mass [density [color [trail]]] per line,\n"
+        "                      or the binary bulk format) instead of the Earth-Moon pair\n"
+        "  --generate NAME     add a generated distribution: plummer, hernquist, disk (exponential, around a\n"
+        "                      central body) or cube (uniform, at rest); replaces the Earth-Moon pair\n"
+        "  --bodies N          bodies to generate (default 100000, at most 100000000)\n"
+        "  --seed S            generator seed (default 1)\n"
+        "  --save-scene PATH   write the starting bodies as a binary scene\n"
+        "  --record-events PATH  windowed: log every input event with the step it was applied at\n"
+        "  --replay PATH       replay an event log at full speed without a window (start with the same --scene,\n"
+        "                      --generate or --restart); exits 2 if the final state differs from the recording\n"
+        "  --shared-memory NAME  publish snapshots in a shared-memory ring (e.g. /gravity) for gravity_attach\n"
+        "                      and other readers\n"
+        "  --shared-slots N    snapshots kept in the ring (default 4)\n"
+        "  --trajectory PATH   stream a compressed, time-indexed trajectory of the bodies (see gravity_trajectory)\n"
+        "  --trajectory-every N  record every N-th step (default 1)\n"
+        "  --trajectory-quantum Q  position precision in scene units (default 0.01, velocities Q/10)\n"
+        "  --step-rate HZ      windowed: physics steps per second (default 60, 0 = as fast as possible);\n"
+        "                      motion is interpolated between steps, so huge scenes can step slower\n"
+        "  --threads N         threads for the force pass (default 0 = one per hardware thread)\n"
+        "  --force NAME        force backend: direct (every pair, default) or barnes-hut (octree)\n"
+        "  --integrator NAME   euler (default, the original update) or leapfrog (second order)\n",
+        program);
+}
+
+bool ParseOptions(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (std::strcmp(arg, "--help") == 0 || std::strcmp(arg, "-h") == 0) {
+            PrintUsage(argv[0]);
+            std::exit(0);
+        } else if (std::strcmp(arg, "--headless") == 0 && value) {
+            options.headless = true;
+            ok = std::sscanf(value, "%dx%d", &options.width, &options.height) == 2 && options.width > 0 && options.height > 0;
+            ++i;
+        } else if (std::strcmp(arg, "--frames") == 0 && value) {
+            options.frames = std::atoi(value);
+            ok = options.frames > 0;
+            ++i;
+        } else if (std::strcmp(arg, "--frame-time") == 0 && value) {
+            options.frameTime = std::atof(value);
+            ok = options.frameTime > 0.0;
+            ++i;
+        } else if (std::strcmp(arg, "--output") == 0 && value) {
+            options.output = value;
+            ++i;
+        } else if (std::strcmp(arg, "--record") == 0 && value) {
+            options.record = value;
+            ++i;
+        } else if (std::strcmp(arg, "--profile-csv") == 0 && value) {
+            options.profileCsv = value;
+            ++i;
+        } else if (std::strcmp(arg, "--trace") == 0 && value) {
+            options.trace = value;
+            ++i;
+        } else if (std::strcmp(arg, "--conserved-csv") == 0 && value) {
+            options.conservedCsv = value;
+            ++i;
+        } else if (std::strcmp(arg, "--checkpoint") == 0 && value) {
+            options.checkpoint = value;
+            ++i;
+        } else if (std::strcmp(arg, "--checkpoint-interval") == 0 && value) {
+            options.checkpointInterval = std::atof(value);
+            ok = options.checkpointInterval >= 0.0;
+            ++i;
+        } else if (std::strcmp(arg, "--restart") == 0 && value) {
+            options.restart = value;
+            ++i;
+        } else if (std::strcmp(arg, "--scene") == 0 && value) {
+            options.scene = value;
+            ++i;
+        } else if (std::strcmp(arg, "--generate") == 0 && value) {
+            options.generate = true;
+            ok = ParseSceneGenerator(value, options.generator);
+            ++i;
+        } else if (std::strcmp(arg, "--bodies") == 0 && value) {
+            // strtod accepts 1e6; the whole argument must parse and the range is checked before the cast
+            char* end = nullptr;
+            double count = std::strtod(value, &end);
+            ok = end != value && *end == '\0' && count >= 1.0 && count <= (double)maxGenerateCount;
+            if (ok) options.generateCount = (size_t)count;
+            ++i;
+        } else if (std::strcmp(arg, "--seed") == 0 && value) {
+            options.seed = (uint32_t)std::strtoul(value, nullptr, 10);
+            ++i;
+        } else if (std::strcmp(arg, "--save-scene") == 0 && value) {
+            options.saveScene = value;
+            ++i;
+        } else if (std::strcmp(arg, "--record-events") == 0 && value) {
+            options.recordEvents = value;
+            ++i;
+        } else if (std::strcmp(arg, "--replay") == 0 && value) {
+            options.replay = value;
+            ++i;
+        } else if (std::strcmp(arg, "--shared-memory") == 0 && value) {
+            options.sharedMemory = value;
+            ok = value[0] == '/';
+            ++i;
+        } else if (std::strcmp(arg, "--shared-slots") == 0 && value) {
+            options.sharedSlots = std::atoi(value);
+            ok = options.sharedSlots >= 2;
+            ++i;
+        } else if (std::strcmp(arg, "--trajectory") == 0 && value) {
+            options.trajectory = value;
+            ++i;
+        } else if (std::strcmp(arg, "--trajectory-every") == 0 && value) {
+            options.trajectoryEvery = std::atoi(value);
+            ok = options.trajectoryEvery > 0;
+            ++i;
+        } else if (std::strcmp(arg, "--trajectory-quantum") == 0 && value) {
+            options.trajectoryQuantum = (float)std::atof(value);
+            ok = options.trajectoryQuantum > 0.0f;
+            ++i;
+        } else if (std::strcmp(arg, "--step-rate") == 0 && value) {
+            options.stepRate = std::atof(value);
+            ok = options.stepRate >= 0.0;
+            ++i;
+        } else if (std::strcmp(arg, "--threads") == 0 && value) {
+            options.threads = std::atoi(value);
+            ok = options.threads >= 0;
+            ++i;
+        } else if (std::strcmp(arg, "--force") == 0 && value) {
+            ok = ParseForceBackend(value, options.backend);
+            ++i;
+        } else if (std::strcmp(arg, "--integrator") == 0 && value) {
+            ok = ParseIntegrator(value, options.integrator);
+            ++i;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::fprintf(stderr, "%s: bad argument '%s'\n", argv[0], arg);
+            PrintUsage(argv[0]);
+            return false;
+        }
+    }
+    if (options.headless && !options.recordEvents.empty()) {
+        std::fprintf(stderr, "%s: --record-events records interactive input, headless runs have none\n", argv[0]);
+        return false;
+    }
+    return true;
+}
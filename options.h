@@ -0,0 +1,79 @@
+#pragma once
+
+#include <string>
+
+#include "simulation.h"
+#include "scenes.h"
+
+// Upper bound for --bodies: far beyond what a frame can show, well below the 32-bit body ids
+const size_t maxGenerateCount = 100000000;
+
+// Command line of gravity_sim_3Dgrid
+struct Options {
+    // Headless: no visible window, render offscreen at width x height and write frames
+    bool headless = false;
+    int width = 800;
+    int height = 600;
+    int frames = 300;                 // frames to write before exiting
+    double frameTime = 1.0 / 94.0;    // simulated seconds between frames (one 1x step)
+    std::string output = "frame_%05d.ppm"; // printf pattern: one PPM per frame; otherwise one raw RGB24 stream ("-" = stdout, "|cmd" = pipe)
+
+    // Windowed: record every displayed frame to this path (same forms as output), empty = off
+    std::string record;
+
+    // Per-phase timing summary written on exit (profiling builds only), empty = off
+    std::string profileCsv;
+
+    // Chrome trace-event JSON of every phase span, written on exit and when T is pressed; empty = off
+    std::string trace;
+
+    // Energy, momentum, angular momentum and center of mass (and their drift) per new snapshot; empty = off
+    std::string conservedCsv;
+
+    // Checkpoints: written every checkpointInterval seconds of wall time (0 = only on exit and SIGTERM)
+    // to checkpoint, empty = off; restart loads one instead of the built-in scene
+    std::string checkpoint;
+    double checkpointInterval = 0.0;
+    std::string restart;
+
+    // Initial bodies from a text or binary scene file instead of the Earth-Moon pair, empty = built-in;
+    // saveScene writes the starting bodies as a binary scene
+    std::string scene;
+    std::string saveScene;
+
+    // Input events (spawning, moving, growing and launching bodies, speed, pause) with the step they were
+    // applied at, written on exit; replay drives the simulation from such a log without a window
+    std::string recordEvents;
+    std::string replay;
+
+    // Built-in distribution of generateCount bodies added to the scene (instead of the Earth-Moon pair
+    // when there is no scene file); the same seed gives the same bodies for any thread count
+    bool generate = false;
+    SceneGenerator generator = SceneGenerator::Plummer;
+    size_t generateCount = 100000;
+    uint32_t seed = 1;
+
+    // Every new snapshot into a POSIX shared-memory ring of sharedSlots slots that other processes can
+    // read in place (see gravity_attach), empty = off
+    std::string sharedMemory;
+    int sharedSlots = 4;
+
+    // Compressed trajectory (ids, positions, velocities) of every trajectoryEvery-th step, empty = off;
+    // positions are kept to trajectoryQuantum scene units, velocities to a tenth of that
+    std::string trajectory;
+    int trajectoryEvery = 1;
+    float trajectoryQuantum = 0.01f;
+
+    // Windowed: physics steps per second of wall time (the per-step factors were tuned at 60),
+    // 0 = as fast as possible; the renderer interpolates between steps at any rate
+    double stepRate = 60.0;
+
+    // Force pass: worker threads (0 = one per hardware thread) and backend
+    int threads = 0;
+    ForceBackend backend = ForceBackend::Direct;
+    Integrator integrator = Integrator::Euler;
+};
+
+// Returns false (after printing usage to stderr) on a malformed command line
+bool ParseOptions(int argc, char** argv, Options& options);
+void PrintUsage(const char* program);
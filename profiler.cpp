@@ -0,0 +1,135 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+// Overlay: the newest samples of each phase in a ring
+const size_t recentCapacity = 1024;
+// Summary: a log-spaced histogram, 16 buckets per octave from 2^-10 ms (about 1 us) up to
+// 2^17 ms, so percentiles are within about 2% whatever the length of the run
+const int bucketsPerOctave = 16;
+const int minOctave = -10;
+const int bucketCount = 27 * bucketsPerOctave + 2; // plus one below and one above the range
+
+int BucketOf(float ms) {
+    if (!(ms > 0.0f)) return 0;
+    int bucket = (int)std::floor((std::log2(ms) - minOctave) * bucketsPerOctave) + 1;
+    return std::min(std::max(bucket, 0), bucketCount - 1);
+}
+
+// Geometric middle of a bucket
+double BucketValue(int bucket) {
+    return std::exp2(minOctave + (bucket - 0.5) / bucketsPerOctave);
+}
+
+struct PhaseSamples {
+    std::mutex mutex;
+    float recent[recentCapacity];
+    size_t next = 0;       // ring position of the next sample
+    size_t count = 0;      // every sample since the start
+    double total = 0.0;
+    double max = 0.0;
+    uint64_t buckets[bucketCount] = {};
+};
+
+PhaseSamples phaseSamples[(int)Phase::Count];
+
+const char* phaseNames[(int)Phase::Count] = {
+    "step", "forces", "integrate", "conserved",
+    "frame", "input", "snapshot", "grid", "grid_upload", "bodies", "trails", "submit", "hud", "capture", "swap",
+    "gpu_grid", "gpu_bodies", "gpu_trails", "gpu_hud",
+};
+
+PhaseStats Summarize(std::vector<float>& ms) {
+    PhaseStats stats;
+    stats.count = ms.size();
+    if (ms.empty()) return stats;
+    for (float sample : ms) {
+        stats.total += sample;
+        stats.max = std::max(stats.max, (double)sample);
+    }
+    stats.mean = stats.total / ms.size();
+    auto percentile = [&](double fraction) {
+        auto nth = ms.begin() + (size_t)(fraction * (ms.size() - 1));
+        std::nth_element(ms.begin(), nth, ms.end());
+        return (double)*nth;
+    };
+    stats.p50 = percentile(0.50);
+    stats.p99 = percentile(0.99);
+    return stats;
+}
+
+}
+
+const char* PhaseName(Phase phase) {
+    return phaseNames[(int)phase];
+}
+
+void ProfileRecord(Phase phase, double seconds) {
+    PhaseSamples& samples = phaseSamples[(int)phase];
+    const float ms = (float)(seconds * 1000.0);
+    std::lock_guard<std::mutex> lock(samples.mutex);
+    samples.recent[samples.next] = ms;
+    samples.next = (samples.next + 1) % recentCapacity;
+    samples.count++;
+    samples.total += ms;
+    samples.max = std::max(samples.max, (double)ms);
+    samples.buckets[BucketOf(ms)]++;
+}
+
+PhaseStats ProfileRecent(Phase phase, size_t count) {
+    PhaseSamples& samples = phaseSamples[(int)phase];
+    std::vector<float> recent;
+    {
+        std::lock_guard<std::mutex> lock(samples.mutex);
+        count = std::min(std::min(count, samples.count), recentCapacity);
+        recent.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            recent.push_back(samples.recent[(samples.next + recentCapacity - count + i) % recentCapacity]);
+        }
+    }
+    return Summarize(recent);
+}
+
+PhaseStats ProfileTotal(Phase phase) {
+    PhaseSamples& samples = phaseSamples[(int)phase];
+    std::lock_guard<std::mutex> lock(samples.mutex);
+    PhaseStats stats;
+    stats.count = samples.count;
+    if (samples.count == 0) return stats;
+    stats.total = samples.total;
+    stats.max = samples.max;
+    stats.mean = samples.total / samples.count;
+    // The bucket holding the same rank Summarize picks, capped at the largest sample
+    auto percentile = [&](double fraction) {
+        const uint64_t rank = (uint64_t)(fraction * (samples.count - 1));
+        uint64_t seen = 0;
+        for (int bucket = 0; bucket < bucketCount; ++bucket) {
+            seen += samples.buckets[bucket];
+            if (seen > rank) return bucket == 0 ? 0.0 : std::min(BucketValue(bucket), samples.max);
+        }
+        return samples.max;
+    };
+    stats.p50 = percentile(0.50);
+    stats.p99 = percentile(0.99);
+    return stats;
+}
+
+bool WriteProfileCsv(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+    std::fprintf(file, "phase,count,mean_ms,p50_ms,p99_ms,max_ms,total_ms\n");
+    for (int i = 0; i < (int)Phase::Count; ++i) {
+        PhaseStats stats = ProfileTotal((Phase)i);
+        if (stats.count == 0) continue;
+        std::fprintf(file, "%s,%zu,%.6f,%.6f,%.6f,%.6f,%.3f\n", phaseNames[i], stats.count,
+                     stats.mean, stats.p50, stats.p99, stats.max, stats.total);
+    }
+    return std::fclose(file) == 0;
+}
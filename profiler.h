@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <string>
+
+#include "trace.h"
+
+// Per-phase CPU timings. Build with -DGRAVITY_PROFILE=0 and PhaseTimer only records its trace
+// span, so the instrumentation costs one relaxed load while tracing is off.
+#ifndef GRAVITY_PROFILE
+#define GRAVITY_PROFILE 1
+#endif
+
+enum class Phase : int {
+    // simulation (whichever thread steps it)
+    Step,
+    Forces,      // pairwise gravity and collisions
+    Integrate,   // velocities and positions
+    Conserved,   // energy, momentum, angular momentum and center of mass sums
+    // render thread
+    Frame,       // the whole loop iteration
+    Input,
+    Snapshot,    // pick up / step to / interpolate the state to draw, sample trails
+    Grid,        // CreateGridVertices
+    GridUpload,
+    Bodies,      // cull and upload body instances
+    Trails,      // collect, cull, sort and upload trail spheres
+    Submit,      // RenderQueue::Flush
+    Hud,
+    Capture,
+    Swap,        // swap buffers (includes waiting for vsync) and poll events
+    // GPU time of the draws (GL_TIME_ELAPSED, reported two frames late)
+    GpuGrid,
+    GpuBodies,
+    GpuTrails,
+    GpuHud,
+    Count
+};
+
+const char* PhaseName(Phase phase);
+
+// Milliseconds
+struct PhaseStats {
+    size_t count = 0;
+    double mean = 0.0, p50 = 0.0, p99 = 0.0, max = 0.0, total = 0.0;
+};
+
+// Thread-safe, fixed memory: every phase keeps its newest 1024 samples for the overlay and
+// streaming totals (count, sum, max, a log-bucket histogram) for the end-of-run summary
+void ProfileRecord(Phase phase, double seconds);
+PhaseStats ProfileRecent(Phase phase, size_t samples = 240); // the last `samples` samples (at most 1024)
+PhaseStats ProfileTotal(Phase phase); // percentiles from the histogram, within about 2%
+bool WriteProfileCsv(const std::string& path);
+
+#if GRAVITY_PROFILE
+// Records the time from construction to Stop() (or destruction) under `phase`,
+// and the span itself when tracing is on
+class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase) : phase(phase), start(std::chrono::steady_clock::now()) {}
+        ~PhaseTimer() { Stop(); }
+        void Stop() {
+            if (!running) return;
+            running = false;
+            auto end = std::chrono::steady_clock::now();
+            ProfileRecord(phase, std::chrono::duration<double>(end - start).count());
+            if (TraceEnabled()) TraceSpan(PhaseName(phase), start, end);
+        }
+
+    private:
+        Phase phase;
+        std::chrono::steady_clock::time_point start;
+        bool running = true;
+};
+#else
+class PhaseTimer {
+    public:
+        explicit PhaseTimer(Phase phase) : trace(PhaseName(phase)) {}
+        void Stop() { trace.Stop(); }
+
+    private:
+        TraceScope trace;
+};
+#endif
@@ -0,0 +1,86 @@
+#include "render_queue.h"
+
+#include <algorithm>
+
+#include "gpu_timer.h"
+
+void RenderQueue::Clear() {
+    items.clear();
+}
+
+void RenderQueue::Submit(const DrawItem& item) {
+    items.push_back(item);
+}
+
+void RenderQueue::Flush() {
+    stats = RenderStats();
+
+    // key: [blend:1][program:23][VAO:32][unused:8]
+    order.clear();
+    order.reserve(items.size());
+    for (uint32_t i = 0; i < items.size(); ++i) {
+        const DrawItem& item = items[i];
+        uint64_t programId = item.program ? item.program->id : 0;
+        uint64_t key = ((uint64_t)item.blend << 63)
+                     | ((programId & 0x7FFFFF) << 40)
+                     | ((uint64_t)item.VAO << 8);
+        order.push_back({key, i});
+    }
+    std::sort(order.begin(), order.end(), [](const SortEntry& a, const SortEntry& b) {
+        if (a.key != b.key) return a.key < b.key;
+        return a.index < b.index;
+    });
+
+    // The state left behind by code outside the queue is unknown, so the first item sets everything
+    const ShaderProgram* currentProgram = nullptr;
+    GLuint currentVAO = 0;
+    bool vaoBound = false;
+    int blendEnabled = -1;
+    bool colorSet = false;
+    glm::vec4 currentColor;
+
+    for (const SortEntry& entry : order) {
+        const DrawItem& item = items[entry.index];
+
+        if (item.program != currentProgram) {
+            item.program->Use();
+            currentProgram = item.program;
+            colorSet = false; // uniforms are per program
+            stats.programChanges++;
+        }
+        if ((int)item.blend != blendEnabled) {
+            if (item.blend) glEnable(GL_BLEND); else glDisable(GL_BLEND);
+            blendEnabled = item.blend;
+            stats.blendChanges++;
+        }
+        if (!vaoBound || item.VAO != currentVAO) {
+            glBindVertexArray(item.VAO);
+            currentVAO = item.VAO;
+            vaoBound = true;
+            stats.vaoChanges++;
+        }
+        if (item.instanceCount == 0) {
+            if (!colorSet || item.color != currentColor) {
+                item.program->SetColor(item.color);
+                currentColor = item.color;
+                colorSet = true;
+                stats.uniformUploads++;
+            }
+            item.program->SetModel(item.model);
+            stats.uniformUploads++;
+        }
+
+        bool timed = gpuTimers && item.gpuPhase != Phase::Count;
+        if (timed) gpuTimers->Begin(item.gpuPhase);
+        if (item.instanceCount > 0) {
+            glDrawArraysInstanced(item.mode, item.first, item.count, item.instanceCount);
+        } else {
+            glDrawArrays(item.mode, item.first, item.count);
+        }
+        if (timed) gpuTimers->End();
+        stats.drawCalls++;
+    }
+
+    glBindVertexArray(0);
+    glEnable(GL_BLEND); // StartGLU leaves blending on for everything else
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+#include "profiler.h"
+#include "shader_program.h"
+
+class GpuTimers;
+
+// One glDrawArrays call plus the state it needs
+struct DrawItem {
+    const ShaderProgram* program = nullptr;
+    GLuint VAO = 0;
+    GLenum mode = GL_TRIANGLES;
+    GLint first = 0;
+    GLsizei count = 0;
+    GLsizei instanceCount = 0; // > 0: glDrawArraysInstanced, per-instance data replaces model/color
+    bool blend = false;     // translucent items are drawn after all opaque ones, in submit order per program/VAO
+    glm::mat4 model = glm::mat4(1.0f);
+    glm::vec4 color = glm::vec4(1.0f);
+    Phase gpuPhase = Phase::Count; // GPU time of this draw is reported under this phase (Count: not timed)
+};
+
+// Counters for one Flush()
+struct RenderStats {
+    int drawCalls = 0;
+    int programChanges = 0;
+    int vaoChanges = 0;
+    int blendChanges = 0;
+    int uniformUploads = 0;
+
+    int StateChanges() const { return programChanges + vaoChanges + blendChanges; }
+};
+
+// Collects the frame's draws, sorts them by blend state, program and VAO, and
+// submits them while skipping any state (and color uniform) that is already set.
+// Equal keys keep their submit order; translucent instances are sorted by the caller.
+class RenderQueue {
+    public:
+        RenderStats stats; // filled by the last Flush()
+        GpuTimers* gpuTimers = nullptr; // times the items that have a gpuPhase
+
+        void Clear();
+        void Submit(const DrawItem& item);
+        void Flush();
+        size_t Size() const { return items.size(); }
+
+    private:
+        struct SortEntry {
+            uint64_t key;
+            uint32_t index;
+        };
+        std::vector<DrawItem> items;
+        std::vector<SortEntry> order;
+};
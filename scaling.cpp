@@ -0,0 +1,304 @@
+// Scaling driver: steps the simulation headlessly over a matrix of scenes, force backends,
+// body counts and thread counts and writes one CSV row per configuration. Every configuration
+// runs in its own child process so peak RSS is per configuration and a crash or OOM only loses that row.
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "simulation.h"
+#include "scenes.h"
+#include "thread_pool.h"
+
+struct ScalingOptions {
+    std::vector<size_t> bodies = {10, 100, 1000, 10000, 100000, 1000000, 10000000};
+    std::vector<size_t> threads;   // default: 1, 2, 4, ... up to the hardware threads
+    std::vector<ForceBackend> backends = {ForceBackend::Direct, ForceBackend::BarnesHut};
+    std::vector<std::string> scenes = {"earth-moon", "cube"};
+    bool weak = false;             // bodies are per thread (N = bodies * threads)
+    int minSteps = 3;
+    double minTime = 0.5;          // seconds of stepping per configuration
+    double budget = 30.0;          // skip configurations estimated to take longer than this
+    float theta = 0.5f;
+    std::string output = "scaling.csv";
+};
+
+struct ScalingResult {
+    uint64_t steps = 0;
+    double seconds = 0.0;
+    uint64_t interactions = 0;
+    double peakRssMb = 0.0;
+};
+
+static double Now() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Earth-Moon: the built-in pair plus light bodies orbiting the Earth; cube: bodies at rest in a cube
+static bool BuildScene(const std::string& scene, size_t count, Simulation& simulation, ThreadPool* pool) {
+    if (scene == "earth-moon") {
+        if (count < 2) return false;
+        AddEarthMoon(simulation);
+        AddOrbitingRing(simulation, 1, count - 2, 500.0f, 8000.0f, 1e15f, 42, pool);
+        return true;
+    }
+    if (scene == "cube") {
+        AddUniformCube(simulation, count, 5000.0f, 7.34767309e22f, 42, pool);
+        return true;
+    }
+    return false;
+}
+
+static double PeakRssMb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / (1024.0 * 1024.0); // bytes
+#else
+    return usage.ru_maxrss / 1024.0;            // kilobytes
+#endif
+}
+
+// Runs in the child: build, one warm-up step, then step until both minSteps and minTime are reached
+static ScalingResult RunConfiguration(const ScalingOptions& options, const std::string& scene, ForceBackend backend,
+                                      size_t count, size_t threads) {
+    ScalingResult result;
+    Simulation simulation;
+    ThreadPool pool(threads);
+    if (!BuildScene(scene, count, simulation, &pool)) return result;
+    simulation.pool = &pool;
+    simulation.params.backend = backend;
+    simulation.params.theta = options.theta;
+    simulation.Step();
+
+    uint64_t before = simulation.totalInteractions;
+    double start = Now();
+    do {
+        simulation.Step();
+        result.steps++;
+        result.seconds = Now() - start;
+    } while (result.steps < (uint64_t)options.minSteps || result.seconds < options.minTime);
+    result.interactions = simulation.totalInteractions - before;
+    result.peakRssMb = PeakRssMb();
+    return result;
+}
+
+static bool RunInChild(const ScalingOptions& options, const std::string& scene, ForceBackend backend,
+                       size_t count, size_t threads, ScalingResult& result) {
+    int fds[2];
+    if (pipe(fds) != 0) return false;
+    fflush(nullptr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return false;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        ScalingResult childResult = RunConfiguration(options, scene, backend, count, threads);
+        ssize_t written = write(fds[1], &childResult, sizeof(childResult));
+        _exit(written == (ssize_t)sizeof(childResult) ? 0 : 1);
+    }
+    close(fds[1]);
+    ssize_t got = read(fds[0], &result, sizeof(result));
+    close(fds[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    return got == (ssize_t)sizeof(result) && WIFEXITED(status) && WEXITSTATUS(status) == 0 && result.steps > 0;
+}
+
+// Work per step relative to another body count, for skipping configurations that would blow the budget
+static double CostRatio(ForceBackend backend, size_t count, size_t measured) {
+    double n = (double)count, m = (double)measured;
+    if (backend == ForceBackend::Direct) return (n * n) / (m * m);
+    return (n * std::log2(n + 1.0)) / (m * std::log2(m + 1.0));
+}
+
+static bool ParseSizes(const char* text, std::vector<size_t>& values) {
+    values.clear();
+    while (*text) {
+        char* end = nullptr;
+        double value = strtod(text, &end); // accepts 1e7
+        if (end == text || value < 1.0 || (*end && *end != ',')) return false;
+        values.push_back((size_t)value);
+        text = *end ? end + 1 : end;
+    }
+    return !values.empty();
+}
+
+static bool ParseNames(const char* text, std::vector<std::string>& values) {
+    values.clear();
+    std::string list = text;
+    size_t start = 0;
+    while (start <= list.size()) {
+        size_t comma = list.find(',', start);
+        if (comma == std::string::npos) comma = list.size();
+        if (comma == start) return false;
+        values.push_back(list.substr(start, comma - start));
+        start = comma + 1;
+    }
+    return !values.empty();
+}
+
+static void PrintScalingUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --bodies N,N,...    body counts (default 10,100,...,1e7); per thread with --weak\n"
+            "  --threads N,N,...   thread counts (default 1,2,4,... up to the hardware threads)\n"
+            "  --backends LIST     direct,barnes-hut (default both)\n"
+            "  --scenes LIST       earth-moon,cube (default both)\n"
+            "  --weak              weak scaling: N = bodies * threads\n"
+            "  --steps N           minimum timed steps per configuration (default 3)\n"
+            "  --min-time S        minimum timed seconds per configuration (default 0.5)\n"
+            "  --budget S          skip configurations estimated to take longer (default 30)\n"
+            "  --theta X           Barnes-Hut opening angle (default 0.5)\n"
+            "  --output PATH       CSV file (default scaling.csv, - for stdout)\n",
+            program);
+}
+
+static bool ParseScalingOptions(int argc, char** argv, ScalingOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        std::vector<std::string> names;
+        if (strcmp(arg, "--weak") == 0) {
+            options.weak = true;
+        } else if (value && strcmp(arg, "--bodies") == 0 && ParseSizes(value, options.bodies)) {
+            ++i;
+        } else if (value && strcmp(arg, "--threads") == 0 && ParseSizes(value, options.threads)) {
+            ++i;
+        } else if (value && strcmp(arg, "--backends") == 0 && ParseNames(value, names)) {
+            options.backends.clear();
+            for (const std::string& name : names) {
+                ForceBackend backend;
+                if (!ParseForceBackend(name.c_str(), backend)) {
+                    fprintf(stderr, "Unknown backend: %s\n", name.c_str());
+                    return false;
+                }
+                options.backends.push_back(backend);
+            }
+            ++i;
+        } else if (value && strcmp(arg, "--scenes") == 0 && ParseNames(value, names)) {
+            for (const std::string& name : names) {
+                if (name != "earth-moon" && name != "cube") {
+                    fprintf(stderr, "Unknown scene: %s\n", name.c_str());
+                    return false;
+                }
+            }
+            options.scenes = names;
+            ++i;
+        } else if (value && strcmp(arg, "--steps") == 0 && atoi(value) > 0) {
+            options.minSteps = atoi(value);
+            ++i;
+        } else if (value && strcmp(arg, "--min-time") == 0 && atof(value) >= 0.0) {
+            options.minTime = atof(value);
+            ++i;
+        } else if (value && strcmp(arg, "--budget") == 0 && atof(value) > 0.0) {
+            options.budget = atof(value);
+            ++i;
+        } else if (value && strcmp(arg, "--theta") == 0 && atof(value) > 0.0) {
+            options.theta = (float)atof(value);
+            ++i;
+        } else if (value && strcmp(arg, "--output") == 0) {
+            options.output = value;
+            ++i;
+        } else {
+            fprintf(stderr, "Bad option: %s\n", arg);
+            return false;
+        }
+    }
+    if (options.threads.empty()) {
+        size_t hardware = std::thread::hardware_concurrency();
+        for (size_t threads = 1; threads < hardware; threads *= 2) options.threads.push_back(threads);
+        options.threads.push_back(hardware > 0 ? hardware : 1);
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ScalingOptions options;
+    if (argc > 1 && (strcmp(argv[1], "-h") == 0 || strcmp(argv[1], "--help") == 0)) {
+        PrintScalingUsage(argv[0]);
+        return 0;
+    }
+    if (!ParseScalingOptions(argc, argv, options)) {
+        PrintScalingUsage(argv[0]);
+        return 1;
+    }
+
+    FILE* csv = options.output == "-" ? stdout : fopen(options.output.c_str(), "w");
+    if (!csv) {
+        fprintf(stderr, "Could not open %s\n", options.output.c_str());
+        return 1;
+    }
+    fprintf(csv, "mode,scene,backend,bodies,threads,steps,seconds,steps_per_s,ns_per_interaction,"
+                 "interactions_per_step,peak_rss_mb,efficiency\n");
+    fflush(csv);
+
+    // Throughput of the fewest threads for each (scene, backend, bodies-or-bodies-per-thread): the efficiency baseline
+    std::map<std::tuple<std::string, ForceBackend, size_t>, std::pair<size_t, double>> baselines;
+    // Largest measured configuration per (scene, backend, threads): seconds per step at that body count
+    std::map<std::tuple<std::string, ForceBackend, size_t>, std::pair<size_t, double>> measured;
+
+    for (const std::string& scene : options.scenes) {
+        for (ForceBackend backend : options.backends) {
+            for (size_t bodies : options.bodies) {
+                for (size_t threads : options.threads) {
+                    size_t count = options.weak ? bodies * threads : bodies;
+                    if (scene == "earth-moon" && count < 2) continue;
+
+                    auto measuredKey = std::make_tuple(scene, backend, threads);
+                    auto previous = measured.find(measuredKey);
+                    if (previous != measured.end()) {
+                        double estimate = previous->second.second * CostRatio(backend, count, previous->second.first) *
+                                          (options.minSteps + 1);
+                        if (estimate > options.budget) {
+                            fprintf(stderr, "skip %s %s n=%zu threads=%zu: ~%.0f s estimated\n", scene.c_str(),
+                                    ForceBackendName(backend), count, threads, estimate);
+                            continue;
+                        }
+                    }
+
+                    ScalingResult result;
+                    if (!RunInChild(options, scene, backend, count, threads, result)) {
+                        fprintf(stderr, "failed %s %s n=%zu threads=%zu\n", scene.c_str(),
+                                ForceBackendName(backend), count, threads);
+                        continue;
+                    }
+                    double stepSeconds = result.seconds / result.steps;
+                    measured[measuredKey] = {count, stepSeconds};
+
+                    double throughput = result.interactions / result.seconds;
+                    auto baselineKey = std::make_tuple(scene, backend, bodies);
+                    auto baseline = baselines.find(baselineKey);
+                    if (baseline == baselines.end()) {
+                        baseline = baselines.emplace(baselineKey, std::make_pair(threads, throughput)).first;
+                    }
+                    double efficiency = (throughput / baseline->second.second) /
+                                        ((double)threads / baseline->second.first);
+
+                    fprintf(csv, "%s,%s,%s,%zu,%zu,%llu,%.6f,%.3f,%.4f,%.0f,%.1f,%.3f\n",
+                            options.weak ? "weak" : "strong", scene.c_str(), ForceBackendName(backend), count, threads,
+                            (unsigned long long)result.steps, result.seconds, result.steps / result.seconds,
+                            result.interactions > 0 ? result.seconds * 1e9 / result.interactions : 0.0,
+                            (double)result.interactions / result.steps, result.peakRssMb, efficiency);
+                    fflush(csv);
+                    fprintf(stderr, "%s %s n=%zu threads=%zu: %.2f steps/s, efficiency %.2f\n", scene.c_str(),
+                            ForceBackendName(backend), count, threads, result.steps / result.seconds, efficiency);
+                }
+            }
+        }
+    }
+    if (csv != stdout) fclose(csv);
+    return 0;
+}
@@ -0,0 +1,312 @@
+#include "scene_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include "checkpoint.h"
+#include "thread_pool.h"
+
+namespace {
+
+const float defaultDensity = 3344.0f;
+const uint32_t defaultColor = 0xFFCCCCCC; // PackColor(0.8, 0.8, 0.8, 1)
+const uint8_t sceneFlagMask = BodyTrail; // the rest describe a mouse interaction in progress
+
+// The per-body rule of both formats
+bool ValidBody(float mass, float density) {
+    return mass > 0.0f && density > 0.0f; // false for NaN as well
+}
+
+bool SetError(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+size_t AlignUp(size_t offset) {
+    return (offset + sceneAlignment - 1) / sceneAlignment * sceneAlignment;
+}
+
+void ForEachChunk(ThreadPool* pool, size_t count, size_t grain, const std::function<void(size_t, size_t, size_t)>& fn) {
+    if (pool) {
+        pool->ParallelFor(0, count, grain, fn);
+    } else if (count > 0) {
+        fn(0, count, 0);
+    }
+}
+
+// Skips spaces and tabs (not newlines, so a short line cannot run into the next one)
+const char* SkipBlanks(const char* p) {
+    while (*p == ' ' || *p == '\t' || *p == '\r') ++p;
+    return p;
+}
+
+bool EndOfLine(const char* p) {
+    return *p == '\n' || *p == '#' || *p == '\0';
+}
+
+const char* NextLine(const char* p, const char* end) {
+    const char* newline = (const char*)std::memchr(p, '\n', end - p);
+    return newline ? newline + 1 : end;
+}
+
+// Parses "x y z vx vy vz mass [density [color [trail]]]" into body `index`; false on a malformed line
+bool ParseBody(const char* p, BodyStore& bodies, size_t index) {
+    float values[8];
+    int count = 0;
+    char* end;
+    for (; count < 8; ++count) {
+        p = SkipBlanks(p);
+        if (EndOfLine(p)) break;
+        values[count] = std::strtof(p, &end);
+        if (end == p) break;
+        p = end;
+    }
+    if (count < 7) return false;
+    float density = count > 7 ? values[7] : defaultDensity;
+    if (!ValidBody(values[6], density)) return false;
+
+    uint32_t color = defaultColor;
+    uint8_t flags = 0;
+    p = SkipBlanks(p);
+    if (count == 8 && !EndOfLine(p) && std::strncmp(p, "trail", 5) != 0) {
+        unsigned long hex = std::strtoul(p, &end, 16);
+        long digits = end - p;
+        if (digits != 6 && digits != 8) return false;
+        if (digits == 6) hex = (hex << 8) | 0xFF;
+        // RRGGBBAA to RGBA8 with red in the low byte
+        color = (uint32_t)((hex >> 24) & 0xFF) | (uint32_t)((hex >> 16) & 0xFF) << 8 |
+                (uint32_t)((hex >> 8) & 0xFF) << 16 | (uint32_t)(hex & 0xFF) << 24;
+        p = SkipBlanks(end);
+    }
+    if (std::strncmp(p, "trail", 5) == 0) {
+        flags |= BodyTrail;
+        p = SkipBlanks(p + 5);
+    }
+    if (!EndOfLine(p)) return false;
+
+    bodies.x[index] = values[0];
+    bodies.y[index] = values[1];
+    bodies.z[index] = values[2];
+    bodies.vx[index] = values[3];
+    bodies.vy[index] = values[4];
+    bodies.vz[index] = values[5];
+    bodies.mass[index] = values[6];
+    bodies.density[index] = density;
+    bodies.radius[index] = BodyRadius(values[6], density);
+    bodies.color[index] = color;
+    bodies.flags[index] = flags;
+    return true;
+}
+
+bool LoadTextScene(const std::string& path, const std::vector<char>& text, Simulation& simulation, ThreadPool* pool,
+                   std::string* error) {
+    const char* begin = text.data();
+    const char* end = begin + text.size() - 1; // without the terminating zero
+
+    // Pieces of whole lines, counted in one parallel pass and parsed into place in a second
+    const size_t pieces = pool ? pool->Size() * 8 : 1;
+    std::vector<const char*> starts(pieces + 1, end);
+    starts[0] = begin;
+    for (size_t k = 1; k < pieces; ++k) {
+        const char* guess = begin + (end - begin) * k / pieces;
+        starts[k] = std::max(starts[k - 1], guess == begin ? begin : NextLine(guess - 1, end));
+    }
+    std::vector<size_t> bodyCount(pieces + 1, 0), lineCount(pieces + 1, 0);
+    ForEachChunk(pool, pieces, 1, [&](size_t first, size_t last, size_t) {
+        for (size_t k = first; k < last; ++k) {
+            for (const char* line = starts[k]; line < starts[k + 1]; line = NextLine(line, end)) {
+                if (!EndOfLine(SkipBlanks(line))) bodyCount[k]++;
+                lineCount[k]++;
+            }
+        }
+    });
+
+    // Prefix sums: where each piece's bodies go and the file line its first line is
+    std::vector<size_t> firstBody(pieces + 1), firstLine(pieces + 1);
+    BodyStore& bodies = simulation.bodies;
+    size_t body = bodies.Size(), lineNumber = 1;
+    for (size_t k = 0; k <= pieces; ++k) {
+        firstBody[k] = body;
+        firstLine[k] = lineNumber;
+        body += bodyCount[k];
+        lineNumber += lineCount[k];
+    }
+    const size_t firstIndex = bodies.Size();
+    const size_t count = body - firstIndex;
+    const uint32_t firstId = simulation.NextId();
+    bodies.Resize(firstIndex + count);
+
+    std::vector<size_t> badLine(pieces, 0);
+    ForEachChunk(pool, pieces, 1, [&](size_t first, size_t last, size_t) {
+        for (size_t k = first; k < last; ++k) {
+            size_t index = firstBody[k], line = firstLine[k];
+            for (const char* p = starts[k]; p < starts[k + 1]; p = NextLine(p, end), ++line) {
+                if (EndOfLine(SkipBlanks(p))) continue;
+                if (!ParseBody(p, bodies, index)) {
+                    badLine[k] = line;
+                    break;
+                }
+                bodies.id[index] = firstId + (uint32_t)(index - firstIndex);
+                ++index;
+            }
+        }
+    });
+    for (size_t k = 0; k < pieces; ++k) {
+        if (badLine[k] != 0) {
+            bodies.Resize(firstIndex);
+            return SetError(error, path + ":" + std::to_string(badLine[k]) +
+                                   ": expected x y z vx vy vz mass [density [color [trail]]] with positive mass and density");
+        }
+    }
+    simulation.SetNextId(firstId + (uint32_t)count);
+    simulation.Invalidate();
+    return true;
+}
+
+bool LoadBinaryScene(const std::string& path, const uint8_t* data, size_t size, Simulation& simulation,
+                     ThreadPool* pool, std::string* error) {
+    SceneHeader header;
+    std::memcpy(&header, data, sizeof(header));
+    if (header.byteOrder != checkpointByteOrder) {
+        return SetError(error, path + " was written on a machine of the other byte order");
+    }
+    if (header.version < 1 || header.version > sceneVersion || header.headerSize < sizeof(SceneHeader) ||
+        (header.version < 2 && (header.arrays & SceneFlags))) {
+        return SetError(error, path + " has scene version " + std::to_string(header.version) + ", expected " +
+                               std::to_string(sceneVersion));
+    }
+
+    // Offsets of x y z vx vy vz mass [density] (4-byte floats), [color] (4 bytes), [flags] (1 byte)
+    const size_t count = header.bodyCount;
+    const float* arrays[8] = {};
+    const uint32_t* colors = nullptr;
+    const uint8_t* flags = nullptr;
+    size_t offset = AlignUp(header.headerSize);
+    const int floatCount = 7 + ((header.arrays & SceneDensity) ? 1 : 0);
+    const int arrayCount = floatCount + ((header.arrays & SceneColor) ? 1 : 0) + ((header.arrays & SceneFlags) ? 1 : 0);
+    for (int a = 0; a < arrayCount; ++a) {
+        const bool isFlags = a == arrayCount - 1 && (header.arrays & SceneFlags);
+        const size_t elementSize = isFlags ? 1 : 4;
+        if (count > (size - std::min(offset, size)) / elementSize) {
+            return SetError(error, path + " is truncated");
+        }
+        if (isFlags) {
+            flags = data + offset;
+        } else if (a == floatCount) {
+            colors = (const uint32_t*)(data + offset);
+        } else {
+            arrays[a] = (const float*)(data + offset);
+        }
+        offset = AlignUp(offset + count * elementSize);
+    }
+
+    BodyStore& bodies = simulation.bodies;
+    const size_t firstIndex = bodies.Size();
+    const uint32_t firstId = simulation.NextId();
+    bodies.Resize(firstIndex + count);
+    std::vector<float>* destinations[7] = {&bodies.x, &bodies.y, &bodies.z, &bodies.vx, &bodies.vy, &bodies.vz, &bodies.mass};
+    // Each chunk faults in its own pages of the mapping, so the copy runs as fast as the disk delivers
+    const size_t grain = 1 << 16;
+    std::vector<size_t> badBody((count + grain - 1) / grain, SIZE_MAX); // first invalid body of each chunk
+    ForEachChunk(pool, count, grain, [&](size_t begin, size_t end, size_t) {
+        const size_t n = end - begin;
+        for (int a = 0; a < 7; ++a) {
+            std::memcpy(destinations[a]->data() + firstIndex + begin, arrays[a] + begin, n * sizeof(float));
+        }
+        for (size_t i = begin; i < end; ++i) {
+            const size_t index = firstIndex + i;
+            const float density = arrays[7] ? arrays[7][i] : defaultDensity;
+            if (!ValidBody(bodies.mass[index], density) && badBody[begin / grain] == SIZE_MAX) {
+                badBody[begin / grain] = i;
+            }
+            bodies.density[index] = density;
+            bodies.radius[index] = BodyRadius(bodies.mass[index], density);
+            bodies.color[index] = colors ? colors[i] : defaultColor;
+            bodies.id[index] = firstId + (uint32_t)i;
+            bodies.flags[index] = flags ? flags[i] & sceneFlagMask : 0;
+        }
+    });
+    for (size_t bad : badBody) {
+        if (bad != SIZE_MAX) {
+            bodies.Resize(firstIndex);
+            return SetError(error, path + ": body " + std::to_string(bad) + " needs a positive mass and density");
+        }
+    }
+    simulation.SetNextId(firstId + (uint32_t)count);
+    simulation.Invalidate();
+    return true;
+}
+
+}
+
+bool LoadScene(const std::string& path, Simulation& simulation, ThreadPool* pool, std::string* error) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return SetError(error, "cannot open " + path);
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        close(fd);
+        return SetError(error, "cannot read " + path);
+    }
+    const size_t size = (size_t)info.st_size;
+    char magic[sizeof(sceneMagic)] = {};
+    bool binary = size >= sizeof(SceneHeader) && pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic) &&
+                  std::memcmp(magic, sceneMagic, sizeof(magic)) == 0;
+
+    if (binary) {
+        void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapping == MAP_FAILED) return SetError(error, "cannot map " + path);
+        madvise(mapping, size, MADV_WILLNEED);
+        bool ok = LoadBinaryScene(path, (const uint8_t*)mapping, size, simulation, pool, error);
+        munmap(mapping, size);
+        return ok;
+    }
+
+    // Text: read whole, with a terminating zero so strtof always stops inside the buffer
+    std::vector<char> text(size + 1, '\0');
+    size_t done = 0;
+    while (done < size) {
+        ssize_t got = read(fd, text.data() + done, size - done);
+        if (got <= 0) break;
+        done += (size_t)got;
+    }
+    close(fd);
+    if (done != size) return SetError(error, "cannot read " + path);
+    return LoadTextScene(path, text, simulation, pool, error);
+}
+
+bool WriteBinaryScene(const std::string& path, const BodyStore& bodies) {
+    FILE* file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+    SceneHeader header = {};
+    std::memcpy(header.magic, sceneMagic, sizeof(header.magic));
+    header.version = sceneVersion;
+    header.byteOrder = checkpointByteOrder;
+    header.headerSize = sizeof(SceneHeader);
+    header.arrays = SceneDensity | SceneColor | SceneFlags;
+    header.bodyCount = bodies.Size();
+
+    const char padding[sceneAlignment] = {};
+    bool ok = std::fwrite(&header, sizeof(header), 1, file) == 1;
+    size_t written = sizeof(header);
+    std::vector<uint8_t> flags(bodies.flags);
+    for (uint8_t& flag : flags) flag &= sceneFlagMask;
+    const void* arrays[10] = {bodies.x.data(), bodies.y.data(), bodies.z.data(), bodies.vx.data(), bodies.vy.data(),
+                              bodies.vz.data(), bodies.mass.data(), bodies.density.data(), bodies.color.data(), flags.data()};
+    for (int a = 0; a < 10; ++a) {
+        size_t pad = AlignUp(written) - written;
+        size_t bytes = bodies.Size() * (a == 9 ? 1 : 4);
+        ok = ok && (pad == 0 || std::fwrite(padding, 1, pad, file) == pad) &&
+             (bytes == 0 || std::fwrite(arrays[a], 1, bytes, file) == bytes);
+        written += pad + bytes;
+    }
+    ok = std::fclose(file) == 0 && ok;
+    return ok;
+}
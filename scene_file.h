@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "simulation.h"
+
+class ThreadPool;
+
+// Scene files: initial conditions loaded at startup instead of the built-in Earth-Moon pair.
+//
+// Text, for small hand-written scenes: one body per line, '#' starts a comment,
+//   x y z vx vy vz mass [density [color [trail]]]
+// with positions and velocities in the units of Simulation::AddBody, mass in kg, density in kg/m^3
+// (default 3344), color as RRGGBB or RRGGBBAA hex (default light grey) and "trail" to draw one.
+//
+// Binary, for millions of bodies: a header and arrays, each starting on a 64-byte boundary,
+// in native (little-endian) byte order; simple enough for any generator to write with fwrite.
+//
+//   SceneHeader | pad | x[n] | pad | y[n] | z | vx | vy | vz | mass | [density[n]] | [color[n] (uint32 RGBA8)]
+//               | [flags[n] (uint8 BodyFlags, version 2)]
+//
+// Both formats are held to the same rule: every mass and density must be positive.
+const char sceneMagic[8] = {'G', 'R', 'A', 'V', 'S', 'C', 'N', '1'};
+const uint32_t sceneVersion = 2; // version 1 files (without flags) still load
+const size_t sceneAlignment = 64;
+
+enum SceneArrays : uint32_t {
+    SceneDensity = 1 << 0, // density array present (otherwise 3344)
+    SceneColor   = 1 << 1, // color array present (otherwise light grey)
+    SceneFlags   = 1 << 2, // flags array present (otherwise none); only BodyTrail is kept
+};
+
+struct SceneHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;  // checkpointByteOrder convention: 0x01020304
+    uint32_t headerSize; // sizeof(SceneHeader) of the writer
+    uint32_t arrays;     // SceneArrays
+    uint64_t bodyCount;
+};
+
+// Appends the bodies of a text or binary scene (told apart by the magic) to the simulation, with new ids.
+// Both formats are parsed in parallel on the pool (nullptr: on the calling thread) straight into the body store.
+bool LoadScene(const std::string& path, Simulation& simulation, ThreadPool* pool, std::string* error = nullptr);
+
+// Writes the bodies' positions, velocities, masses, densities, colors and trail flags as a binary scene
+bool WriteBinaryScene(const std::string& path, const BodyStore& bodies);
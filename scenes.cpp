@@ -0,0 +1,269 @@
+#include "scenes.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "thread_pool.h"
+
+namespace {
+
+const double pi = 3.14159265358979;
+
+// SplitMix64 finalizer: a bijective mix in which every input bit affects every output bit
+uint64_t Mix64(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+// The random numbers of one body: the k-th draw is a hash of (seed, body, k), independent of
+// which thread generates the body and of every other body
+class BodyRandom {
+    public:
+        BodyRandom(uint32_t seed, uint64_t body) : key(Mix64(((uint64_t)seed << 32) ^ Mix64(body))) {}
+
+        // [0, 1)
+        double Uniform() { return (Mix64(key + 0x9E3779B97F4A7C15ull * ++counter) >> 11) * 0x1.0p-53; }
+        // (0, 1], safe to take the log of
+        double Positive() { return 1.0 - Uniform(); }
+        // Standard normal (Box-Muller)
+        double Normal() { return std::sqrt(-2.0 * std::log(Positive())) * std::cos(2.0 * pi * Uniform()); }
+        // A vector of the given length in a uniformly random direction
+        void Direction(double length, double& x, double& y, double& z) {
+            double cosTheta = 2.0 * Uniform() - 1.0;
+            double sinTheta = std::sqrt(1.0 - cosTheta * cosTheta);
+            double phi = 2.0 * pi * Uniform();
+            x = length * sinTheta * std::cos(phi);
+            y = length * cosTheta;
+            z = length * sinTheta * std::sin(phi);
+        }
+
+    private:
+        uint64_t key;
+        uint64_t counter = 0;
+};
+
+struct NewBody {
+    double x, y, z, vx, vy, vz;
+    float mass, density;
+    uint32_t color;
+};
+
+const size_t generatorGrain = 16384;
+
+// Appends `count` bodies, body i being make(i, random of body i), in parallel; returns the index of the first
+template <typename Make>
+size_t AppendBodies(Simulation& simulation, size_t count, uint32_t seed, ThreadPool* pool, const Make& make) {
+    BodyStore& bodies = simulation.bodies;
+    const size_t first = bodies.Size();
+    const uint32_t firstId = simulation.NextId();
+    bodies.Resize(first + count);
+    auto fill = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            BodyRandom random(seed, i);
+            const NewBody body = make(i, random);
+            const size_t index = first + i;
+            bodies.x[index] = (float)body.x;
+            bodies.y[index] = (float)body.y;
+            bodies.z[index] = (float)body.z;
+            bodies.vx[index] = (float)body.vx;
+            bodies.vy[index] = (float)body.vy;
+            bodies.vz[index] = (float)body.vz;
+            bodies.mass[index] = body.mass;
+            bodies.density[index] = body.density;
+            bodies.radius[index] = BodyRadius(body.mass, body.density);
+            bodies.color[index] = body.color;
+            bodies.id[index] = firstId + (uint32_t)i;
+            bodies.flags[index] = 0;
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(0, count, generatorGrain, fill);
+    } else {
+        fill(0, count, 0);
+    }
+    simulation.SetNextId(firstId + (uint32_t)count);
+    simulation.Invalidate();
+    return first;
+}
+
+// Moves bodies [first, end) of equal mass so their center of mass is at the origin and at rest.
+// Per-chunk sums are added in chunk order, so the result does not depend on the thread count.
+void CenterEqualMasses(BodyStore& bodies, size_t first, ThreadPool* pool) {
+    const size_t count = bodies.Size() - first;
+    if (count == 0) return;
+    std::vector<double> partials(6 * ((count + generatorGrain - 1) / generatorGrain), 0.0);
+    auto sum = [&](size_t begin, size_t end, size_t) {
+        double* partial = &partials[6 * (begin / generatorGrain)];
+        for (size_t i = first + begin; i < first + end; ++i) {
+            partial[0] += bodies.x[i]; partial[1] += bodies.y[i]; partial[2] += bodies.z[i];
+            partial[3] += bodies.vx[i]; partial[4] += bodies.vy[i]; partial[5] += bodies.vz[i];
+        }
+    };
+    double mean[6] = {};
+    if (pool) {
+        pool->ParallelFor(0, count, generatorGrain, sum);
+    } else {
+        // The same chunks as the pool would use
+        for (size_t begin = 0; begin < count; begin += generatorGrain) sum(begin, std::min(begin + generatorGrain, count), 0);
+    }
+    for (size_t c = 0; c < partials.size(); ++c) mean[c % 6] += partials[c];
+    for (double& m : mean) m /= count;
+
+    auto shift = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = first + begin; i < first + end; ++i) {
+            bodies.x[i] -= mean[0]; bodies.y[i] -= mean[1]; bodies.z[i] -= mean[2];
+            bodies.vx[i] -= mean[3]; bodies.vy[i] -= mean[4]; bodies.vz[i] -= mean[5];
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(0, count, generatorGrain, shift);
+    } else {
+        shift(0, count, 0);
+    }
+}
+
+}
+
+void AddEarthMoon(Simulation& simulation) {
+    simulation.AddBody(3844, 0, 0, 0, 0, 228, 7.34767309*pow(10, 22), 3344, PackColor(0.8f, 0.8f, 0.8f, 1.0f), BodyTrail);
+    // simulation.AddBody(-250, 0, 0, 0, -50, 0, 7.34767309*pow(10, 22), 3344, PackColor(1.0f, 0.0f, 0.0f, 1.0f));
+    simulation.AddBody(0, 0, 0, 0, 0, 0, 5.97219*pow(10, 24), 5515, PackColor(0.0f, 0.3f, 0.8f, 1.0f));
+}
+
+void AddUniformCube(Simulation& simulation, size_t count, float halfSize, float mass, uint32_t seed, ThreadPool* pool) {
+    const uint32_t color = PackColor(1.0f, 0.0f, 0.0f, 1.0f);
+    AppendBodies(simulation, count, seed, pool, [&](size_t, BodyRandom& random) {
+        double x = halfSize * (2.0 * random.Uniform() - 1.0);
+        double y = halfSize * (2.0 * random.Uniform() - 1.0);
+        double z = halfSize * (2.0 * random.Uniform() - 1.0);
+        return NewBody{x, y, z, 0, 0, 0, mass * (float)(0.5 + random.Uniform()), 3344, color};
+    });
+}
+
+void AddOrbitingRing(Simulation& simulation, size_t center, size_t count, float innerRadius, float outerRadius,
+                     float mass, uint32_t seed, ThreadPool* pool) {
+    const BodyStore& bodies = simulation.bodies;
+    const double cx = bodies.x[center], cy = bodies.y[center], cz = bodies.z[center];
+    const double cvx = bodies.vx[center], cvy = bodies.vy[center], cvz = bodies.vz[center];
+    const double centerMass = bodies.mass[center];
+    const uint32_t color = PackColor(0.6f, 0.5f, 0.4f, 1.0f);
+    AppendBodies(simulation, count, seed, pool, [&](size_t, BodyRandom& random) {
+        double phi = 2.0 * pi * random.Uniform();
+        double r = innerRadius + (outerRadius - innerRadius) * random.Uniform();
+        double speed = std::sqrt(GScene * centerMass / r);
+        return NewBody{cx + r * std::cos(phi), cy, cz + r * std::sin(phi),
+                       cvx - speed * std::sin(phi), cvy, cvz + speed * std::cos(phi), mass, 2000, color};
+    });
+}
+
+void AddPlummer(Simulation& simulation, size_t count, float totalMass, float scaleRadius, uint32_t seed, ThreadPool* pool) {
+    const float mass = totalMass / count;
+    const double velocityScale = std::sqrt(GScene * totalMass / scaleRadius);
+    const uint32_t color = PackColor(1.0f, 0.8f, 0.4f, 1.0f);
+    size_t first = AppendBodies(simulation, count, seed, pool, [&](size_t, BodyRandom& random) {
+        // Radius from the cumulative mass, cut at 10 scale radii
+        double r;
+        do {
+            r = 1.0 / std::sqrt(std::pow(random.Positive(), -2.0 / 3.0) - 1.0);
+        } while (!(r < 10.0));
+        // Speed in units of the escape speed, by rejection from q^2 (1 - q^2)^3.5
+        double q, g;
+        do {
+            q = random.Uniform();
+            g = 0.1 * random.Uniform();
+        } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+        double speed = q * std::sqrt(2.0) * std::pow(1.0 + r * r, -0.25) * velocityScale;
+
+        NewBody body = {0, 0, 0, 0, 0, 0, mass, 3344, color};
+        random.Direction(r * scaleRadius, body.x, body.y, body.z);
+        random.Direction(speed, body.vx, body.vy, body.vz);
+        return body;
+    });
+    CenterEqualMasses(simulation.bodies, first, pool);
+}
+
+void AddHernquist(Simulation& simulation, size_t count, float totalMass, float scaleRadius, uint32_t seed,
+                  ThreadPool* pool) {
+    const float mass = totalMass / count;
+    const double cut = 20.0;
+    const double massInsideCut = (cut / (1.0 + cut)) * (cut / (1.0 + cut));
+    const double potentialScale = GScene * totalMass / scaleRadius; // G M / a
+    const uint32_t color = PackColor(1.0f, 0.6f, 0.5f, 1.0f);
+    size_t first = AppendBodies(simulation, count, seed, pool, [&](size_t, BodyRandom& random) {
+        // M(<r) = M r^2 / (r + a)^2, inverted; x = r / a
+        double s = std::sqrt(massInsideCut * random.Uniform());
+        double x = std::max(s / (1.0 - s), 1e-4);
+        // Isotropic one-dimensional dispersion from the Jeans equation, in units of G M / a
+        double x1 = 1.0 + x;
+        double sigma2 = (12.0 * x * x1 * x1 * x1 * std::log(x1 / x) -
+                         x / x1 * (25.0 + 52.0 * x + 42.0 * x * x + 12.0 * x * x * x)) / 12.0;
+        double sigma = std::sqrt(std::max(sigma2, 0.0) * potentialScale);
+        double escape2 = 2.0 * potentialScale / x1;
+
+        NewBody body = {0, 0, 0, 0, 0, 0, mass, 3344, color};
+        random.Direction(x * scaleRadius, body.x, body.y, body.z);
+        do {
+            body.vx = sigma * random.Normal();
+            body.vy = sigma * random.Normal();
+            body.vz = sigma * random.Normal();
+        } while (body.vx * body.vx + body.vy * body.vy + body.vz * body.vz > 0.95 * 0.95 * escape2);
+        return body;
+    });
+    CenterEqualMasses(simulation.bodies, first, pool);
+}
+
+void AddExponentialDisk(Simulation& simulation, size_t count, float centralMass, float diskMass, float scaleLength,
+                        uint32_t seed, ThreadPool* pool) {
+    simulation.bodies.Reserve(simulation.bodies.Size() + count + 1);
+    simulation.AddBody(0, 0, 0, 0, 0, 0, centralMass, 5515, PackColor(1.0f, 0.9f, 0.6f, 1.0f));
+    const float mass = diskMass / count;
+    const uint32_t color = PackColor(0.6f, 0.7f, 1.0f, 1.0f);
+    AppendBodies(simulation, count, seed, pool, [&](size_t, BodyRandom& random) {
+        // Surface density ~ exp(-R / Rd): R / Rd follows a gamma(2) distribution; keep clear of the center
+        double R;
+        do {
+            R = -scaleLength * std::log(random.Positive() * random.Positive());
+        } while (R < 0.2 * scaleLength || R > 8.0 * scaleLength);
+        double phi = 2.0 * pi * random.Uniform();
+        double x = R / scaleLength;
+        double enclosed = centralMass + diskMass * (1.0 - (1.0 + x) * std::exp(-x));
+        double speed = std::sqrt(GScene * enclosed / R);
+        return NewBody{R * std::cos(phi), 0.02 * scaleLength * random.Normal(), R * std::sin(phi),
+                       -speed * std::sin(phi), 0, speed * std::cos(phi), mass, 3344, color};
+    });
+}
+
+const char* SceneGeneratorName(SceneGenerator generator) {
+    switch (generator) {
+        case SceneGenerator::Plummer: return "plummer";
+        case SceneGenerator::Hernquist: return "hernquist";
+        case SceneGenerator::Disk: return "disk";
+        case SceneGenerator::Cube: return "cube";
+    }
+    return "?";
+}
+
+bool ParseSceneGenerator(const char* name, SceneGenerator& generator) {
+    for (SceneGenerator candidate : {SceneGenerator::Plummer, SceneGenerator::Hernquist, SceneGenerator::Disk,
+                                     SceneGenerator::Cube}) {
+        if (std::strcmp(name, SceneGeneratorName(candidate)) == 0) {
+            generator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void AddGenerated(Simulation& simulation, SceneGenerator generator, size_t count, uint32_t seed, ThreadPool* pool) {
+    // About the Earth-Moon scale the camera starts at; total masses do not depend on the count
+    const float totalMass = 4.3e26f;
+    switch (generator) {
+        case SceneGenerator::Plummer: AddPlummer(simulation, count, totalMass, 2000.0f, seed, pool); break;
+        case SceneGenerator::Hernquist: AddHernquist(simulation, count, totalMass, 1500.0f, seed, pool); break;
+        case SceneGenerator::Disk: AddExponentialDisk(simulation, count, 2e27f, 2e26f, 2000.0f, seed, pool); break;
+        case SceneGenerator::Cube: AddUniformCube(simulation, count, 5000.0f, totalMass / count, seed, pool); break;
+    }
+}
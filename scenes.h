@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "simulation.h"
+
+class ThreadPool;
+
+// The built-in scene: the Moon (grey, with a trail) at 3844 on a circular-ish orbit around the Earth (blue) at the origin
+void AddEarthMoon(Simulation& simulation);
+
+// The generators below draw every body's random numbers from a counter-based stream keyed by
+// (seed, body index), so they fill bodies in parallel on `pool` (nullptr: the calling thread) and
+// the same seed gives the same bodies for any number of threads.
+
+// `count` bodies at rest, uniformly spread over the cube [-halfSize, halfSize]^3, with masses
+// between 0.5 and 1.5 times `mass`
+void AddUniformCube(Simulation& simulation, size_t count, float halfSize, float mass, uint32_t seed,
+                    ThreadPool* pool = nullptr);
+
+// `count` light bodies of `mass` on circular orbits in the XZ plane around body `center`, spread
+// uniformly in angle and between innerRadius and outerRadius (speeds match the step's 1/96, 1/94 factors)
+void AddOrbitingRing(Simulation& simulation, size_t center, size_t count, float innerRadius, float outerRadius,
+                     float mass, uint32_t seed, ThreadPool* pool = nullptr);
+
+// Plummer sphere in equilibrium (Aarseth, Henon & Wielen sampling), centered and at rest overall
+void AddPlummer(Simulation& simulation, size_t count, float totalMass, float scaleRadius, uint32_t seed,
+                ThreadPool* pool = nullptr);
+
+// Hernquist sphere cut at 20 scale radii, with isotropic Gaussian velocities of the Jeans dispersion
+// (Hernquist 1990, eq. 10) below 0.95 of the escape speed; centered and at rest overall
+void AddHernquist(Simulation& simulation, size_t count, float totalMass, float scaleRadius, uint32_t seed,
+                  ThreadPool* pool = nullptr);
+
+// A central body plus `count` bodies in a thin exponential disk in the XZ plane on circular orbits
+// (central mass plus the disk mass inside their radius)
+void AddExponentialDisk(Simulation& simulation, size_t count, float centralMass, float diskMass, float scaleLength,
+                        uint32_t seed, ThreadPool* pool = nullptr);
+
+// Generators selectable on the command line, with masses and sizes that fit the default camera
+enum class SceneGenerator : uint8_t {
+    Plummer,
+    Hernquist,
+    Disk,
+    Cube,
+};
+
+const char* SceneGeneratorName(SceneGenerator generator);
+// Accepts the names returned by SceneGeneratorName
+bool ParseSceneGenerator(const char* name, SceneGenerator& generator);
+void AddGenerated(Simulation& simulation, SceneGenerator generator, size_t count, uint32_t seed,
+                  ThreadPool* pool = nullptr);
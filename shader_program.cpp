@@ -0,0 +1,131 @@
+#include "shader_program.h"
+
+#include <glm/gtc/type_ptr.hpp>
+#include <iostream>
+#include <vector>
+
+GLuint CreateShaderProgram(const char* vertexSource, const char* fragmentSource) {
+    // Vertex shader
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &vertexSource, nullptr);
+    glCompileShader(vertexShader);
+
+    GLint success;
+    glGetShaderiv(vertexShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(vertexShader, 512, nullptr, infoLog);
+        std::cerr << "Vertex shader compilation failed: " << infoLog << std::endl;
+    }
+
+    // Fragment shader
+    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fragmentShader, 1, &fragmentSource, nullptr);
+    glCompileShader(fragmentShader);
+
+    glGetShaderiv(fragmentShader, GL_COMPILE_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetShaderInfoLog(fragmentShader, 512, nullptr, infoLog);
+        std::cerr << "Fragment shader compilation failed: " << infoLog << std::endl;
+    }
+
+    // Shader program
+    GLuint shaderProgram = glCreateProgram();
+    glAttachShader(shaderProgram, vertexShader);
+    glAttachShader(shaderProgram, fragmentShader);
+    glLinkProgram(shaderProgram);
+
+    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    if (!success) {
+        char infoLog[512];
+        glGetProgramInfoLog(shaderProgram, 512, nullptr, infoLog);
+        std::cerr << "Shader program linking failed: " << infoLog << std::endl;
+    }
+
+    glDeleteShader(vertexShader);
+    glDeleteShader(fragmentShader);
+
+    return shaderProgram;
+}
+
+ShaderProgram::ShaderProgram(const char* vertexSource, const char* fragmentSource) {
+    id = CreateShaderProgram(vertexSource, fragmentSource);
+
+    // Resolve every active uniform once
+    GLint uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(id, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(id, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    std::vector<char> name(maxNameLength > 0 ? maxNameLength : 1);
+    for (GLint i = 0; i < uniformCount; ++i) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(id, i, (GLsizei)name.size(), &length, &size, &type, name.data());
+        GLint location = glGetUniformLocation(id, name.data());
+        if (location >= 0) { // block members have no location
+            locations[std::string(name.data(), length)] = location;
+        }
+    }
+    modelLoc = Location("model");
+    objectColorLoc = Location("objectColor");
+
+    GLuint cameraBlock = glGetUniformBlockIndex(id, "Camera");
+    if (cameraBlock != GL_INVALID_INDEX) {
+        glUniformBlockBinding(id, cameraBlock, cameraBlockBinding);
+    }
+}
+
+void ShaderProgram::Use() const {
+    glUseProgram(id);
+}
+
+void ShaderProgram::SetModel(const glm::mat4& model) const {
+    glUniformMatrix4fv(modelLoc, 1, GL_FALSE, glm::value_ptr(model));
+}
+
+void ShaderProgram::SetColor(const glm::vec4& color) const {
+    glUniform4f(objectColorLoc, color.r, color.g, color.b, color.a);
+}
+
+GLint ShaderProgram::Location(const std::string& name) const {
+    auto it = locations.find(name);
+    return it != locations.end() ? it->second : -1;
+}
+
+void ShaderProgram::Destroy() {
+    glDeleteProgram(id);
+    id = 0;
+    locations.clear();
+}
+
+void CameraUniforms::Create() {
+    glGenBuffers(1, &ubo);
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * sizeof(glm::mat4), nullptr, GL_DYNAMIC_DRAW);
+    glm::mat4 identity = glm::mat4(1.0f);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(identity));
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(identity));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CameraUniforms::SetView(const glm::mat4& view) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(glm::mat4), glm::value_ptr(view));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CameraUniforms::SetProjection(const glm::mat4& projection) const {
+    glBindBuffer(GL_UNIFORM_BUFFER, ubo);
+    glBufferSubData(GL_UNIFORM_BUFFER, sizeof(glm::mat4), sizeof(glm::mat4), glm::value_ptr(projection));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void CameraUniforms::Bind() const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, cameraBlockBinding, ubo);
+}
+
+void CameraUniforms::Destroy() {
+    glDeleteBuffers(1, &ubo);
+    ubo = 0;
+}
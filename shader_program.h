@@ -0,0 +1,45 @@
+#pragma once
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+#include <string>
+#include <unordered_map>
+
+// Binding point of the `Camera` uniform block shared by every program
+const GLuint cameraBlockBinding = 0;
+
+GLuint CreateShaderProgram(const char* vertexSource, const char* fragmentSource);
+
+// A linked program with its uniform locations resolved once at link time,
+// so nothing on the per-frame or per-object paths calls glGetUniformLocation
+class ShaderProgram {
+    public:
+        GLuint id = 0;
+        GLint modelLoc = -1;
+        GLint objectColorLoc = -1;
+
+        ShaderProgram() = default;
+        ShaderProgram(const char* vertexSource, const char* fragmentSource);
+
+        void Use() const;
+        void SetModel(const glm::mat4& model) const;
+        void SetColor(const glm::vec4& color) const;
+        GLint Location(const std::string& name) const; // -1 if the uniform is not active
+        void Destroy();
+
+    private:
+        std::unordered_map<std::string, GLint> locations;
+};
+
+// std140 `Camera` block: view and projection live in one uniform buffer that is
+// written once per frame (view) or on resize (projection) instead of per program
+class CameraUniforms {
+    public:
+        GLuint ubo = 0;
+
+        void Create();
+        void SetView(const glm::mat4& view) const;
+        void SetProjection(const glm::mat4& projection) const;
+        void Bind() const; // attach to cameraBlockBinding
+        void Destroy();
+};
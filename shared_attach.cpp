@@ -0,0 +1,107 @@
+// Attaches to the snapshots a running simulation publishes with --shared-memory and reports them:
+// an example of a lightweight external reader. The sums are computed in place in shared memory.
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+
+#include "shared_snapshots.h"
+#include "simulation_thread.h"
+
+// How long to wait for the writer to set up a larger segment after replacing the old one
+const double reattachTimeout = 5.0;
+
+static void PrintUsage(const char* program) {
+    std::fprintf(stderr,
+        "usage: %s NAME [options]\n"
+        "  --interval S        seconds between reports (default 1)\n"
+        "  --count N           reports before exiting (default 0 = until the simulation exits)\n"
+        "  --copy PATH         also copy the newest snapshot into a checkpoint at PATH on exit\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] != '/') {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    const std::string name = argv[1];
+    double interval = 1.0;
+    long count = 0;
+    std::string copyPath;
+    for (int i = 2; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--interval") == 0 && value) {
+            interval = std::atof(value);
+            ++i;
+        } else if (std::strcmp(arg, "--count") == 0 && value) {
+            count = std::atol(value);
+            ++i;
+        } else if (std::strcmp(arg, "--copy") == 0 && value) {
+            copyPath = value;
+            ++i;
+        } else {
+            std::fprintf(stderr, "%s: bad argument '%s'\n", argv[0], arg);
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    SharedSnapshotReader reader;
+    std::string error;
+    if (!reader.Attach(name, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+    std::printf("publication,step,time,bodies,mass,com_x,com_y,com_z,age_ms\n");
+    uint64_t lastPublication = 0;
+    for (long reports = 0; count == 0 || reports < count;) {
+        // Closed: the simulation exited, its last snapshots stay mapped for --copy.
+        // Replaced by a larger segment: attach to it once the writer has it ready.
+        if (reader.Closed()) break;
+        if (reader.Replaced() && !reader.Reattach(name, reattachTimeout, &error)) {
+            std::fprintf(stderr, "%s was replaced but the new segment did not appear: %s\n", name.c_str(), error.c_str());
+            break;
+        }
+        SharedSnapshotView view;
+        if (reader.Latest(view) && view.slot->publication != lastPublication) {
+            const float* x = view.Floats(CheckpointField::X);
+            const float* y = view.Floats(CheckpointField::Y);
+            const float* z = view.Floats(CheckpointField::Z);
+            const float* mass = view.Floats(CheckpointField::Mass);
+            double total = 0.0, cx = 0.0, cy = 0.0, cz = 0.0;
+            for (size_t i = 0; i < view.BodyCount(); ++i) {
+                total += mass[i];
+                cx += mass[i] * x[i];
+                cy += mass[i] * y[i];
+                cz += mass[i] * z[i];
+            }
+            const uint64_t publication = view.slot->publication, step = view.slot->step;
+            const double time = view.slot->time, age = SteadySeconds() - view.slot->publishTime;
+            const size_t bodies = view.BodyCount();
+            // Overwritten while summing: skip this one, the next is newer anyway
+            if (reader.Valid(view)) {
+                std::printf("%llu,%llu,%.9g,%zu,%.9g,%.9g,%.9g,%.9g,%.3f\n", (unsigned long long)publication,
+                            (unsigned long long)step, time, bodies, total, cx / total, cy / total, cz / total, 1000.0 * age);
+                std::fflush(stdout);
+                lastPublication = publication;
+                reports++;
+                std::this_thread::sleep_for(std::chrono::duration<double>(interval));
+                continue;
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    if (!copyPath.empty()) {
+        Snapshot snapshot;
+        if (!reader.Copy(snapshot) || !WriteCheckpoint(copyPath, snapshot, SimulationParams())) {
+            std::fprintf(stderr, "Cannot copy the newest snapshot to %s\n", copyPath.c_str());
+            return 1;
+        }
+    }
+    return 0;
+}
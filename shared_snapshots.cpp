@@ -0,0 +1,245 @@
+#include "shared_snapshots.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+#include "simulation_thread.h"
+
+namespace {
+
+size_t AlignUp(size_t value) {
+    return (value + checkpointAlignment - 1) / checkpointAlignment * checkpointAlignment;
+}
+
+bool SetError(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+const SharedSlotHeader* Slot(const uint8_t* base, const SharedRingHeader* header, uint64_t publication) {
+    return (const SharedSlotHeader*)(base + header->slotsOffset + (publication % header->slotCount) * header->slotBytes);
+}
+
+}
+
+bool SharedSnapshotRing::Open(const std::string& name, uint32_t slotCount) {
+    Close();
+    if (name.empty() || slotCount < 2) return false;
+    this->name = name;
+    this->slotCount = slotCount;
+    publications = 0;
+    return true;
+}
+
+// The old segment, if any, is marked replaced once its name points at the new one (or creating that
+// failed), so its readers find the new segment ready, or time out, when they attach again
+bool SharedSnapshotRing::Create(size_t capacity) {
+    SharedRingHeader layout = {};
+    std::memcpy(layout.magic, sharedRingMagic, sizeof(layout.magic));
+    layout.version = sharedRingVersion;
+    layout.byteOrder = checkpointByteOrder;
+    layout.headerSize = sizeof(SharedRingHeader);
+    layout.slotCount = slotCount;
+    layout.capacity = capacity;
+    layout.slotsOffset = AlignUp(sizeof(SharedRingHeader));
+    size_t offset = AlignUp(sizeof(SharedSlotHeader));
+    const BodyStore empty;
+    for (int f = 0; f < (int)CheckpointField::Count; ++f) {
+        layout.fieldSizes[f] = CheckpointFieldView(empty, (CheckpointField)f).elementSize;
+        layout.fieldOffsets[f] = offset;
+        offset = AlignUp(offset + (size_t)layout.fieldSizes[f] * capacity);
+    }
+    layout.slotBytes = offset;
+    layout.writerPid = (uint32_t)getpid();
+
+    // A new segment under the same name; readers of the old one keep their mapping until they attach again
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        Release(sharedRingReplaced);
+        return false;
+    }
+    const size_t newSize = layout.slotsOffset + slotCount * layout.slotBytes;
+    bool ok = ftruncate(fd, (off_t)newSize) == 0;
+#ifdef __linux__
+    // Reserve the pages now: running out of /dev/shm later would be a SIGBUS in the middle of a copy
+    ok = ok && posix_fallocate(fd, 0, (off_t)newSize) == 0;
+#endif
+    void* mapping = ok ? mmap(nullptr, newSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        Release(sharedRingReplaced);
+        return false;
+    }
+    // The segment starts zeroed: every slot sequence, `latest` and `retired` are 0. The magic goes in
+    // last, so a reader that attaches early sees "not a snapshot ring" and retries instead of a half header.
+    SharedRingHeader* header = (SharedRingHeader*)mapping;
+    std::memcpy((uint8_t*)header + sizeof(layout.magic), (const uint8_t*)&layout + sizeof(layout.magic),
+                offsetof(SharedRingHeader, latest) - sizeof(layout.magic));
+    header->writerPid = layout.writerPid;
+    std::atomic_thread_fence(std::memory_order_release);
+    std::memcpy(header->magic, layout.magic, sizeof(layout.magic));
+
+    Release(sharedRingReplaced);
+    base = (uint8_t*)mapping;
+    size = newSize;
+    return true;
+}
+
+bool SharedSnapshotRing::Publish(const Snapshot& snapshot) {
+    if (name.empty()) return false;
+    const size_t count = snapshot.bodies.Size();
+    SharedRingHeader* header = (SharedRingHeader*)base;
+    if (!base || count > header->capacity) {
+        if (!Create(count + count / 8 + 1024)) return false;
+        header = (SharedRingHeader*)base;
+    }
+
+    const uint64_t publication = ++publications;
+    SharedSlotHeader* slot = const_cast<SharedSlotHeader*>(Slot(base, header, publication));
+    const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+
+    slot->publication = publication;
+    slot->bodyCount = count;
+    slot->step = snapshot.step;
+    slot->time = snapshot.time;
+    slot->publishTime = SteadySeconds();
+    slot->totalInteractions = snapshot.totalInteractions;
+    slot->speed = snapshot.speed;
+    slot->paused = snapshot.paused;
+    for (int f = 0; f < (int)CheckpointField::Count; ++f) {
+        CheckpointFieldBytes field = CheckpointFieldView(snapshot.bodies, (CheckpointField)f);
+        if (count > 0) std::memcpy((uint8_t*)slot + header->fieldOffsets[f], field.data, field.elementSize * count);
+    }
+
+    slot->sequence.store(sequence + 2, std::memory_order_release);
+    header->latest.store(publication, std::memory_order_release);
+    return true;
+}
+
+void SharedSnapshotRing::Release(uint32_t reason) {
+    if (!base) return;
+    ((SharedRingHeader*)base)->retired.store(reason, std::memory_order_release);
+    munmap(base, size);
+    base = nullptr;
+    size = 0;
+}
+
+void SharedSnapshotRing::Close() {
+    if (name.empty()) return;
+    bool created = base != nullptr;
+    Release(sharedRingClosed);
+    if (created) shm_unlink(name.c_str());
+    name.clear();
+}
+
+bool SharedSnapshotReader::Attach(const std::string& name, std::string* error) {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return SetError(error, "no shared snapshots named " + name + " (is the simulation running with --shared-memory?)");
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(SharedRingHeader)) {
+        close(fd);
+        return SetError(error, name + " is not a snapshot ring");
+    }
+    const size_t mappedSize = (size_t)info.st_size;
+    void* mapping = mmap(nullptr, mappedSize, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) return SetError(error, "cannot map " + name);
+    const SharedRingHeader* mapped = (const SharedRingHeader*)mapping;
+
+    std::string problem;
+    const bool magic = std::memcmp(mapped->magic, sharedRingMagic, sizeof(sharedRingMagic)) == 0;
+    std::atomic_thread_fence(std::memory_order_acquire); // pairs with the writer's fence before the magic
+    if (!magic) {
+        problem = " is not a snapshot ring";
+    } else if (mapped->byteOrder != checkpointByteOrder) {
+        problem = " was written on a machine of the other byte order";
+    } else if (mapped->version != sharedRingVersion || mapped->headerSize != sizeof(SharedRingHeader)) {
+        problem = " has ring version " + std::to_string(mapped->version) + ", expected " + std::to_string(sharedRingVersion);
+    } else if (mapped->slotCount == 0 || mapped->slotsOffset + mapped->slotCount * mapped->slotBytes > mappedSize) {
+        problem = " is truncated";
+    }
+    if (!problem.empty()) {
+        munmap(mapping, mappedSize);
+        return SetError(error, name + problem);
+    }
+    // Only now let go of the previous segment, so a failed attach keeps its last snapshots readable
+    Detach();
+    base = (const uint8_t*)mapping;
+    header = mapped;
+    size = mappedSize;
+    return true;
+}
+
+bool SharedSnapshotReader::Reattach(const std::string& name, double timeout, std::string* error) {
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::duration<double>(timeout);
+    auto pause = std::chrono::milliseconds(1);
+    while (!Attach(name, error)) {
+        if (std::chrono::steady_clock::now() + pause > deadline) return false;
+        std::this_thread::sleep_for(pause);
+        pause = std::min(pause * 2, std::chrono::milliseconds(100));
+    }
+    return true;
+}
+
+void SharedSnapshotReader::Detach() {
+    if (base) munmap(const_cast<uint8_t*>(base), size);
+    base = nullptr;
+    header = nullptr;
+    size = 0;
+}
+
+bool SharedSnapshotReader::Latest(SharedSnapshotView& view) const {
+    if (!header) return false;
+    // Retries only when the writer laps the ring between reading `latest` and the slot
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        const uint64_t publication = header->latest.load(std::memory_order_acquire);
+        if (publication == 0) return false;
+        const SharedSlotHeader* slot = Slot(base, header, publication);
+        const uint64_t sequence = slot->sequence.load(std::memory_order_acquire);
+        if (sequence & 1) continue;
+        view.slot = slot;
+        view.sequence = sequence;
+        for (int f = 0; f < (int)CheckpointField::Count; ++f) {
+            view.fields[f] = (const uint8_t*)slot + header->fieldOffsets[f];
+        }
+        if (slot->publication == publication && Valid(view)) return true;
+    }
+    return false;
+}
+
+bool SharedSnapshotReader::Valid(const SharedSnapshotView& view) const {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return view.slot && view.slot->sequence.load(std::memory_order_relaxed) == view.sequence;
+}
+
+bool SharedSnapshotReader::Copy(Snapshot& snapshot) const {
+    SharedSnapshotView view;
+    for (int attempt = 0; attempt < 64; ++attempt) {
+        if (!Latest(view)) return false;
+        const size_t count = view.slot->bodyCount;
+        if (count > header->capacity) continue;
+        snapshot.bodies.Resize(count);
+        for (int f = 0; f < (int)CheckpointField::Count; ++f) {
+            CheckpointFieldBytes field = CheckpointFieldView(snapshot.bodies, (CheckpointField)f);
+            if (count > 0) std::memcpy(const_cast<void*>(field.data), view.fields[f], field.elementSize * count);
+        }
+        snapshot.step = view.slot->step;
+        snapshot.time = view.slot->time;
+        snapshot.speed = view.slot->speed;
+        snapshot.paused = view.slot->paused != 0;
+        snapshot.publishTime = view.slot->publishTime;
+        snapshot.totalInteractions = view.slot->totalInteractions;
+        if (Valid(view)) return true;
+    }
+    return false;
+}
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "checkpoint.h"
+#include "simulation.h"
+
+// Snapshots published into a POSIX shared-memory segment so other processes (a second viewer,
+// an analysis script, a recorder) can read them in place. The segment holds a ring of slots,
+// each with every body array at a 64-byte boundary (CheckpointField order) and a seqlock
+// sequence: odd while the writer fills the slot, bumped to even when done. The writer never
+// waits for readers; a reader checks the sequence after reading and retries if it changed.
+//
+//   SharedRingHeader | pad | slot 0 | slot 1 | ...
+//   slot = SharedSlotHeader | pad | x[capacity] | pad | y[capacity] | ... | flags[capacity]
+const char sharedRingMagic[8] = {'G', 'R', 'A', 'V', 'S', 'H', 'M', '1'};
+const uint32_t sharedRingVersion = 1;
+// SharedRingHeader::retired
+const uint32_t sharedRingLive = 0;
+const uint32_t sharedRingReplaced = 1; // a larger segment took the name: attach again
+const uint32_t sharedRingClosed = 2;   // the writer exited, no more snapshots
+
+struct SharedRingHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;                // checkpointByteOrder convention: 0x01020304
+    uint32_t headerSize;               // sizeof(SharedRingHeader) of the writer
+    uint32_t slotCount;
+    uint64_t capacity;                 // bodies per slot
+    uint64_t slotsOffset;              // of slot 0 from the start of the segment
+    uint64_t slotBytes;                // from one slot to the next
+    uint64_t fieldOffsets[(int)CheckpointField::Count]; // of each array from the start of a slot
+    uint32_t fieldSizes[(int)CheckpointField::Count];   // bytes per body
+    std::atomic<uint64_t> latest;      // publication number of the newest complete slot, 0 = none yet
+    std::atomic<uint32_t> retired;     // sharedRingLive, sharedRingReplaced (more bodies) or sharedRingClosed
+    uint32_t writerPid;
+};
+
+struct SharedSlotHeader {
+    std::atomic<uint64_t> sequence;    // seqlock: odd while being written
+    uint64_t publication;              // this slot holds publication number `publication`
+    uint64_t bodyCount;
+    uint64_t step;
+    double time;                       // simulated seconds
+    double publishTime;                // SteadySeconds() of the writer
+    uint64_t totalInteractions;
+    float speed;
+    uint8_t paused;
+};
+
+// Writer side, owned by the simulating process. Publish copies a snapshot into the next slot.
+class SharedSnapshotRing {
+    public:
+        ~SharedSnapshotRing() { Close(); }
+
+        // name: a POSIX shared-memory name such as "/gravity"; the segment is created on the first Publish
+        bool Open(const std::string& name, uint32_t slotCount = 4);
+        // Replaces the segment with a larger one (readers see it replaced and attach again) when the
+        // bodies no longer fit
+        bool Publish(const Snapshot& snapshot);
+        // Marks the segment closed and removes the name
+        void Close();
+        bool Active() const { return !name.empty(); }
+
+        uint64_t publications = 0;
+
+    private:
+        bool Create(size_t capacity);
+        void Release(uint32_t reason);
+
+        std::string name;
+        uint32_t slotCount = 4;
+        uint8_t* base = nullptr;
+        size_t size = 0;
+};
+
+// A published snapshot read in place: pointers into the segment, valid while Valid() holds
+struct SharedSnapshotView {
+    const SharedSlotHeader* slot = nullptr;
+    uint64_t sequence = 0;
+    const uint8_t* fields[(int)CheckpointField::Count] = {};
+
+    size_t BodyCount() const { return slot->bodyCount; }
+    const float* Floats(CheckpointField field) const { return (const float*)fields[(int)field]; }
+};
+
+// Reader side, for other processes. Nothing is copied unless asked for.
+class SharedSnapshotReader {
+    public:
+        ~SharedSnapshotReader() { Detach(); }
+
+        // On failure the current segment, if any, stays attached
+        bool Attach(const std::string& name, std::string* error = nullptr);
+        void Detach();
+        // The writer moved to a larger segment; Reattach for new snapshots
+        bool Replaced() const { return header && header->retired.load(std::memory_order_acquire) == sharedRingReplaced; }
+        // The writer exited; the last snapshots stay readable until Detach
+        bool Closed() const { return header && header->retired.load(std::memory_order_acquire) == sharedRingClosed; }
+        // Attaches to the segment that replaced this one, retrying with a growing pause while the
+        // writer is still setting it up; false (still attached to the old one) after `timeout` seconds
+        bool Reattach(const std::string& name, double timeout, std::string* error = nullptr);
+        const SharedRingHeader* Header() const { return header; }
+
+        // The newest complete snapshot; false when there is none yet. The arrays are overwritten
+        // once the writer comes round the ring again, so check Valid() after reading them.
+        bool Latest(SharedSnapshotView& view) const;
+        bool Valid(const SharedSnapshotView& view) const;
+        // Copies the newest snapshot's bodies and counters, retrying when the writer overtakes the copy
+        bool Copy(Snapshot& snapshot) const;
+
+    private:
+        const SharedRingHeader* header = nullptr;
+        const uint8_t* base = nullptr;
+        size_t size = 0;
+};
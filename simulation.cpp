@@ -0,0 +1,351 @@
+#include "simulation.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+
+#include "profiler.h"
+#include "thread_pool.h"
+#include "trace.h"
+
+const char* ForceBackendName(ForceBackend backend) {
+    switch (backend) {
+        case ForceBackend::Direct: return "direct";
+        case ForceBackend::BarnesHut: return "barnes-hut";
+    }
+    return "?";
+}
+
+bool ParseForceBackend(const char* name, ForceBackend& backend) {
+    for (ForceBackend candidate : {ForceBackend::Direct, ForceBackend::BarnesHut}) {
+        if (std::strcmp(name, ForceBackendName(candidate)) == 0) {
+            backend = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* IntegratorName(Integrator integrator) {
+    switch (integrator) {
+        case Integrator::Euler: return "euler";
+        case Integrator::Leapfrog: return "leapfrog";
+    }
+    return "?";
+}
+
+bool ParseIntegrator(const char* name, Integrator& integrator) {
+    for (Integrator candidate : {Integrator::Euler, Integrator::Leapfrog}) {
+        if (std::strcmp(name, IntegratorName(candidate)) == 0) {
+            integrator = candidate;
+            return true;
+        }
+    }
+    return false;
+}
+
+void BodyStore::Clear() {
+    Resize(0);
+}
+
+void BodyStore::Reserve(size_t count) {
+    for (auto* array : {&x, &y, &z, &vx, &vy, &vz, &mass, &density, &radius}) array->reserve(count);
+    color.reserve(count);
+    id.reserve(count);
+    flags.reserve(count);
+}
+
+void BodyStore::Resize(size_t count) {
+    for (auto* array : {&x, &y, &z, &vx, &vy, &vz, &mass, &density, &radius}) array->resize(count);
+    color.resize(count);
+    id.resize(count);
+    flags.resize(count);
+}
+
+size_t Simulation::AddBody(float px, float py, float pz, float pvx, float pvy, float pvz,
+                           float bodyMass, float bodyDensity, uint32_t bodyColor, uint8_t bodyFlags) {
+    size_t index = bodies.Size();
+    bodies.Resize(index + 1);
+    bodies.x[index] = px;
+    bodies.y[index] = py;
+    bodies.z[index] = pz;
+    bodies.vx[index] = pvx;
+    bodies.vy[index] = pvy;
+    bodies.vz[index] = pvz;
+    bodies.mass[index] = bodyMass;
+    bodies.density[index] = bodyDensity;
+    bodies.radius[index] = BodyRadius(bodyMass, bodyDensity);
+    bodies.color[index] = bodyColor;
+    bodies.id[index] = nextId++;
+    bodies.flags[index] = bodyFlags;
+    Invalidate();
+    return index;
+}
+
+void Simulation::Apply(const Command& command) {
+    size_t last = bodies.Size() - 1;
+    bool placing = bodies.Size() > 0 && (bodies.flags[last] & BodyInitializing);
+
+    // Speed and pause leave the bodies alone; everything else changes what the conserved sums cover
+    if (command.type == CommandType::SetSpeed || command.type == CommandType::SetPaused) {
+        forcesCurrent = false;
+    } else {
+        Invalidate();
+    }
+    switch (command.type) {
+        case CommandType::SpawnBody:
+            AddBody(command.x, command.y, command.z, 0.0f, 0.0f, 0.0f, command.value, 3344,
+                    PackColor(1.0f, 0.0f, 0.0f, 1.0f), BodyInitializing);
+            break;
+        case CommandType::MoveLast:
+            if (placing) {
+                bodies.x[last] += command.x;
+                bodies.y[last] += command.y;
+                bodies.z[last] += command.z;
+            }
+            break;
+        case CommandType::GrowLast:
+            if (placing) {
+                bodies.mass[last] *= command.value;
+                bodies.radius[last] = BodyRadius(bodies.mass[last], bodies.density[last]);
+            }
+            break;
+        case CommandType::LaunchLast:
+            if (placing) {
+                bodies.flags[last] = (bodies.flags[last] & ~BodyInitializing) | BodyLaunched;
+            }
+            break;
+        case CommandType::SetSpeed:
+            params.speed = command.value;
+            break;
+        case CommandType::SetPaused:
+            params.paused = command.value != 0.0f;
+            break;
+    }
+}
+
+uint64_t Simulation::AccumulateForces(size_t begin, size_t end) {
+    const size_t count = bodies.Size();
+    const float* px = bodies.x.data();
+    const float* py = bodies.y.data();
+    const float* pz = bodies.z.data();
+    const float* radius = bodies.radius.data();
+    const uint8_t* flags = bodies.flags.data();
+    uint64_t interactions = 0;
+    for (size_t i = begin; i < end; ++i) {
+        if (flags[i] & BodyInitializing) continue;
+        if (params.backend == ForceBackend::BarnesHut) {
+            interactions += tree.Accelerate(i, bodies, params.theta, params.collisions, ax[i], ay[i], az[i],
+                                            potential[i], bounce[i]);
+            continue;
+        }
+        float sumX = 0.0f, sumY = 0.0f, sumZ = 0.0f, sumPotential = 0.0f;
+        for (size_t j = 0; j < count; ++j) {
+            if (j == i || (flags[j] & BodyInitializing)) continue;
+            float dx = px[j] - px[i];
+            float dy = py[j] - py[i];
+            float dz = pz[j] - pz[i];
+            float distance = sqrt(dx * dx + dy * dy + dz * dz);
+            if (distance > 0) {
+                interactions++;
+                float distance_m = distance * 1000;
+                float acc = (float)(G * bodies.mass[j]) / (distance_m * distance_m);
+                sumX += dx / distance * acc;
+                sumY += dy / distance * acc;
+                sumZ += dz / distance * acc;
+                sumPotential += acc * distance_m; // G m_j / d, no extra division
+
+                //collision
+                if (params.collisions && CheckCollision(radius[i], radius[j], distance)) {
+                    bounce[i] *= -0.2f;
+                }
+            }
+        }
+        ax[i] = sumX;
+        ay[i] = sumY;
+        az[i] = sumZ;
+        potential[i] = sumPotential;
+    }
+    return interactions;
+}
+
+uint64_t Simulation::ComputeForces() {
+    const size_t count = bodies.Size();
+    ax.assign(count, 0.0f);
+    ay.assign(count, 0.0f);
+    az.assign(count, 0.0f);
+    bounce.assign(count, 1.0f);
+    potential.assign(count, 0.0f);
+    if (params.backend == ForceBackend::BarnesHut) {
+        TraceScope buildTrace("tree_build");
+        tree.Build(bodies);
+    }
+    if (!pool) {
+        return AccumulateForces(0, count);
+    }
+    std::atomic<uint64_t> counted{0};
+    pool->ParallelFor(0, count, 64, [&](size_t begin, size_t end, size_t) {
+        counted.fetch_add(AccumulateForces(begin, end), std::memory_order_relaxed);
+    }, "forces_chunk");
+    return counted.load();
+}
+
+void Simulation::Kick(float factor) {
+    auto kick = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            bodies.vx[i] += ax[i] / 96 * factor;
+            bodies.vy[i] += ay[i] / 96 * factor;
+            bodies.vz[i] += az[i] / 96 * factor;
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(0, bodies.Size(), 4096, kick, "kick_chunk");
+    } else {
+        kick(0, bodies.Size(), 0);
+    }
+}
+
+void Simulation::MeasureConserved(double atTime) {
+    PhaseTimer conservedTimer(Phase::Conserved);
+    const size_t count = bodies.Size();
+    const size_t grain = 16384;
+    partials.assign((count + grain - 1) / grain, ConservedQuantities());
+    auto sum = [&](size_t begin, size_t end, size_t) {
+        ConservedQuantities& c = partials[begin / grain];
+        for (size_t i = begin; i < end; ++i) {
+            if (bodies.flags[i] & BodyInitializing) continue;
+            double m = bodies.mass[i];
+            double x = bodies.x[i], y = bodies.y[i], z = bodies.z[i];
+            double vx = bodies.vx[i], vy = bodies.vy[i], vz = bodies.vz[i];
+            c.mass += m;
+            c.kinetic += 0.5 * m * (vx * vx + vy * vy + vz * vz);
+            c.potential += m * potential[i];
+            c.px += m * vx;
+            c.py += m * vy;
+            c.pz += m * vz;
+            c.lx += m * (y * vz - z * vy);
+            c.ly += m * (z * vx - x * vz);
+            c.lz += m * (x * vy - y * vx);
+            c.comX += m * x;
+            c.comY += m * y;
+            c.comZ += m * z;
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(0, count, grain, sum, "conserved_chunk");
+    } else {
+        for (size_t begin = 0; begin < count; begin += grain) sum(begin, std::min(begin + grain, count), 0);
+    }
+
+    ConservedQuantities total;
+    for (const ConservedQuantities& c : partials) {
+        total.mass += c.mass;
+        total.kinetic += c.kinetic;
+        total.potential += c.potential;
+        total.px += c.px; total.py += c.py; total.pz += c.pz;
+        total.lx += c.lx; total.ly += c.ly; total.lz += c.lz;
+        total.comX += c.comX; total.comY += c.comY; total.comZ += c.comZ;
+    }
+    // Every pair was counted from both sides; G m / d in meters to GScene m / d in scene units
+    total.potential *= -0.5 * 1e-3 * 94.0 / 96.0;
+    if (total.mass > 0.0) {
+        total.comX /= total.mass;
+        total.comY /= total.mass;
+        total.comZ /= total.mass;
+    }
+    total.time = atTime;
+    total.valid = true;
+    conserved = total;
+    if (!conservedReference.valid) {
+        conservedReference = total;
+    }
+}
+
+void Simulation::Step() {
+    PhaseTimer stepTimer(Phase::Step);
+    auto start = std::chrono::steady_clock::now();
+    const size_t count = bodies.Size();
+    const float speed = params.speed;
+    // A paused leapfrog step is the same as a paused Euler step: only the bounce
+    const bool leapfrog = params.integrator == Integrator::Leapfrog && !params.paused;
+    uint64_t interactions = 0;
+
+    // Accelerations from every other body, all read from the same positions
+    // (the leapfrog still has them from the end of the previous step)
+    PhaseTimer forcesTimer(Phase::Forces);
+    if (!leapfrog || !forcesCurrent) {
+        interactions += ComputeForces();
+    }
+    forcesTimer.Stop();
+    if (!leapfrog) {
+        MeasureConserved(time); // positions and velocities still match the force pass
+    }
+
+    // Velocities, then positions (the per-step factors are the original 1/96 and 1/94)
+    PhaseTimer integrateTimer(Phase::Integrate);
+    const float kick = leapfrog ? speed * 0.5f : speed;
+    auto integrate = [&](size_t begin, size_t end, size_t) {
+        for (size_t i = begin; i < end; ++i) {
+            if (!params.paused) {
+                bodies.vx[i] += ax[i] / 96 * kick;
+                bodies.vy[i] += ay[i] / 96 * kick;
+                bodies.vz[i] += az[i] / 96 * kick;
+            }
+            if (!leapfrog) {
+                bodies.vx[i] *= bounce[i];
+                bodies.vy[i] *= bounce[i];
+                bodies.vz[i] *= bounce[i];
+            }
+            if (!params.paused) {
+                bodies.x[i] += bodies.vx[i] / 94 * speed;
+                bodies.y[i] += bodies.vy[i] / 94 * speed;
+                bodies.z[i] += bodies.vz[i] / 94 * speed;
+            }
+        }
+    };
+    if (pool) {
+        pool->ParallelFor(0, count, 4096, integrate, "integrate_chunk");
+    } else {
+        integrate(0, count, 0);
+    }
+    integrateTimer.Stop();
+
+    if (leapfrog) {
+        // Second half kick with the accelerations at the new positions, which the next step reuses
+        PhaseTimer secondForcesTimer(Phase::Forces);
+        interactions += ComputeForces();
+        secondForcesTimer.Stop();
+        PhaseTimer kickTimer(Phase::Integrate);
+        Kick(speed * 0.5f);
+        for (size_t i = 0; i < count; ++i) {
+            bodies.vx[i] *= bounce[i];
+            bodies.vy[i] *= bounce[i];
+            bodies.vz[i] *= bounce[i];
+        }
+        kickTimer.Stop();
+        forcesCurrent = true;
+        MeasureConserved(time + speed / 94.0);
+    } else {
+        forcesCurrent = false;
+    }
+
+    if (!params.paused) {
+        step++;
+        time += speed / 94.0;
+    }
+    totalInteractions += interactions;
+    lastStepSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void Simulation::WriteSnapshot(Snapshot& snapshot) const {
+    snapshot.bodies = bodies; // vector assignment reuses the snapshot's capacity
+    snapshot.step = step;
+    snapshot.time = time;
+    snapshot.speed = params.speed;
+    snapshot.paused = params.paused;
+    snapshot.stepSeconds = lastStepSeconds;
+    snapshot.totalInteractions = totalInteractions;
+    snapshot.conserved = conserved;
+    snapshot.conservedReference = conservedReference;
+}
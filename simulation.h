@@ -0,0 +1,172 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "barnes_hut.h"
+
+class ThreadPool;
+
+const double G = 6.6743e-11; // m^3 kg^-1 s^-2
+// G in scene units (1 unit = 1000 m) per simulated second, with the step's 94/96 factor folded in:
+// a body feels dv/dt = GScene * m / d^2
+const double GScene = G * 1e-6 * 94.0 / 96.0;
+
+// Radius (in scene units) of a sphere of the given mass and density, scaled down for display
+inline float BodyRadius(float mass, float density) {
+    return pow(((3 * mass/density)/(4 * 3.14159265359)), (1.0f/3.0f)) / 100000;
+}
+
+// Two bodies overlap (and bounce) when their centers are closer than the sum of their radii
+inline bool CheckCollision(float radiusA, float radiusB, float distance) {
+    return radiusA + radiusB > distance;
+}
+
+// RGBA8 with red in the low byte
+inline uint32_t PackColor(float r, float g, float b, float a) {
+    auto channel = [](float v) { return (uint32_t)(v < 0.0f ? 0.0f : v > 1.0f ? 255.0f : v * 255.0f + 0.5f); };
+    return channel(r) | (channel(g) << 8) | (channel(b) << 16) | (channel(a) << 24);
+}
+
+enum BodyFlags : uint8_t {
+    BodyInitializing = 1 << 0, // being placed with the mouse: moves with the arrow keys, exerts and feels no gravity
+    BodyLaunched     = 1 << 1,
+    BodyTrail        = 1 << 2, // renderer draws a trail behind it
+};
+
+// All bodies as parallel arrays, indexed by body
+struct BodyStore {
+    std::vector<float> x, y, z;
+    std::vector<float> vx, vy, vz;
+    std::vector<float> mass;
+    std::vector<float> density; // kg / m^3
+    std::vector<float> radius;
+    std::vector<uint32_t> color;
+    std::vector<uint32_t> id;   // stable across steps and snapshots
+    std::vector<uint8_t> flags;
+
+    size_t Size() const { return x.size(); }
+    void Clear();
+    void Reserve(size_t count);
+    void Resize(size_t count);
+};
+
+// How the accelerations are computed
+enum class ForceBackend : uint8_t {
+    Direct,    // every pair, O(N^2)
+    BarnesHut, // octree with far cells lumped together, O(N log N)
+};
+const char* ForceBackendName(ForceBackend backend);
+// Accepts the names returned by ForceBackendName
+bool ParseForceBackend(const char* name, ForceBackend& backend);
+
+// How velocities and positions advance; both use the original per-step factors (kick a / 96, drift v / 94)
+enum class Integrator : uint8_t {
+    Euler,    // kick then drift with the new velocity (semi-implicit Euler), the original update
+    Leapfrog, // half kick, drift, half kick with the new accelerations (second order, one force pass per step)
+};
+const char* IntegratorName(Integrator integrator);
+bool ParseIntegrator(const char* name, Integrator& integrator);
+
+struct SimulationParams {
+    float speed = 1.0f;      // simulation speed multiplier
+    bool paused = false;
+    bool collisions = true;  // bounce (velocity *= -0.2) while two bodies overlap
+    ForceBackend backend = ForceBackend::Direct;
+    float theta = 0.5f;      // Barnes-Hut opening angle, smaller is more accurate
+    Integrator integrator = Integrator::Euler;
+};
+
+// Requests from the UI, applied by the simulation before its next step
+enum class CommandType : uint8_t {
+    SpawnBody,    // at (x, y, z), at rest, with mass `value`, flagged as initializing
+    MoveLast,     // move the body being placed by (x, y, z)
+    GrowLast,     // multiply the mass of the body being placed by `value`
+    LaunchLast,   // release the body being placed
+    SetSpeed,     // speed multiplier = value
+    SetPaused,    // paused = value != 0
+};
+
+struct Command {
+    CommandType type;
+    float x = 0.0f, y = 0.0f, z = 0.0f;
+    float value = 0.0f;
+};
+
+// Conserved quantities of the bodies that take part in gravity, in scene units (kg, units, units per
+// simulated second). The potential energy comes out of the force pass; the rest is one O(N) sum.
+struct ConservedQuantities {
+    double time = 0.0;                          // simulated time they describe
+    double mass = 0.0;
+    double kinetic = 0.0, potential = 0.0;
+    double px = 0.0, py = 0.0, pz = 0.0;        // linear momentum
+    double lx = 0.0, ly = 0.0, lz = 0.0;        // angular momentum about the origin
+    double comX = 0.0, comY = 0.0, comZ = 0.0;  // center of mass
+    bool valid = false;
+
+    double Energy() const { return kinetic + potential; }
+};
+
+// Immutable copy of the simulation state handed to the renderer
+struct Snapshot {
+    BodyStore bodies;
+    uint64_t step = 0;
+    double time = 0.0;              // simulated seconds
+    float speed = 1.0f;
+    bool paused = false;
+    double stepSeconds = 0.0;       // wall time of the step that produced this snapshot
+    double publishTime = 0.0;       // SteadySeconds() when it was handed to the renderer
+    uint64_t totalInteractions = 0; // pair interactions evaluated since the start
+    ConservedQuantities conserved;
+    ConservedQuantities conservedReference; // drift is measured against this
+};
+
+class Simulation {
+    public:
+        BodyStore bodies;
+        SimulationParams params;
+        uint64_t step = 0;
+        double time = 0.0;
+        double lastStepSeconds = 0.0;
+        uint64_t totalInteractions = 0;
+        // Measured every step; the reference is the first measurement after the set of bodies or their
+        // masses changed (adding, growing or launching a body), so collisions and errors show up as drift
+        ConservedQuantities conserved;
+        ConservedQuantities conservedReference;
+        ThreadPool* pool = nullptr; // not owned; null runs the force pass on the stepping thread
+
+        // Returns the new body's index
+        size_t AddBody(float x, float y, float z, float vx, float vy, float vz,
+                       float mass, float density, uint32_t color, uint8_t flags = 0);
+        void Apply(const Command& command);
+        // One step: pairwise gravity and collisions for every body, then positions
+        void Step();
+        void WriteSnapshot(Snapshot& snapshot) const;
+        // Ids handed to new bodies continue from here (restoring a checkpoint)
+        uint32_t NextId() const { return nextId; }
+        void SetNextId(uint32_t id) { nextId = id; }
+        // Call after writing to `bodies` directly (AddBody and Apply do it themselves): the leapfrog
+        // reuses the previous step's accelerations
+        void Invalidate() {
+            forcesCurrent = false;
+            conservedReference.valid = false;
+        }
+
+    private:
+        // Accelerations and bounce factors of every body, returns the interactions evaluated
+        uint64_t ComputeForces();
+        // The same for bodies [begin, end)
+        uint64_t AccumulateForces(size_t begin, size_t end);
+        // v += a / 96 * factor for every body
+        void Kick(float factor);
+        // Fills `conserved` from the bodies and the potential of the last force pass
+        void MeasureConserved(double atTime);
+
+        uint32_t nextId = 0;
+        std::vector<float> ax, ay, az, bounce;
+        std::vector<float> potential; // sum of G m_j / d_ij (meters) over the bodies seen by body i
+        std::vector<ConservedQuantities> partials; // per chunk of MeasureConserved, summed in order
+        BarnesHutTree tree;
+        bool forcesCurrent = false; // ax, ay, az belong to the current positions
+};
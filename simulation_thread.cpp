@@ -0,0 +1,72 @@
+#include "simulation_thread.h"
+
+#include "trace.h"
+
+SimulationThread::SimulationThread(Simulation& simulation, double stepRate)
+    : simulation(simulation), stepRate(stepRate) {}
+
+SimulationThread::~SimulationThread() {
+    Stop();
+}
+
+void SimulationThread::Start() {
+    if (running.exchange(true)) return;
+
+    // Make the initial state visible before the first step completes
+    simulation.WriteSnapshot(snapshots.WriteBuffer());
+    snapshots.WriteBuffer().publishTime = SteadySeconds();
+    snapshots.Publish();
+    thread = std::thread(&SimulationThread::Run, this);
+}
+
+void SimulationThread::Stop() {
+    if (!running.exchange(false)) return;
+    thread.join();
+}
+
+void SimulationThread::Push(const Command& command) {
+    std::lock_guard<std::mutex> lock(commandMutex);
+    pending.push_back(command);
+}
+
+void SimulationThread::Run() {
+    TraceSetThreadName("simulation");
+    using clock = std::chrono::steady_clock;
+    const auto interval = std::chrono::duration_cast<clock::duration>(
+        std::chrono::duration<double>(stepRate > 0 ? 1.0 / stepRate : 0.0));
+    auto next = clock::now();
+
+    while (running.load(std::memory_order_relaxed)) {
+        TraceScope commandTrace("commands");
+        {
+            std::lock_guard<std::mutex> lock(commandMutex);
+            applying.swap(pending);
+        }
+        for (const Command& command : applying) {
+            if (onCommand) onCommand(ticks.load(std::memory_order_relaxed), command);
+            simulation.Apply(command);
+        }
+        applying.clear();
+        commandTrace.Stop();
+
+        simulation.Step();
+        ticks.fetch_add(1, std::memory_order_relaxed);
+        if (onStep) onStep(simulation);
+        {
+            TraceScope publishTrace("publish");
+            simulation.WriteSnapshot(snapshots.WriteBuffer());
+            snapshots.WriteBuffer().publishTime = SteadySeconds();
+            snapshots.Publish();
+        }
+
+        if (stepRate > 0) {
+            // Fixed rate; after a long stall skip ahead instead of bursting to catch up
+            next += interval;
+            auto now = clock::now();
+            if (now > next + 4 * interval) {
+                next = now;
+            }
+            std::this_thread::sleep_until(next);
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "simulation.h"
+#include "triple_buffer.h"
+
+// Seconds on the steady clock, the time base of Snapshot::publishTime
+inline double SteadySeconds() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Runs a Simulation on its own thread at a fixed step rate and publishes a
+// Snapshot after every step. The render thread picks up the newest snapshot
+// without blocking; commands from the UI are queued and applied between steps.
+class SimulationThread {
+    public:
+        // stepRate: steps per second of wall time, <= 0 to step as fast as possible
+        SimulationThread(Simulation& simulation, double stepRate);
+        ~SimulationThread();
+
+        void Start();
+        void Stop();
+        void Push(const Command& command);
+        TripleBuffer<Snapshot>& Snapshots() { return snapshots; }
+
+        // Called on the simulation thread after every step, before the snapshot is published;
+        // set before Start. Must not block (the trajectory writer only copies and queues).
+        std::function<void(const Simulation&)> onStep;
+        // Called on the simulation thread with each command as it is applied, and the steps taken
+        // before it (Ticks); set before Start
+        std::function<void(uint64_t, const Command&)> onCommand;
+        // Step calls since Start, paused or not; stable once stopped
+        uint64_t Ticks() const { return ticks.load(); }
+
+    private:
+        void Run();
+
+        Simulation& simulation;
+        double stepRate;
+        std::thread thread;
+        std::atomic<bool> running{false};
+        std::atomic<uint64_t> ticks{0};
+
+        std::mutex commandMutex;
+        std::vector<Command> pending;  // filled by Push, guarded by commandMutex
+        std::vector<Command> applying; // only touched by the simulation thread
+
+        TripleBuffer<Snapshot> snapshots;
+};
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <vector>
+
+glm::vec3 sphericalToCartesian(float r, float theta, float phi);
+// Triangle list (x, y, z per vertex) of a UV sphere
+std::vector<float> CreateSphereVertices(float radius, int stacks, int sectors);
@@ -0,0 +1,95 @@
+#include "thread_pool.h"
+
+#include <string>
+
+#include "trace.h"
+
+ThreadPool::ThreadPool(size_t threads) {
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+        if (threads == 0) threads = 1;
+    }
+    for (size_t worker = 1; worker < threads; ++worker) {
+        workers.emplace_back(&ThreadPool::WorkerLoop, this, worker);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::ParallelFor(size_t begin, size_t end, size_t grain,
+                             const std::function<void(size_t, size_t, size_t)>& fn, const char* traceName) {
+    if (end <= begin) return;
+    if (grain == 0) grain = 1;
+    if (workers.empty() || end - begin <= grain) {
+        TraceScope chunkTrace(traceName);
+        fn(begin, end, 0);
+        return;
+    }
+
+    // The workers are busy with another loop (or this is a nested call from one of its chunks):
+    // waiting could deadlock and would idle this thread, so run the same chunks here instead
+    if (inUse.exchange(true, std::memory_order_acquire)) {
+        for (size_t chunkBegin = begin; chunkBegin < end; chunkBegin += grain) {
+            TraceScope chunkTrace(traceName);
+            fn(chunkBegin, end - chunkBegin > grain ? chunkBegin + grain : end, 0);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        job = &fn;
+        jobBegin = begin;
+        jobEnd = end;
+        jobGrain = grain;
+        jobName = traceName;
+        nextChunk.store(0, std::memory_order_relaxed);
+        busy = workers.size();
+        generation++;
+    }
+    wake.notify_all();
+    RunChunks(0);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return busy == 0; });
+    job = nullptr;
+    inUse.store(false, std::memory_order_release);
+}
+
+void ThreadPool::WorkerLoop(size_t worker) {
+    uint64_t seen = 0;
+    bool named = false; // for the trace, once tracing is on
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+        wake.wait(lock, [&] { return stopping || generation != seen; });
+        if (stopping) return;
+        seen = generation;
+        lock.unlock();
+        if (!named && TraceEnabled()) {
+            TraceSetThreadName(("pool worker " + std::to_string(worker)).c_str());
+            named = true;
+        }
+        RunChunks(worker);
+        lock.lock();
+        if (--busy == 0) done.notify_one();
+    }
+}
+
+void ThreadPool::RunChunks(size_t worker) {
+    const size_t chunks = (jobEnd - jobBegin + jobGrain - 1) / jobGrain;
+    for (size_t chunk = nextChunk.fetch_add(1); chunk < chunks; chunk = nextChunk.fetch_add(1)) {
+        size_t chunkBegin = jobBegin + chunk * jobGrain;
+        size_t chunkEnd = chunkBegin + jobGrain < jobEnd ? chunkBegin + jobGrain : jobEnd;
+        TraceScope chunkTrace(jobName);
+        (*job)(chunkBegin, chunkEnd, worker);
+    }
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads for data-parallel loops. The calling thread takes part
+// as worker 0, so a pool of size 1 has no threads and runs everything inline.
+// One pool can be shared by many simulations: a ParallelFor issued while another one is
+// running (from another thread, or nested inside a chunk) runs its chunks inline on the
+// calling thread as worker 0, with the same chunking, instead of waiting for the pool.
+class ThreadPool {
+    public:
+        // threads: total workers including the caller, 0 = one per hardware thread
+        explicit ThreadPool(size_t threads = 0);
+        ~ThreadPool();
+
+        size_t Size() const { return workers.size() + 1; }
+
+        // Runs fn(chunkBegin, chunkEnd, worker) over [begin, end) in chunks of `grain`,
+        // handed out dynamically; returns once every chunk is done. worker < Size().
+        // Safe to call from several threads and from inside fn (see above). While tracing, every
+        // chunk is a span named traceName (a literal) on the thread that ran it.
+        void ParallelFor(size_t begin, size_t end, size_t grain,
+                         const std::function<void(size_t, size_t, size_t)>& fn, const char* traceName = "pool_task");
+
+    private:
+        void WorkerLoop(size_t worker);
+        void RunChunks(size_t worker);
+
+        std::vector<std::thread> workers;
+        std::atomic<bool> inUse{false}; // a ParallelFor owns the workers
+
+        std::mutex mutex;
+        std::condition_variable wake, done;
+        uint64_t generation = 0; // bumped for every ParallelFor
+        size_t busy = 0;         // workers still running the current generation
+        bool stopping = false;
+
+        const std::function<void(size_t, size_t, size_t)>* job = nullptr;
+        size_t jobBegin = 0, jobEnd = 0, jobGrain = 1;
+        const char* jobName = nullptr;
+        std::atomic<size_t> nextChunk{0};
+};
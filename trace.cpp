@@ -0,0 +1,123 @@
+#include "trace.h"
+
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+std::atomic<bool> traceEnabled{false};
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    int64_t start;    // ns since TraceStart
+    int64_t duration; // ns
+};
+
+const size_t chunkEvents = 4096;
+const size_t maxChunks = 4096; // 16M spans per thread, later ones are dropped
+
+// Appended to only by its thread. Chunks never move, and `count` is published after the
+// event is written, so a reader may walk the first `count` events while the owner appends.
+struct ThreadBuffer {
+    uint32_t tid = 0;
+    std::string name;
+    std::atomic<TraceEvent*> chunks[maxChunks] = {};
+    std::atomic<size_t> count{0};
+    size_t dropped = 0;
+
+    ~ThreadBuffer() {
+        for (auto& chunk : chunks) delete[] chunk.load();
+    }
+};
+
+std::chrono::steady_clock::time_point traceStart;
+std::mutex registryMutex; // guards the list and the names, not the events
+std::vector<std::unique_ptr<ThreadBuffer>> registry; // kept after a thread exits
+thread_local ThreadBuffer* localBuffer = nullptr;
+
+ThreadBuffer& LocalBuffer() {
+    if (!localBuffer) {
+        std::lock_guard<std::mutex> lock(registryMutex);
+        registry.emplace_back(new ThreadBuffer());
+        localBuffer = registry.back().get();
+        localBuffer->tid = (uint32_t)registry.size();
+    }
+    return *localBuffer;
+}
+
+// Names are literals in practice, but escape them anyway
+void WriteJsonString(FILE* file, const char* text) {
+    std::fputc('"', file);
+    for (const char* c = text; *c; ++c) {
+        if (*c == '"' || *c == '\\') std::fputc('\\', file);
+        if ((unsigned char)*c >= 0x20) std::fputc(*c, file);
+    }
+    std::fputc('"', file);
+}
+
+}
+
+void TraceStart() {
+    traceStart = std::chrono::steady_clock::now();
+    traceEnabled.store(true);
+}
+
+void TraceSetThreadName(const char* name) {
+    ThreadBuffer& buffer = LocalBuffer();
+    std::lock_guard<std::mutex> lock(registryMutex);
+    buffer.name = name;
+}
+
+void TraceSpan(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end) {
+    if (start < traceStart) return; // began before tracing was switched on
+    ThreadBuffer& buffer = LocalBuffer();
+    size_t index = buffer.count.load(std::memory_order_relaxed);
+    size_t chunkIndex = index / chunkEvents;
+    if (chunkIndex >= maxChunks) {
+        buffer.dropped++;
+        return;
+    }
+    TraceEvent* chunk = buffer.chunks[chunkIndex].load(std::memory_order_relaxed);
+    if (!chunk) {
+        chunk = new TraceEvent[chunkEvents];
+        buffer.chunks[chunkIndex].store(chunk, std::memory_order_release);
+    }
+    TraceEvent& event = chunk[index % chunkEvents];
+    event.name = name;
+    event.start = std::chrono::duration_cast<std::chrono::nanoseconds>(start - traceStart).count();
+    event.duration = std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count();
+    buffer.count.store(index + 1, std::memory_order_release);
+}
+
+bool WriteTrace(const std::string& path) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (!file) return false;
+
+    std::lock_guard<std::mutex> lock(registryMutex);
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    for (const auto& buffer : registry) {
+        if (!buffer->name.empty()) {
+            std::fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                         first ? "" : ",\n", buffer->tid);
+            WriteJsonString(file, buffer->name.c_str());
+            std::fprintf(file, "}}");
+            first = false;
+        }
+        size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const TraceEvent& event = buffer->chunks[i / chunkEvents].load(std::memory_order_acquire)[i % chunkEvents];
+            std::fprintf(file, "%s{\"name\":", first ? "" : ",\n");
+            WriteJsonString(file, event.name);
+            std::fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%" PRId64 ".%03d,\"dur\":%" PRId64 ".%03d}",
+                         buffer->tid, event.start / 1000, (int)(event.start % 1000),
+                         event.duration / 1000, (int)(event.duration % 1000));
+            first = false;
+        }
+    }
+    std::fprintf(file, "\n]}\n");
+    return std::fclose(file) == 0;
+}
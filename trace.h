@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+// Opt-in timeline of spans, written as Chrome trace-event JSON (chrome://tracing, ui.perfetto.dev).
+// Every thread appends to its own buffer without locking; WriteTrace can run at any time and
+// sees every span completed before it started. Span names must be string literals (or otherwise
+// live for the whole run): only the pointer is stored.
+
+extern std::atomic<bool> traceEnabled;
+
+inline bool TraceEnabled() {
+    return traceEnabled.load(std::memory_order_relaxed);
+}
+
+void TraceStart();
+// Label for the calling thread in the viewer
+void TraceSetThreadName(const char* name);
+void TraceSpan(const char* name, std::chrono::steady_clock::time_point start, std::chrono::steady_clock::time_point end);
+bool WriteTrace(const std::string& path);
+
+// Records a span from construction to Stop() (or destruction) while tracing is on
+class TraceScope {
+    public:
+        explicit TraceScope(const char* name) : name(name) {
+            if (TraceEnabled()) start = std::chrono::steady_clock::now();
+        }
+        ~TraceScope() { Stop(); }
+        void Stop() {
+            if (TraceEnabled() && start != std::chrono::steady_clock::time_point()) {
+                TraceSpan(name, start, std::chrono::steady_clock::now());
+            }
+            start = std::chrono::steady_clock::time_point();
+        }
+
+    private:
+        const char* name;
+        std::chrono::steady_clock::time_point start;
+};
@@ -0,0 +1,30 @@
+#include "trails.h"
+
+void Trails::Update(const Snapshot& snapshot) {
+    const BodyStore& bodies = snapshot.bodies;
+    for (size_t i = 0; i < bodies.Size(); ++i) {
+        if (!(bodies.flags[i] & BodyTrail)) continue;
+        Trail& trail = trails[bodies.id[i]];
+        if (snapshot.step < trail.lastStep + trailInterval) continue;
+        trail.lastStep = snapshot.step;
+        trail.spheres.push_back({glm::vec3(bodies.x[i], bodies.y[i], bodies.z[i]), bodies.radius[i] * 0.3f});
+
+        // Keep trail at maximum length
+        if (trail.spheres.size() > maxTrailLength) {
+            trail.spheres.erase(trail.spheres.begin());
+        }
+    }
+}
+
+void Trails::Draw(SphereList& spheres, std::vector<glm::vec4>& colors) const {
+    for (const auto& entry : trails) {
+        const Trail& trail = entry.second;
+        for (size_t i = 0; i < trail.spheres.size(); ++i) {
+            spheres.Add(trail.spheres[i].position, trail.spheres[i].radius);
+
+            // Fade the color based on age (older spheres are more transparent)
+            float alpha = (float)(i + 1) / trail.spheres.size(); // 0.0 to 1.0
+            colors.push_back(glm::vec4(1.0f, 0.0f, 0.0f, alpha)); // Bright red
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "frustum.h"
+#include "simulation.h"
+
+const size_t maxTrailLength = 30;  // Fewer, larger spheres
+const uint64_t trailInterval = 5;  // simulation steps between two trail spheres
+
+// Trails are kept on the render side, one per body id, sampled from the snapshots as they arrive
+class Trails {
+    public:
+        struct TrailSphere {
+            glm::vec3 position;
+            float radius;
+        };
+        struct Trail {
+            std::vector<TrailSphere> spheres;
+            uint64_t lastStep = 0; // simulation step of the newest sphere
+        };
+
+        // Adds a sphere (30% of the body's size) every trailInterval steps to the trail of each body that has one
+        void Update(const Snapshot& snapshot);
+        // Collects the trail spheres (and their colors) for culling and the instanced draw
+        void Draw(SphereList& spheres, std::vector<glm::vec4>& colors) const;
+        void Clear() { trails.clear(); }
+
+    private:
+        std::unordered_map<uint32_t, Trail> trails;
+};
@@ -0,0 +1,375 @@
+#include "trajectory.h"
+
+#include <zlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+#include "checkpoint.h"
+
+namespace {
+
+// Saturates values outside the int32 range (NaN becomes 0) and counts them in `clamped`
+int32_t Quantize(float value, float quantum, uint64_t& clamped) {
+    double q = std::nearbyint((double)value / quantum);
+    if (!(q == q)) {
+        clamped++;
+        return 0;
+    }
+    if (q < INT32_MIN || q > INT32_MAX) {
+        clamped++;
+        return q < 0 ? INT32_MIN : INT32_MAX;
+    }
+    return (int32_t)q;
+}
+
+// Appends `count` 4-byte values as four byte planes
+void AppendShuffled(std::vector<uint8_t>& out, const void* values, size_t count) {
+    const uint8_t* bytes = (const uint8_t*)values;
+    size_t start = out.size();
+    out.resize(start + count * 4);
+    uint8_t* planes = out.data() + start;
+    for (size_t i = 0; i < count; ++i) {
+        planes[i] = bytes[i * 4];
+        planes[count + i] = bytes[i * 4 + 1];
+        planes[2 * count + i] = bytes[i * 4 + 2];
+        planes[3 * count + i] = bytes[i * 4 + 3];
+    }
+}
+
+void Unshuffle(const uint8_t* planes, size_t count, void* values) {
+    uint8_t* bytes = (uint8_t*)values;
+    for (size_t i = 0; i < count; ++i) {
+        bytes[i * 4] = planes[i];
+        bytes[i * 4 + 1] = planes[count + i];
+        bytes[i * 4 + 2] = planes[2 * count + i];
+        bytes[i * 4 + 3] = planes[3 * count + i];
+    }
+}
+
+bool SetError(std::string* error, const std::string& message) {
+    if (error) *error = message;
+    return false;
+}
+
+}
+
+bool TrajectoryWriter::Open(const std::string& path, float positionQuantum, float velocityQuantum,
+                            size_t queueDepth, size_t framesPerChunk, int compressionLevel) {
+    Close();
+    file = std::fopen(path.c_str(), "wb");
+    if (!file) return false;
+
+    this->path = path;
+    this->positionQuantum = positionQuantum;
+    this->velocityQuantum = velocityQuantum;
+    this->queueDepth = queueDepth > 0 ? queueDepth : 1;
+    this->framesPerChunk = framesPerChunk > 0 ? framesPerChunk : 1;
+    this->compressionLevel = compressionLevel;
+    framesWritten = rawBytes = compressedBytes = samplesClamped = 0;
+    framesDropped = 0;
+    failed = false;
+    stopping = false;
+    chunk.clear();
+    chunkHeader = {};
+    index.clear();
+
+    TrajectoryHeader header = {};
+    std::memcpy(header.magic, trajectoryMagic, sizeof(header.magic));
+    header.version = trajectoryVersion;
+    header.byteOrder = checkpointByteOrder;
+    header.positionQuantum = positionQuantum;
+    header.velocityQuantum = velocityQuantum;
+    if (std::fwrite(&header, sizeof(header), 1, file) != 1) {
+        std::fclose(file);
+        file = nullptr;
+        return false;
+    }
+    fileOffset = sizeof(header);
+    writer = std::thread(&TrajectoryWriter::WriteLoop, this);
+    return true;
+}
+
+bool TrajectoryWriter::Push(const BodyStore& bodies, uint64_t step, double time, bool wait) {
+    if (!file) return false;
+    TrajectoryFrame frame;
+    {
+        std::unique_lock<std::mutex> lock(queueMutex);
+        if (wait) {
+            queueSpace.wait(lock, [&] { return queue.size() < queueDepth; });
+        } else if (queue.size() >= queueDepth) {
+            framesDropped++;
+            return false;
+        }
+        if (!spare.empty()) {
+            frame = std::move(spare.back());
+            spare.pop_back();
+        }
+    }
+
+    // Only the simulation thread pushes, so the queue can only have shrunk while copying
+    frame.step = step;
+    frame.time = time;
+    frame.id = bodies.id;
+    frame.x = bodies.x;
+    frame.y = bodies.y;
+    frame.z = bodies.z;
+    frame.vx = bodies.vx;
+    frame.vy = bodies.vy;
+    frame.vz = bodies.vz;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        queue.push_back(std::move(frame));
+    }
+    queueReady.notify_one();
+    return true;
+}
+
+void TrajectoryWriter::WriteLoop() {
+    std::unique_lock<std::mutex> lock(queueMutex);
+    while (true) {
+        queueReady.wait(lock, [&] { return stopping || !queue.empty(); });
+        if (queue.empty()) return; // stopping and drained
+        TrajectoryFrame frame = std::move(queue.front());
+        queue.pop_front();
+        lock.unlock();
+        AppendFrame(frame);
+        lock.lock();
+        spare.push_back(std::move(frame));
+        queueSpace.notify_one();
+    }
+}
+
+void TrajectoryWriter::AppendFrame(const TrajectoryFrame& frame) {
+    if (failed) return; // nothing more is written after a failed chunk
+    if (chunkHeader.frameCount == 0) {
+        chunk.clear();
+        chunkHeader.firstStep = frame.step;
+        chunkHeader.firstTime = frame.time;
+    }
+    const size_t count = frame.id.size();
+    TrajectoryFrameHeader frameHeader = {frame.step, frame.time, count};
+    const uint8_t* headerBytes = (const uint8_t*)&frameHeader;
+    chunk.insert(chunk.end(), headerBytes, headerBytes + sizeof(frameHeader));
+
+    AppendShuffled(chunk, frame.id.data(), count);
+    quantized.resize(count);
+    const std::vector<float>* arrays[6] = {&frame.x, &frame.y, &frame.z, &frame.vx, &frame.vy, &frame.vz};
+    for (int a = 0; a < 6; ++a) {
+        float quantum = a < 3 ? positionQuantum : velocityQuantum;
+        const std::vector<float>& values = *arrays[a];
+        for (size_t i = 0; i < count; ++i) quantized[i] = Quantize(values[i], quantum, samplesClamped);
+        AppendShuffled(chunk, quantized.data(), count);
+    }
+
+    chunkHeader.lastTime = frame.time;
+    chunkHeader.frameCount++;
+    if (chunkHeader.frameCount >= framesPerChunk) {
+        FlushChunk();
+    }
+}
+
+bool TrajectoryWriter::FlushChunk() {
+    if (chunkHeader.frameCount == 0 || failed) return !failed;
+    uLongf bound = compressBound(chunk.size());
+    compressed.resize(bound);
+    bool ok = compress2(compressed.data(), &bound, chunk.data(), chunk.size(), compressionLevel) == Z_OK;
+
+    chunkHeader.magic = trajectoryChunkMagic;
+    chunkHeader.rawBytes = chunk.size();
+    chunkHeader.compressedBytes = bound;
+    ok = ok && std::fwrite(&chunkHeader, sizeof(chunkHeader), 1, file) == 1 &&
+         std::fwrite(compressed.data(), 1, bound, file) == bound;
+    if (ok) {
+        index.push_back({fileOffset, chunkHeader.firstStep, chunkHeader.firstTime, chunkHeader.lastTime,
+                         chunkHeader.frameCount, 0});
+        fileOffset += sizeof(chunkHeader) + bound;
+        framesWritten += chunkHeader.frameCount;
+        rawBytes += chunk.size();
+        compressedBytes += bound;
+    } else {
+        failed = true; // Close cuts the file back to fileOffset
+    }
+    chunkHeader = {};
+    chunk.clear();
+    return ok;
+}
+
+void TrajectoryWriter::Close() {
+    if (!file) return;
+    {
+        std::lock_guard<std::mutex> lock(queueMutex);
+        stopping = true;
+    }
+    queueReady.notify_one();
+    writer.join();
+
+    bool ok = FlushChunk();
+    if (ok) {
+        TrajectoryFooter footer = {};
+        footer.indexOffset = fileOffset;
+        footer.chunkCount = index.size();
+        std::memcpy(footer.magic, trajectoryIndexMagic, sizeof(footer.magic));
+        ok = (index.empty() || std::fwrite(index.data(), sizeof(TrajectoryIndexEntry), index.size(), file) == index.size()) &&
+             std::fwrite(&footer, sizeof(footer), 1, file) == 1;
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok) {
+        // Cut off whatever part of the failed chunk (or index) reached the file, buffered bytes
+        // included; the complete chunks before it stay readable by scanning, with no stale offsets.
+        // If even that fails, the reader still stops at the first incomplete chunk.
+        failed = true;
+        int truncated = truncate(path.c_str(), (off_t)fileOffset);
+        (void)truncated;
+    }
+    file = nullptr;
+    queue.clear();
+    spare.clear();
+}
+
+bool TrajectoryReader::Open(const std::string& path, std::string* error) {
+    Close();
+    file = std::fopen(path.c_str(), "rb");
+    if (!file) return SetError(error, "cannot open " + path);
+    if (std::fread(&header, sizeof(header), 1, file) != 1 ||
+        std::memcmp(header.magic, trajectoryMagic, sizeof(header.magic)) != 0) {
+        Close();
+        return SetError(error, path + " is not a trajectory file");
+    }
+    if (header.version != trajectoryVersion || header.byteOrder != checkpointByteOrder) {
+        Close();
+        return SetError(error, path + " has an unsupported version or byte order");
+    }
+
+    fseeko(file, 0, SEEK_END);
+    const off_t size = ftello(file);
+    fileSize = size > 0 ? (uint64_t)size : 0;
+
+    // Index at the end of a closed file
+    TrajectoryFooter footer = {};
+    if (size >= (off_t)(sizeof(header) + sizeof(footer)) && fseeko(file, size - (off_t)sizeof(footer), SEEK_SET) == 0 &&
+        std::fread(&footer, sizeof(footer), 1, file) == 1 &&
+        std::memcmp(footer.magic, trajectoryIndexMagic, sizeof(footer.magic)) == 0 &&
+        footer.chunkCount <= fileSize / sizeof(TrajectoryIndexEntry) && footer.indexOffset <= fileSize &&
+        footer.indexOffset + footer.chunkCount * sizeof(TrajectoryIndexEntry) + sizeof(footer) == fileSize) {
+        index.resize(footer.chunkCount);
+        fseeko(file, (off_t)footer.indexOffset, SEEK_SET);
+        if (index.empty() || std::fread(index.data(), sizeof(TrajectoryIndexEntry), index.size(), file) == index.size()) {
+            indexed = true;
+            return true;
+        }
+        index.clear();
+    }
+
+    // Otherwise (killed while writing) walk the chunk headers up to the last complete chunk
+    uint64_t offset = sizeof(header);
+    TrajectoryChunkHeader chunk;
+    while (fseeko(file, (off_t)offset, SEEK_SET) == 0 && std::fread(&chunk, sizeof(chunk), 1, file) == 1 &&
+           chunk.magic == trajectoryChunkMagic && chunk.frameCount > 0 &&
+           chunk.compressedBytes <= fileSize - offset - sizeof(chunk)) {
+        index.push_back({offset, chunk.firstStep, chunk.firstTime, chunk.lastTime, chunk.frameCount, 0});
+        offset += sizeof(chunk) + chunk.compressedBytes;
+    }
+    return true;
+}
+
+void TrajectoryReader::Close() {
+    if (file) std::fclose(file);
+    file = nullptr;
+    fileSize = 0;
+    index.clear();
+    indexed = false;
+    cachedChunk = SIZE_MAX;
+}
+
+uint64_t TrajectoryReader::FrameCount() const {
+    uint64_t frames = 0;
+    for (const TrajectoryIndexEntry& entry : index) frames += entry.frameCount;
+    return frames;
+}
+
+// The chunk header is checked against the file and its index entry before anything is allocated:
+// the compressed bytes must end before the next chunk (or the end of the file), and the raw size
+// can be at most what deflate's best ratio allows for them.
+bool TrajectoryReader::LoadChunk(size_t chunkIndex) {
+    if (chunkIndex == cachedChunk) return true;
+    cachedChunk = SIZE_MAX;
+    const TrajectoryIndexEntry& entry = index[chunkIndex];
+    uint64_t end = chunkIndex + 1 < index.size() ? index[chunkIndex + 1].offset : fileSize;
+    TrajectoryChunkHeader chunk;
+    if (entry.offset > end || end - entry.offset < sizeof(chunk) ||
+        fseeko(file, (off_t)entry.offset, SEEK_SET) != 0 || std::fread(&chunk, sizeof(chunk), 1, file) != 1 ||
+        chunk.magic != trajectoryChunkMagic) {
+        return false;
+    }
+    if (chunk.frameCount == 0 || chunk.frameCount != entry.frameCount || chunk.firstStep != entry.firstStep ||
+        chunk.compressedBytes > end - entry.offset - sizeof(chunk) ||
+        chunk.rawBytes / trajectoryMaxDeflateRatio > chunk.compressedBytes) {
+        return false;
+    }
+    std::vector<uint8_t> compressed(chunk.compressedBytes);
+    if (std::fread(compressed.data(), 1, compressed.size(), file) != compressed.size()) return false;
+    raw.resize(chunk.rawBytes);
+    uLongf rawSize = raw.size();
+    if (uncompress(raw.data(), &rawSize, compressed.data(), compressed.size()) != Z_OK || rawSize != raw.size()) {
+        return false;
+    }
+
+    frameOffsets.clear();
+    size_t offset = 0;
+    for (uint32_t f = 0; f < chunk.frameCount; ++f) {
+        TrajectoryFrameHeader frameHeader;
+        if (sizeof(frameHeader) > raw.size() - offset) return false;
+        std::memcpy(&frameHeader, raw.data() + offset, sizeof(frameHeader));
+        // id + 6 quantized arrays of 4 bytes per body; compared by division so a huge count can't wrap
+        size_t room = raw.size() - offset - sizeof(frameHeader);
+        if (frameHeader.bodyCount > room / (7 * 4)) return false;
+        size_t bytes = sizeof(frameHeader) + 7 * 4 * (size_t)frameHeader.bodyCount;
+        frameOffsets.push_back(offset);
+        offset += bytes;
+    }
+    cachedChunk = chunkIndex;
+    return true;
+}
+
+bool TrajectoryReader::ReadAt(double time, TrajectoryFrame& frame) {
+    if (index.empty()) return false;
+    // Last chunk starting at or before `time`
+    auto after = std::upper_bound(index.begin(), index.end(), time,
+                                  [](double t, const TrajectoryIndexEntry& entry) { return t < entry.firstTime; });
+    size_t chunkIndex = after == index.begin() ? 0 : (size_t)(after - index.begin()) - 1;
+    if (!LoadChunk(chunkIndex)) return false;
+
+    size_t chosen = 0;
+    for (size_t f = 0; f < frameOffsets.size(); ++f) {
+        TrajectoryFrameHeader frameHeader;
+        std::memcpy(&frameHeader, raw.data() + frameOffsets[f], sizeof(frameHeader));
+        if (frameHeader.time > time) break;
+        chosen = f;
+    }
+
+    const uint8_t* data = raw.data() + frameOffsets[chosen];
+    TrajectoryFrameHeader frameHeader;
+    std::memcpy(&frameHeader, data, sizeof(frameHeader));
+    data += sizeof(frameHeader);
+    const size_t count = frameHeader.bodyCount;
+    frame.step = frameHeader.step;
+    frame.time = frameHeader.time;
+    frame.id.resize(count);
+    Unshuffle(data, count, frame.id.data());
+    data += 4 * count;
+
+    std::vector<int32_t> quantized(count);
+    std::vector<float>* arrays[6] = {&frame.x, &frame.y, &frame.z, &frame.vx, &frame.vy, &frame.vz};
+    for (int a = 0; a < 6; ++a) {
+        float quantum = a < 3 ? header.positionQuantum : header.velocityQuantum;
+        Unshuffle(data, count, quantized.data());
+        data += 4 * count;
+        arrays[a]->resize(count);
+        for (size_t i = 0; i < count; ++i) (*arrays[a])[i] = (float)(quantized[i] * (double)quantum);
+    }
+    return true;
+}
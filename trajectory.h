@@ -0,0 +1,162 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "simulation.h"
+
+// Trajectory file: every sampled step's ids, positions and velocities, quantized to int32
+// (value / quantum), byte-shuffled (all first bytes of an array, then all second bytes, ...)
+// and zlib-compressed a chunk of frames at a time. An index of the chunks at the end of the
+// file gives random access by time; a file that was not closed can still be read by scanning.
+//
+//   TrajectoryHeader | chunk | chunk | ... | TrajectoryIndexEntry[chunks] | TrajectoryFooter
+//   chunk = TrajectoryChunkHeader | compressed(frame | frame | ...)
+//   frame = TrajectoryFrameHeader | id[n] | x[n] | y[n] | z[n] | vx[n] | vy[n] | vz[n]   (each array shuffled)
+const char trajectoryMagic[8] = {'G', 'R', 'A', 'V', 'T', 'R', 'A', 'J'};
+const char trajectoryIndexMagic[8] = {'G', 'R', 'A', 'V', 'I', 'D', 'X', '1'};
+const uint32_t trajectoryVersion = 1;
+const uint32_t trajectoryChunkMagic = 0x4B4E4843; // "CHNK"
+const uint64_t trajectoryMaxDeflateRatio = 1032;  // zlib's best case, bounds a chunk's raw size by its compressed size
+
+struct TrajectoryHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;       // checkpointByteOrder convention: 0x01020304
+    float positionQuantum;    // scene units per step of the stored integers
+    float velocityQuantum;    // scene units per simulated second per step
+};
+
+struct TrajectoryChunkHeader {
+    uint32_t magic;
+    uint32_t frameCount;
+    uint64_t rawBytes;
+    uint64_t compressedBytes;
+    uint64_t firstStep;
+    double firstTime, lastTime;
+};
+
+struct TrajectoryFrameHeader {
+    uint64_t step;
+    double time;
+    uint64_t bodyCount;
+};
+
+struct TrajectoryIndexEntry {
+    uint64_t offset;          // of the chunk header
+    uint64_t firstStep;
+    double firstTime, lastTime;
+    uint32_t frameCount;
+    uint32_t reserved;
+};
+
+struct TrajectoryFooter {
+    uint64_t indexOffset;
+    uint64_t chunkCount;
+    char magic[8];
+};
+
+// One sampled step, in full precision (written) or dequantized (read)
+struct TrajectoryFrame {
+    uint64_t step = 0;
+    double time = 0.0;
+    std::vector<uint32_t> id;
+    std::vector<float> x, y, z, vx, vy, vz;
+};
+
+// Takes frames from the simulation thread through a bounded queue and quantizes, shuffles,
+// compresses and writes them on its own thread. When the writer falls behind, Push drops the
+// frame (and counts it) instead of stalling the simulation. Only one thread may push.
+// After a failed write nothing more is written and the file is left without an index, ending
+// at the last complete chunk.
+class TrajectoryWriter {
+    public:
+        ~TrajectoryWriter() { Close(); }
+
+        // positionQuantum / velocityQuantum: precision kept; framesPerChunk: frames compressed together
+        bool Open(const std::string& path, float positionQuantum = 0.01f, float velocityQuantum = 0.001f,
+                  size_t queueDepth = 16, size_t framesPerChunk = 32, int compressionLevel = 1);
+        // Copies the bodies' ids, positions and velocities. Returns false (and counts the frame as
+        // dropped) when the queue is full, unless wait is set: then it waits for room (headless runs).
+        bool Push(const BodyStore& bodies, uint64_t step, double time, bool wait = false);
+        // Writes everything queued, the last chunk and the index
+        void Close();
+
+        bool Active() const { return file != nullptr; }
+        bool Failed() const { return failed.load(); }
+
+        // Written by the writer thread, read after Close
+        uint64_t framesWritten = 0;
+        uint64_t rawBytes = 0;
+        uint64_t compressedBytes = 0;
+        uint64_t samplesClamped = 0; // values beyond the int32 range of their quantum (or NaN), saturated
+        std::atomic<uint64_t> framesDropped{0};
+
+    private:
+        void WriteLoop();
+        void AppendFrame(const TrajectoryFrame& frame);
+        bool FlushChunk();
+
+        FILE* file = nullptr;
+        std::string path;
+        float positionQuantum = 0.01f, velocityQuantum = 0.001f;
+        size_t framesPerChunk = 32;
+        int compressionLevel = 1;
+
+        std::thread writer;
+        std::mutex queueMutex;
+        std::condition_variable queueReady;
+        std::condition_variable queueSpace;
+        std::deque<TrajectoryFrame> queue;
+        std::vector<TrajectoryFrame> spare; // recycled frames
+        size_t queueDepth = 16;
+        bool stopping = false;
+        std::atomic<bool> failed{false};
+
+        // Writer thread only
+        std::vector<uint8_t> chunk;      // raw frames of the chunk being built
+        std::vector<uint8_t> compressed;
+        std::vector<int32_t> quantized;
+        TrajectoryChunkHeader chunkHeader = {};
+        std::vector<TrajectoryIndexEntry> index;
+        uint64_t fileOffset = 0;
+};
+
+// Random access by time: finds the chunk through the index (or a scan for an unfinished file),
+// decompresses it (the last chunk is cached) and dequantizes the frame
+class TrajectoryReader {
+    public:
+        ~TrajectoryReader() { Close(); }
+
+        bool Open(const std::string& path, std::string* error = nullptr);
+        void Close();
+
+        size_t ChunkCount() const { return index.size(); }
+        uint64_t FrameCount() const;
+        double FirstTime() const { return index.empty() ? 0.0 : index.front().firstTime; }
+        double LastTime() const { return index.empty() ? 0.0 : index.back().lastTime; }
+        const TrajectoryHeader& Header() const { return header; }
+        bool Indexed() const { return indexed; } // false: the index was rebuilt by scanning
+
+        // The last frame at or before `time` (the first frame for earlier times)
+        bool ReadAt(double time, TrajectoryFrame& frame);
+
+    private:
+        bool LoadChunk(size_t chunkIndex);
+
+        FILE* file = nullptr;
+        uint64_t fileSize = 0;
+        TrajectoryHeader header = {};
+        std::vector<TrajectoryIndexEntry> index;
+        bool indexed = false;
+        size_t cachedChunk = SIZE_MAX;
+        std::vector<uint8_t> raw;
+        std::vector<size_t> frameOffsets; // of each frame in raw
+};
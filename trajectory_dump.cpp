@@ -0,0 +1,78 @@
+// Reads a trajectory written with --trajectory: prints its chunks and frames, or one frame (the last
+// at or before a simulated time) as CSV, found through the index without decompressing the rest.
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "trajectory.h"
+
+static void PrintUsage(const char* program) {
+    std::fprintf(stderr,
+        "usage: %s FILE [options]\n"
+        "  (no options)        print the header, time range, chunk and frame counts\n"
+        "  --at T              write the frame at simulated time T as CSV (id,x,y,z,vx,vy,vz)\n"
+        "  --output PATH       CSV destination (default stdout)\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2 || argv[1][0] == '-') {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+    const char* path = argv[1];
+    bool dump = false;
+    double at = 0.0;
+    std::string output;
+    for (int i = 2; i < argc; ++i) {
+        const char* arg = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : nullptr;
+        if (std::strcmp(arg, "--at") == 0 && value) {
+            dump = true;
+            at = std::atof(value);
+            ++i;
+        } else if (std::strcmp(arg, "--output") == 0 && value) {
+            output = value;
+            ++i;
+        } else {
+            std::fprintf(stderr, "%s: bad argument '%s'\n", argv[0], arg);
+            PrintUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    TrajectoryReader reader;
+    std::string error;
+    if (!reader.Open(path, &error)) {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 1;
+    }
+
+    if (!dump) {
+        std::printf("%s: %zu chunks, %llu frames, t = %g .. %g%s\n", path, reader.ChunkCount(),
+                    (unsigned long long)reader.FrameCount(), reader.FirstTime(), reader.LastTime(),
+                    reader.Indexed() ? "" : " (not closed, index rebuilt by scanning)");
+        std::printf("position quantum %g, velocity quantum %g\n", reader.Header().positionQuantum,
+                    reader.Header().velocityQuantum);
+        return 0;
+    }
+
+    TrajectoryFrame frame;
+    if (!reader.ReadAt(at, frame)) {
+        std::fprintf(stderr, "%s: cannot read the frame at t = %g\n", path, at);
+        return 1;
+    }
+    FILE* out = output.empty() ? stdout : std::fopen(output.c_str(), "w");
+    if (!out) {
+        std::fprintf(stderr, "Cannot write %s\n", output.c_str());
+        return 1;
+    }
+    std::fprintf(out, "# step %llu, t = %.9g\nid,x,y,z,vx,vy,vz\n", (unsigned long long)frame.step, frame.time);
+    for (size_t i = 0; i < frame.id.size(); ++i) {
+        std::fprintf(out, "%u,%.9g,%.9g,%.9g,%.9g,%.9g,%.9g\n", frame.id[i], frame.x[i], frame.y[i], frame.z[i],
+                     frame.vx[i], frame.vy[i], frame.vz[i]);
+    }
+    if (out != stdout) std::fclose(out);
+    return 0;
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+// Single-producer / single-consumer triple buffer. The writer fills WriteBuffer()
+// and Publish()es it; the reader Acquire()s the most recent published value.
+// Neither side ever waits: each owns one slot, and the third is swapped through
+// an atomic index whose top bit marks "published since the last acquire".
+template <typename T>
+class TripleBuffer {
+    public:
+        T& WriteBuffer() { return slots[writeIndex]; }
+
+        void Publish() {
+            uint8_t previous = middle.exchange(writeIndex | freshBit, std::memory_order_acq_rel);
+            writeIndex = previous & indexMask;
+        }
+
+        // Returns false (and keeps the current read slot) if nothing new was published
+        bool Acquire() {
+            if (!(middle.load(std::memory_order_acquire) & freshBit)) return false;
+            uint8_t previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+            readIndex = previous & indexMask;
+            return true;
+        }
+
+        const T& ReadBuffer() const { return slots[readIndex]; }
+
+    private:
+        static const uint8_t freshBit = 0x80;
+        static const uint8_t indexMask = 0x03;
+
+        T slots[3];
+        std::atomic<uint8_t> middle{1};
+        uint8_t writeIndex = 0; // only touched by the writer
+        uint8_t readIndex = 2;  // only touched by the reader
+};